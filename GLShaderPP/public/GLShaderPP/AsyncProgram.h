@@ -0,0 +1,257 @@
+/*****************************************************************//**
+ * \file      AsyncProgram.h
+ * \brief     Declaration of CBuildPoller class and BuildProgramAsync() coroutine API
+ *
+ * \author    Benjamin ALBOUY-KISSI
+ * \date      2022
+ * \copyright GNU Lesser Public License v3
+ *********************************************************************/
+#pragma once
+#include "ProgramBuilder.h"
+#ifndef __cpp_impl_coroutine
+#error "AsyncProgram.h requires C++20 coroutines support (use -fcoroutines with GCC 10)"
+#endif
+#include <atomic>
+#include <coroutine>
+#include <exception>
+
+namespace GLShaderPP {
+
+  class CBuildPoller;
+
+  /**
+   * \brief Base class of the builds registered in a CBuildPoller.
+   *
+   * Objects of this class are nodes of an intrusive list, so registering a build in a CBuildPoller
+   * never allocates memory.
+   */
+  class CBuildWaiter
+  {
+    friend class CBuildPoller;
+    CBuildWaiter* m_pNext = nullptr; //!< Next build in the CBuildPoller list
+
+  protected:
+    /**
+     * \brief Advances the build as far as possible without waiting for the driver.
+     *
+     * This function is called by CBuildPoller::Poll() on the OpenGL thread.
+     *
+     * \return \c true if the build is finished.
+     */
+    virtual bool poll() = 0;
+
+    /**
+     * \brief Resumes whatever was waiting for the build.
+     *
+     * This function is called by CBuildPoller::Poll() once poll() returned \c true. The waiter may be
+     * destroyed during this call.
+     */
+    virtual void resume() = 0;
+
+    ~CBuildWaiter() = default;
+  };
+
+  /**
+   * \brief Drives asynchronous shader program builds from the OpenGL thread.
+   *
+   * Builds awaited with BuildProgramAsync() may be registered from any thread. OpenGL functions are only
+   * called by Poll(), that the application calls regularly (for instance once per frame) on the thread
+   * where the OpenGL context is current. Poll() advances every registered build and resumes the coroutines
+   * whose build is finished.
+   *
+   * A coroutine must not be destroyed while it is suspended on a build, and the CBuildPoller must outlive
+   * every build registered in it.
+   */
+  class CBuildPoller
+  {
+    std::atomic<CBuildWaiter*> m_pIncoming{ nullptr }; //!< Builds registered since the last Poll(), from any thread
+    CBuildWaiter* m_pWaiting = nullptr;                //!< Builds being advanced by Poll(), only used by the OpenGL thread
+
+    CBuildPoller(const CBuildPoller&) = delete;
+    CBuildPoller& operator=(const CBuildPoller&) = delete;
+
+  public:
+    /**
+     * \brief Creates a poller without any build.
+     */
+    CBuildPoller() = default;
+
+    /**
+     * \brief Registers a build. This function is thread safe and lock free.
+     *
+     * \param pWaiter The build to register. It must stay alive until it is resumed.
+     */
+    void Register(CBuildWaiter* pWaiter)
+    {
+      pWaiter->m_pNext = m_pIncoming.load(std::memory_order_relaxed);
+      while (!m_pIncoming.compare_exchange_weak(pWaiter->m_pNext, pWaiter, std::memory_order_release, std::memory_order_relaxed))
+        ;
+    }
+
+    /**
+     * \brief Advances every registered build and resumes the finished ones.
+     *
+     * This function must be called on the thread where the OpenGL context is current.
+     *
+     * \return The number of builds finished by this call.
+     */
+    std::size_t Poll()
+    {
+      //Take the builds registered since the last call
+      CBuildWaiter* pIncoming = m_pIncoming.exchange(nullptr, std::memory_order_acquire);
+      while (pIncoming)
+      {
+        CBuildWaiter* pNext = pIncoming->m_pNext;
+        pIncoming->m_pNext = m_pWaiting;
+        m_pWaiting = pIncoming;
+        pIncoming = pNext;
+      }
+
+      //Detach finished builds before resuming them, since a resumed coroutine may destroy its waiter
+      CBuildWaiter* pFinished = nullptr;
+      for (CBuildWaiter** ppWaiter = &m_pWaiting; *ppWaiter;)
+      {
+        CBuildWaiter* pWaiter = *ppWaiter;
+        if (pWaiter->poll())
+        {
+          *ppWaiter = pWaiter->m_pNext;
+          pWaiter->m_pNext = pFinished;
+          pFinished = pWaiter;
+        }
+        else
+          ppWaiter = &pWaiter->m_pNext;
+      }
+
+      std::size_t nFinished = 0;
+      while (pFinished)
+      {
+        CBuildWaiter* pNext = pFinished->m_pNext;
+        pFinished->resume();
+        pFinished = pNext;
+        ++nFinished;
+      }
+      return nFinished;
+    }
+
+    /**
+     * \brief Tells if no build is registered in this poller.
+     */
+    bool IsIdle() const { return !m_pWaiting && !m_pIncoming.load(std::memory_order_acquire); }
+  };
+
+  /**
+   * \brief An executor which resumes coroutines directly in CBuildPoller::Poll().
+   */
+  struct CInlineExecutor
+  {
+    //!\brief Resumes \c h immediately.
+    void operator()(std::coroutine_handle<> h) const { h.resume(); }
+  };
+
+  /**
+   * \brief Awaitable returned by BuildProgramAsync().
+   *
+   * The result of \c co_await is the built program. If the build fails, the CShaderException thrown by
+   * CThrowErrorPolicy is rethrown in the awaiting coroutine. With a non throwing error policy, such as
+   * CStatusErrorPolicy or CStderrErrorPolicy when #_DONT_USE_SHADER_EXCEPTION is defined, a failed build
+   * resumes the awaiting coroutine with \c nullptr instead, so the result must be checked before being used.
+   *
+   * \tparam Executor A callable type taking a \c std::coroutine_handle<> and resuming it, for instance
+   * by posting it to a thread pool.
+   * \tparam ErrorPolicy The error policy of the CBasicProgramBuilder.
+   */
+  template<typename Executor, typename ErrorPolicy = CDefaultErrorPolicy>
+  class CProgramBuildAwaiter : private CBuildWaiter
+  {
+    using Builder = CBasicProgramBuilder<ErrorPolicy>;
+
+    CBuildPoller& m_poller;           //!< The poller advancing the build
+    Executor m_executor;              //!< The executor resuming the awaiting coroutine
+    Builder m_builder;                //!< The build
+    std::coroutine_handle<> m_handle; //!< The awaiting coroutine
+    std::exception_ptr m_pException;  //!< The exception thrown by the build, if any
+
+  public:
+    /**
+     * \brief Creates the awaitable. Nothing is submitted to the driver before the awaiting coroutine suspends.
+     */
+    CProgramBuildAwaiter(CBuildPoller& poller, Executor executor, Builder&& builder)
+      : m_poller(poller), m_executor(std::move(executor)), m_builder(std::move(builder)) {}
+
+    //!\brief The build always needs the OpenGL thread, so the awaiting coroutine always suspends.
+    bool await_ready() const noexcept { return false; }
+
+    //!\brief Registers the build in the poller.
+    void await_suspend(std::coroutine_handle<> h)
+    {
+      m_handle = h;
+      m_poller.Register(this);
+    }
+
+    /**
+     * \brief Returns the built program or rethrows the build exception.
+     *
+     * \return The built program, or \c nullptr if the build failed without throwing, because of a non throwing
+     * \c ErrorPolicy.
+     */
+    std::unique_ptr<typename Builder::ProgramType> await_resume()
+    {
+      if (m_pException)
+        std::rethrow_exception(m_pException);
+      return m_builder.TakeProgram();
+    }
+
+  private:
+    bool poll() override
+    {
+      try
+      {
+        while (m_builder.Step())
+          ;
+      }
+      catch (...)
+      {
+        m_pException = std::current_exception();
+      }
+      return m_builder.IsFinished();
+    }
+
+    void resume() override { m_executor(m_handle); }
+  };
+
+  /**
+   * \brief Builds a shader program asynchronously.
+   *
+   * \code{.cpp}
+   * std::unique_ptr<GLShaderPP::CShaderProgram> pProgram = co_await GLShaderPP::BuildProgramAsync(poller, executor,
+   *   GLShaderPP::CProgramBuilder{}.AddStage(GL_VERTEX_SHADER, vertexSource).AddStage(GL_FRAGMENT_SHADER, fragmentSource));
+   * if (pProgram) //Only nullptr if #_DONT_USE_SHADER_EXCEPTION is defined and the build failed
+   *   pProgram->Use();
+   * \endcode
+   *
+   * The awaiting coroutine is suspended until the build is finished by CBuildPoller::Poll(), then it is
+   * resumed by \c executor. Waiting does not allocate any memory.
+   *
+   * \param poller The poller advancing the build on the OpenGL thread.
+   * \param executor A callable resuming the awaiting coroutine.
+   * \param builder The builder of the program, with all its stages added.
+   * \return An awaitable whose result is the built program, see CProgramBuildAwaiter::await_resume().
+   */
+  template<typename Executor = CInlineExecutor, typename ErrorPolicy = CDefaultErrorPolicy>
+  CProgramBuildAwaiter<Executor, ErrorPolicy> BuildProgramAsync(CBuildPoller& poller, Executor executor, CBasicProgramBuilder<ErrorPolicy>&& builder)
+  {
+    return { poller, std::move(executor), std::move(builder) };
+  }
+
+  /**
+   * \brief Builds a shader program asynchronously, resuming the awaiting coroutine in CBuildPoller::Poll().
+   *
+   * \see BuildProgramAsync(CBuildPoller&, Executor, CBasicProgramBuilder<ErrorPolicy>&&)
+   */
+  template<typename ErrorPolicy = CDefaultErrorPolicy>
+  CProgramBuildAwaiter<CInlineExecutor, ErrorPolicy> BuildProgramAsync(CBuildPoller& poller, CBasicProgramBuilder<ErrorPolicy>&& builder)
+  {
+    return { poller, CInlineExecutor{}, std::move(builder) };
+  }
+
+}
@@ -0,0 +1,210 @@
+/*****************************************************************//**
+ * \file      ComputeProgram.h
+ * \brief     Declaration of CBasicComputeProgram class and CComputeProgram alias
+ *
+ * \author    Benjamin ALBOUY-KISSI
+ * \date      2022
+ * \copyright GNU Lesser Public License v3
+ *********************************************************************/
+#pragma once
+#include "ShaderProgram.h"
+#include <array>
+#include <string>
+
+namespace GLShaderPP {
+
+  /**
+   * \brief Layout of a record of a \c GL_DISPATCH_INDIRECT_BUFFER, as read by \c glDispatchComputeIndirect().
+   */
+  struct SDispatchIndirectCommand
+  {
+    GLuint nNumGroupsX; //!< Number of work groups along X
+    GLuint nNumGroupsY; //!< Number of work groups along Y
+    GLuint nNumGroupsZ; //!< Number of work groups along Z
+  };
+
+  /**
+   * \brief An OpenGL compute shader program.
+   *
+   * This class is a CBasicShaderProgram made of a single compute shader (OpenGL 4.3). Once linked, it knows
+   * the work group size declared by its shader (\c layout(local_size_x = ...) in;), so that it can dispatch
+   * enough work groups to cover a given problem size with Dispatch(). It can also dispatch a batch of
+   * records stored in a \c GL_DISPATCH_INDIRECT_BUFFER with DispatchIndirect().
+   *
+   * Errors, such as a non compute shader given to the constructor or a problem size needing more work groups than
+   * \c GL_MAX_COMPUTE_WORK_GROUP_COUNT, are reported through the error policy. CComputeProgram uses
+   * CDefaultErrorPolicy.
+   *
+   * \tparam ErrorPolicy The error policy, such as CThrowErrorPolicy or CStatusErrorPolicy.
+   *
+   * \see CBasicShaderProgram, SDispatchIndirectCommand
+   */
+  template<typename ErrorPolicy = CDefaultErrorPolicy>
+  class CBasicComputeProgram : public CBasicShaderProgram<ErrorPolicy>
+  {
+    mutable std::array<GLint, 3> m_workGroupSize{ 0, 0, 0 };  //!< The work group size, queried at first need
+    mutable std::array<GLint, 3> m_maxWorkGroupCount{ 0, 0, 0 }; //!< The maximum work group counts, queried at first need
+
+  public:
+    using LinkingStatus = CShaderProgramBase::LinkingStatus; //!< The status of the link, named in this class template
+
+    /**
+     * \brief Simply creates an empty compute program.
+     *
+     * After creating a CBasicComputeProgram this way, you have to AttachShader() a compute shader to it then Link() it.
+     */
+    CBasicComputeProgram() = default;
+
+    /**
+     * \brief Attaches and links a compute shader.
+     *
+     * If \c computeShader is not a compute shader, nothing is linked, GetLinkingStatus() returns
+     * LinkingStatus::prepareLinkError and the error is reported as CShaderException::ExceptionType::PrepareLinkError.
+     *
+     * \param computeShader A compiled \c GL_COMPUTE_SHADER typed CShader.
+     *
+     * \throw CShaderException See CBasicShaderProgram::CBasicShaderProgram(const S&...).
+     */
+    explicit CBasicComputeProgram(const CShaderBase& computeShader)
+    {
+      if (computeShader.GetStage() != GL_COMPUTE_SHADER)
+      {
+        this->setLinkingStatus(LinkingStatus::prepareLinkError);
+        ErrorPolicy::Report(CShaderException::ExceptionType::PrepareLinkError, [&computeShader]() {
+          return computeShader.GetType() + " shader can not be linked into a compute program";
+        });
+        return;
+      }
+      this->AttachShader(computeShader);
+      this->Link();
+    }
+
+    /**
+     * \brief Returns the work group size declared by the compute shader.
+     *
+     * The size is queried with \c GL_COMPUTE_WORK_GROUP_SIZE the first time it is needed.
+     *
+     * \return The work group size along X, Y and Z, or zeros if the program is not linked.
+     */
+    const std::array<GLint, 3>& GetWorkGroupSize() const
+    {
+      if (m_workGroupSize[0] == 0 && this->GetLinkingStatus() == LinkingStatus::linkingOk)
+        glGetProgramiv(this->GetProgramId(), GL_COMPUTE_WORK_GROUP_SIZE, m_workGroupSize.data());
+      return m_workGroupSize;
+    }
+
+    /**
+     * \brief Returns the maximum number of work groups of a dispatch.
+     *
+     * The counts are queried with \c GL_MAX_COMPUTE_WORK_GROUP_COUNT the first time they are needed.
+     *
+     * \return The maximum number of work groups along X, Y and Z.
+     */
+    const std::array<GLint, 3>& GetMaxWorkGroupCount() const
+    {
+      if (m_maxWorkGroupCount[0] == 0)
+        for (GLuint i = 0; i < 3; ++i)
+          glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, i, &m_maxWorkGroupCount[i]);
+      return m_maxWorkGroupCount;
+    }
+
+    /**
+     * \brief Computes the number of work groups needed to cover a problem size.
+     *
+     * The counts are not checked against GetMaxWorkGroupCount(), use IsDispatchSupported() before storing the
+     * record in a buffer.
+     *
+     * \param nSizeX Number of invocations needed along X.
+     * \param nSizeY Number of invocations needed along Y.
+     * \param nSizeZ Number of invocations needed along Z.
+     * \return The dispatch record, which may also be stored in a \c GL_DISPATCH_INDIRECT_BUFFER.
+     */
+    SDispatchIndirectCommand GetDispatchCommand(GLuint nSizeX, GLuint nSizeY = 1, GLuint nSizeZ = 1) const
+    {
+      const std::array<GLint, 3>& size = GetWorkGroupSize();
+      auto groups = [](GLuint nProblemSize, GLint nGroupSize) -> GLuint {
+        if (nGroupSize <= 0)
+          return 0;
+        const GLuint n = static_cast<GLuint>(nGroupSize);
+        return nProblemSize / n + (nProblemSize % n != 0);
+      };
+      return { groups(nSizeX, size[0]), groups(nSizeY, size[1]), groups(nSizeZ, size[2]) };
+    }
+
+    /**
+     * \brief Tells if the driver can run a dispatch record, i.e. if its counts do not exceed GetMaxWorkGroupCount().
+     */
+    bool IsDispatchSupported(const SDispatchIndirectCommand& command) const
+    {
+      const std::array<GLint, 3>& max = GetMaxWorkGroupCount();
+      return command.nNumGroupsX <= static_cast<GLuint>(max[0]) && command.nNumGroupsY <= static_cast<GLuint>(max[1])
+        && command.nNumGroupsZ <= static_cast<GLuint>(max[2]);
+    }
+
+    /**
+     * \brief Uses this program and dispatches enough work groups to cover a problem size.
+     *
+     * Invocations beyond the problem size may be run in the last work groups, the shader has to ignore them.
+     * If the problem size needs more work groups than GetMaxWorkGroupCount(), nothing is dispatched and the
+     * error is reported as CShaderException::ExceptionType::BadDispatch.
+     *
+     * \param nSizeX Number of invocations needed along X.
+     * \param nSizeY Number of invocations needed along Y.
+     * \param nSizeZ Number of invocations needed along Z.
+     *
+     * \throw CShaderException With CThrowErrorPolicy, a CShaderException::ExceptionType::BadDispatch typed
+     * CShaderException is thrown if the dispatch is too large.
+     */
+    void Dispatch(GLuint nSizeX, GLuint nSizeY = 1, GLuint nSizeZ = 1)
+    {
+      const SDispatchIndirectCommand command = GetDispatchCommand(nSizeX, nSizeY, nSizeZ);
+      if (command.nNumGroupsX == 0 || command.nNumGroupsY == 0 || command.nNumGroupsZ == 0)
+        return;
+      if (!IsDispatchSupported(command))
+      {
+        ErrorPolicy::Report(CShaderException::ExceptionType::BadDispatch, [&command]() {
+          return "A dispatch of " + std::to_string(command.nNumGroupsX) + "x" + std::to_string(command.nNumGroupsY) + "x"
+            + std::to_string(command.nNumGroupsZ) + " work groups exceeds GL_MAX_COMPUTE_WORK_GROUP_COUNT";
+        });
+        return;
+      }
+      this->Use();
+      glDispatchCompute(command.nNumGroupsX, command.nNumGroupsY, command.nNumGroupsZ);
+    }
+
+    /**
+     * \brief Uses this program and dispatches a batch of records stored in a buffer.
+     *
+     * The buffer is bound to \c GL_DISPATCH_INDIRECT_BUFFER during the batch, then the previous binding is restored.
+     *
+     * \param nBuffer The OpenGL buffer object containing SDispatchIndirectCommand records.
+     * \param nCommands The number of records to dispatch.
+     * \param nOffset The offset in bytes of the first record in the buffer.
+     * \param nStride The distance in bytes between two consecutive records.
+     * \param barriers If not 0, \c glMemoryBarrier() is called with this value between two dispatches, so that a
+     * dispatch can read what the previous one wrote.
+     */
+    void DispatchIndirect(GLuint nBuffer, GLsizei nCommands, GLintptr nOffset = 0, GLsizei nStride = sizeof(SDispatchIndirectCommand), GLbitfield barriers = 0)
+    {
+      if (nCommands <= 0)
+        return;
+      this->Use();
+      GLint nPreviousBuffer = 0;
+      glGetIntegerv(GL_DISPATCH_INDIRECT_BUFFER_BINDING, &nPreviousBuffer);
+      glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, nBuffer);
+      for (GLsizei i = 0; i < nCommands; ++i)
+      {
+        if (i > 0 && barriers != 0)
+          glMemoryBarrier(barriers);
+        glDispatchComputeIndirect(nOffset + static_cast<GLintptr>(i) * nStride);
+      }
+      glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, nPreviousBuffer);
+    }
+  };
+
+  /**
+   * \brief A compute program using the default error policy.
+   */
+  using CComputeProgram = CBasicComputeProgram<>;
+
+}
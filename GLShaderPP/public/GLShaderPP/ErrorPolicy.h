@@ -0,0 +1,118 @@
+/*****************************************************************//**
+ * \file      ErrorPolicy.h
+ * \brief     Declaration of error policies of CBasicShader and CBasicShaderProgram
+ *
+ * \author    Benjamin ALBOUY-KISSI
+ * \date      2022
+ * \copyright GNU Lesser Public License v3
+ *********************************************************************/
+#pragma once
+#include "ShaderException.h"
+#include <cstdio>
+#include <functional>
+
+namespace GLShaderPP {
+
+  /**
+   * \brief Error policy which throws CShaderException objects.
+   *
+   * An error policy is a class with a static \c Report() function template, called by CBasicShader and
+   * CBasicShaderProgram when an error occurs. It receives the type of the error and a callable returning the
+   * human readable message. This callable is only invoked by policies which need the message, so that
+   * policies ignoring it never build it (and never query the driver info logs).
+   */
+  struct CThrowErrorPolicy
+  {
+    /**
+     * \brief Throws a CShaderException.
+     *
+     * \param eType The type of the error.
+     * \param buildMessage A callable returning the human readable message of the error as a \c std::string.
+     */
+    template<typename MessageBuilder>
+    static void Report(CShaderException::ExceptionType eType, MessageBuilder&& buildMessage)
+    {
+      throw CShaderException(buildMessage(), eType);
+    }
+  };
+
+  /**
+   * \brief Error policy which writes error messages to \c stderr.
+   *
+   * Errors are also reported by the statuses of shaders and programs. This policy uses \c std::fputs(), so
+   * that it does not need iostreams.
+   */
+  struct CStderrErrorPolicy
+  {
+    /**
+     * \brief Writes the message of an error to \c stderr.
+     */
+    template<typename MessageBuilder>
+    static void Report(CShaderException::ExceptionType, MessageBuilder&& buildMessage)
+    {
+      const std::string strWhat = buildMessage();
+      std::fputs(strWhat.c_str(), stderr);
+      std::fputc('\n', stderr);
+    }
+  };
+
+  /**
+   * \brief Error policy which gives errors to a user callback.
+   *
+   * The callback is process wide. It should be set with SetCallback() before creating shaders, and is not
+   * called if it is empty.
+   */
+  struct CCallbackErrorPolicy
+  {
+    //!\brief The type of the user callback
+    using Callback = std::function<void(CShaderException::ExceptionType eType, const std::string& strWhat)>;
+
+  private:
+    static inline Callback s_callback; //!< The user callback
+
+  public:
+    /**
+     * \brief Sets the user callback called for each error.
+     */
+    static void SetCallback(Callback callback) { s_callback = std::move(callback); }
+
+    /**
+     * \brief Calls the user callback with an error.
+     */
+    template<typename MessageBuilder>
+    static void Report(CShaderException::ExceptionType eType, MessageBuilder&& buildMessage)
+    {
+      if (s_callback)
+        s_callback(eType, buildMessage());
+    }
+  };
+
+  /**
+   * \brief Error policy which only reports errors by statuses.
+   *
+   * Errors are neither thrown nor written. Callers check the values returned by CBasicShader::Compile() and
+   * CBasicShaderProgram::Link(), or GetCompileState() and GetLinkingStatus(). No message is ever built, so
+   * this policy adds no allocation nor driver query to the error paths.
+   */
+  struct CStatusErrorPolicy
+  {
+    /**
+     * \brief Does nothing.
+     */
+    template<typename MessageBuilder>
+    static void Report(CShaderException::ExceptionType, MessageBuilder&&) {}
+  };
+
+  /**
+   * \brief The error policy of CShader and CShaderProgram.
+   *
+   * It is CThrowErrorPolicy, or CStderrErrorPolicy if #_DONT_USE_SHADER_EXCEPTION is defined before including
+   * GLShaderPP headers.
+   */
+#ifndef _DONT_USE_SHADER_EXCEPTION
+  using CDefaultErrorPolicy = CThrowErrorPolicy;
+#else
+  using CDefaultErrorPolicy = CStderrErrorPolicy;
+#endif
+
+}
@@ -0,0 +1,32 @@
+/*****************************************************************//**
+ * \file      GLUtils.h
+ * \brief     Declaration of OpenGL helper functions
+ *
+ * \author    Benjamin ALBOUY-KISSI
+ * \date      2022
+ * \copyright GNU Lesser Public License v3
+ *********************************************************************/
+#pragma once
+#include <cstring>
+
+namespace GLShaderPP {
+
+  /**
+   * \brief Tells if the current OpenGL context exposes an extension.
+   *
+   * \param pName The name of the extension, for instance \c "GL_KHR_parallel_shader_compile".
+   * \return \c true if the extension is in the extension list of the current context.
+   */
+  inline bool IsExtensionSupported(const char* pName) {
+    GLint nExtensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &nExtensions);
+    for (GLint i = 0; i < nExtensions; ++i)
+    {
+      const char* pExtension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+      if (pExtension && std::strcmp(pExtension, pName) == 0)
+        return true;
+    }
+    return false;
+  }
+
+}
@@ -0,0 +1,316 @@
+/*****************************************************************//**
+ * \file      GpuProfiler.h
+ * \brief     Declaration of CGpuProfiler and CGpuTimingScope classes
+ *
+ * \author    Benjamin ALBOUY-KISSI
+ * \date      2022
+ * \copyright GNU Lesser Public License v3
+ *********************************************************************/
+#pragma once
+#include "ShaderProgram.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+
+namespace GLShaderPP {
+
+  /**
+   * \brief Measures the GPU work done with each shader program, without stalling the pipeline.
+   *
+   * Measures are taken by CGpuTimingScope objects, which wrap the draws issued with a program in OpenGL
+   * query objects: a \c GL_TIME_ELAPSED query and, if the context exposes \c GL_ARB_pipeline_statistics_query,
+   * vertex, primitive, fragment and compute invocation counters. Query objects are taken from pools owned
+   * by the profiler, one per counter since a query object can not change its target once used.
+   *
+   * Results are not read when a scope ends, since this would wait for the GPU. Collect(), typically called
+   * once per frame, reads the results which are already available and gives the query objects back to the pool.
+   * Measures are then aggregated by program label (see CShaderProgram::SetLabel()), a few frames after the draws.
+   *
+   * A CGpuProfiler must be created, used and destroyed while the OpenGL context is current.
+   */
+  class CGpuProfiler
+  {
+  public:
+    //!\brief Aggregated measures of a shader program
+    struct SProgramStats
+    {
+      std::size_t nSamples = 0;                  //!< Number of collected scopes
+      std::chrono::nanoseconds gpuTime{};        //!< Total GPU time
+      std::uint64_t nVerticesSubmitted = 0;      //!< Total number of submitted vertices (pipeline statistics only)
+      std::uint64_t nPrimitivesSubmitted = 0;    //!< Total number of submitted primitives (pipeline statistics only)
+      std::uint64_t nVertexInvocations = 0;      //!< Total number of vertex shader invocations (pipeline statistics only)
+      std::uint64_t nFragmentInvocations = 0;    //!< Total number of fragment shader invocations (pipeline statistics only)
+      std::uint64_t nComputeInvocations = 0;     //!< Total number of compute shader invocations (pipeline statistics only)
+    };
+
+  private:
+    friend class CGpuTimingScope;
+
+    //!\brief Index of each query of a scope
+    enum class Counter { gpuTime, verticesSubmitted, primitivesSubmitted, vertexInvocations, fragmentInvocations, computeInvocations, count };
+    static constexpr std::size_t counterCount = static_cast<std::size_t>(Counter::count);
+
+    //!\brief Query objects of an ended scope, waiting for their results
+    struct SPendingScope
+    {
+      std::string strLabel;                       //!< Label of the measured program
+      std::array<GLuint, counterCount> queries{}; //!< Query objects, 0 for unused counters
+    };
+
+    std::array<std::vector<GLuint>, counterCount> m_freeQueries; //!< Query objects ready to be reused, by counter
+    std::deque<SPendingScope> m_pendingScopes;  //!< Ended scopes, oldest first
+    std::map<std::string, SProgramStats> m_stats; //!< Aggregated measures, by program label
+    std::size_t m_nQueries = 0;                 //!< Number of query objects created by this profiler
+    bool m_bPipelineStatistics = false;         //!< Whether pipeline statistics queries are supported
+    bool m_bScopeActive = false;                //!< Whether a scope is currently measuring
+
+    CGpuProfiler(const CGpuProfiler&) = delete;
+    CGpuProfiler& operator=(const CGpuProfiler&) = delete;
+
+  public:
+    /**
+     * \brief Creates an empty profiler and checks if pipeline statistics queries are supported.
+     */
+    CGpuProfiler()
+    {
+#ifdef GL_VERTICES_SUBMITTED_ARB
+      m_bPipelineStatistics = IsExtensionSupported("GL_ARB_pipeline_statistics_query");
+#endif
+    }
+
+    /**
+     * \brief Deletes every query object created by this profiler. Pending results are lost.
+     */
+    ~CGpuProfiler()
+    {
+      for (SPendingScope& scope : m_pendingScopes)
+        releaseQueries(scope);
+      for (std::vector<GLuint>& freeQueries : m_freeQueries)
+        if (!freeQueries.empty())
+          glDeleteQueries(static_cast<GLsizei>(freeQueries.size()), freeQueries.data());
+    }
+
+    /**
+     * \brief Tells if vertex, primitive and invocation counters are measured, in addition to GPU time.
+     */
+    bool HasPipelineStatistics() const { return m_bPipelineStatistics; }
+
+    /**
+     * \brief Reads available results of ended scopes, without waiting for the GPU.
+     *
+     * Scopes are collected in the order they ended, and collection stops at the first scope whose
+     * results are not available yet.
+     *
+     * \return The number of collected scopes.
+     */
+    std::size_t Collect()
+    {
+      std::size_t nCollected = 0;
+      while (!m_pendingScopes.empty() && isAvailable(m_pendingScopes.front()))
+      {
+        SPendingScope& scope = m_pendingScopes.front();
+        SProgramStats& stats = m_stats[scope.strLabel];
+        ++stats.nSamples;
+        stats.gpuTime += std::chrono::nanoseconds(result(scope, Counter::gpuTime));
+        stats.nVerticesSubmitted += result(scope, Counter::verticesSubmitted);
+        stats.nPrimitivesSubmitted += result(scope, Counter::primitivesSubmitted);
+        stats.nVertexInvocations += result(scope, Counter::vertexInvocations);
+        stats.nFragmentInvocations += result(scope, Counter::fragmentInvocations);
+        stats.nComputeInvocations += result(scope, Counter::computeInvocations);
+
+        releaseQueries(scope);
+        m_pendingScopes.pop_front();
+        ++nCollected;
+      }
+      return nCollected;
+    }
+
+    /**
+     * \brief Returns the aggregated measures, by program label.
+     */
+    const std::map<std::string, SProgramStats>& GetStats() const { return m_stats; }
+
+    /**
+     * \brief Returns the aggregated measures of a program label, or empty measures if there is none.
+     */
+    SProgramStats GetStats(const std::string& strLabel) const
+    {
+      auto it = m_stats.find(strLabel);
+      return it != m_stats.end() ? it->second : SProgramStats{};
+    }
+
+    /**
+     * \brief Forgets the aggregated measures. Pending scopes are still collected.
+     */
+    void ResetStats() { m_stats.clear(); }
+
+    /**
+     * \brief Returns the number of ended scopes whose results have not been collected yet.
+     */
+    std::size_t GetPendingCount() const { return m_pendingScopes.size(); }
+
+    /**
+     * \brief Returns the number of query objects created by this profiler, which is the size of its pool.
+     */
+    std::size_t GetQueryCount() const { return m_nQueries; }
+
+  private:
+    /**
+     * \brief Takes a query object from the pool of a counter, or creates one if this pool is empty.
+     */
+    GLuint acquireQuery(Counter eCounter)
+    {
+      std::vector<GLuint>& freeQueries = m_freeQueries[static_cast<std::size_t>(eCounter)];
+      if (freeQueries.empty())
+      {
+        GLuint nQuery;
+        glGenQueries(1, &nQuery);
+        ++m_nQueries;
+        return nQuery;
+      }
+      GLuint nQuery = freeQueries.back();
+      freeQueries.pop_back();
+      return nQuery;
+    }
+
+    /**
+     * \brief Gives the query objects of a scope back to their pools.
+     */
+    void releaseQueries(const SPendingScope& scope)
+    {
+      for (std::size_t i = 0; i < counterCount; ++i)
+        if (scope.queries[i] != 0)
+          m_freeQueries[i].push_back(scope.queries[i]);
+    }
+
+    /**
+     * \brief Returns the OpenGL query target of a counter.
+     */
+    static GLenum target(Counter eCounter)
+    {
+      switch (eCounter)
+      {
+#ifdef GL_VERTICES_SUBMITTED_ARB
+      case Counter::verticesSubmitted:   return GL_VERTICES_SUBMITTED_ARB;
+      case Counter::primitivesSubmitted: return GL_PRIMITIVES_SUBMITTED_ARB;
+      case Counter::vertexInvocations:   return GL_VERTEX_SHADER_INVOCATIONS_ARB;
+      case Counter::fragmentInvocations: return GL_FRAGMENT_SHADER_INVOCATIONS_ARB;
+      case Counter::computeInvocations:  return GL_COMPUTE_SHADER_INVOCATIONS_ARB;
+#endif
+      default:                           return GL_TIME_ELAPSED;
+      }
+    }
+
+    /**
+     * \brief Starts the queries of a scope.
+     *
+     * \return The started query objects, all 0 if a scope is already measuring since OpenGL does not allow
+     * nested queries of the same target.
+     */
+    std::array<GLuint, counterCount> begin()
+    {
+      std::array<GLuint, counterCount> queries{};
+      if (m_bScopeActive)
+        return queries;
+      m_bScopeActive = true;
+      const std::size_t nCounters = m_bPipelineStatistics ? counterCount : 1;
+      for (std::size_t i = 0; i < nCounters; ++i)
+      {
+        queries[i] = acquireQuery(static_cast<Counter>(i));
+        glBeginQuery(target(static_cast<Counter>(i)), queries[i]);
+      }
+      return queries;
+    }
+
+    /**
+     * \brief Ends the queries of a scope and queues them for Collect().
+     */
+    void end(std::string strLabel, const std::array<GLuint, counterCount>& queries)
+    {
+      if (queries[0] == 0)
+        return;
+      for (std::size_t i = 0; i < counterCount; ++i)
+        if (queries[i] != 0)
+          glEndQuery(target(static_cast<Counter>(i)));
+      m_pendingScopes.push_back({ std::move(strLabel), queries });
+      m_bScopeActive = false;
+    }
+
+    /**
+     * \brief Tells if every result of a scope is available.
+     */
+    static bool isAvailable(const SPendingScope& scope)
+    {
+      for (GLuint nQuery : scope.queries)
+      {
+        if (nQuery == 0)
+          continue;
+        GLuint nAvailable = GL_FALSE;
+        glGetQueryObjectuiv(nQuery, GL_QUERY_RESULT_AVAILABLE, &nAvailable);
+        if (nAvailable == GL_FALSE)
+          return false;
+      }
+      return true;
+    }
+
+    /**
+     * \brief Returns the result of a query of a scope, or 0 if this counter was not measured.
+     */
+    static std::uint64_t result(const SPendingScope& scope, Counter eCounter)
+    {
+      const GLuint nQuery = scope.queries[static_cast<std::size_t>(eCounter)];
+      GLuint64 nResult = 0;
+      if (nQuery != 0)
+        glGetQueryObjectui64v(nQuery, GL_QUERY_RESULT, &nResult);
+      return nResult;
+    }
+  };
+
+  /**
+   * \brief Uses a shader program and measures the GPU work issued during its lifetime.
+   *
+   * \code{.cpp}
+   * {
+   *   GLShaderPP::CGpuTimingScope scope(profiler, program); //Calls program.Use()
+   *   glDrawArrays(GL_TRIANGLES, 0, nVertices);
+   * } //Measures are queued in profiler
+   * \endcode
+   *
+   * Scopes of a same profiler must not overlap: a scope created while another one is measuring only uses
+   * its program, and measures nothing.
+   */
+  class CGpuTimingScope
+  {
+    CGpuProfiler& m_profiler;                                   //!< The profiler collecting measures
+    std::string m_strLabel;                                     //!< Label of the measured program
+    std::array<GLuint, CGpuProfiler::counterCount> m_queries;   //!< Started query objects
+
+    CGpuTimingScope(const CGpuTimingScope&) = delete;
+    CGpuTimingScope& operator=(const CGpuTimingScope&) = delete;
+
+  public:
+    /**
+     * \brief Uses a shader program and starts measuring.
+     *
+     * \param profiler The profiler which collects the measures.
+     * \param program The program to use. Measures are aggregated under its label.
+     */
+    CGpuTimingScope(CGpuProfiler& profiler, CShaderProgramBase& program)
+      : m_profiler(profiler), m_strLabel(program.GetLabel())
+    {
+      program.Use();
+      m_queries = m_profiler.begin();
+    }
+
+    /**
+     * \brief Stops measuring and queues the measures in the profiler.
+     */
+    ~CGpuTimingScope()
+    {
+      m_profiler.end(std::move(m_strLabel), m_queries);
+    }
+  };
+
+}
@@ -0,0 +1,37 @@
+/*****************************************************************//**
+ * \file      Hash.h
+ * \brief     Declaration of the hash functions of GLShaderPP
+ *
+ * \author    Benjamin ALBOUY-KISSI
+ * \date      2022
+ * \copyright GNU Lesser Public License v3
+ *********************************************************************/
+#pragma once
+#include <cstdint>
+#include <string_view>
+
+namespace GLShaderPP {
+
+  //!\brief Initial value of a 64 bits FNV-1a hash
+  inline constexpr std::uint64_t fnv1a64Basis = 0xcbf29ce484222325ull;
+
+  /**
+   * \brief Computes the 64 bits FNV-1a hash of a string.
+   *
+   * FNV-1a is not a cryptographic hash, but it is fast, well spread and stable across platforms and
+   * compilers, so that its values may be stored in files.
+   *
+   * \param str The string to hash.
+   * \param nHash The hash of the preceding strings, to hash several strings as if they were concatenated.
+   */
+  constexpr std::uint64_t Fnv1a64(std::string_view str, std::uint64_t nHash = fnv1a64Basis)
+  {
+    for (char c : str)
+    {
+      nHash ^= static_cast<unsigned char>(c);
+      nHash *= 0x100000001b3ull;
+    }
+    return nHash;
+  }
+
+}
@@ -0,0 +1,246 @@
+/*****************************************************************//**
+ * \file      ProgramBuilder.h
+ * \brief     Declaration of CBasicProgramBuilder class template and CProgramBuilder class
+ *
+ * \author    Benjamin ALBOUY-KISSI
+ * \date      2022
+ * \copyright GNU Lesser Public License v3
+ *********************************************************************/
+#pragma once
+#include "ShaderProgram.h"
+#include <memory>
+#include <vector>
+
+namespace GLShaderPP {
+
+  /**
+   * \brief Builds a shader program step by step.
+   *
+   * A CBasicProgramBuilder holds the GLSL sources of each stage of a shader program. Each call to Step()
+   * advances the build as far as it can go without waiting for the driver: first all stages are
+   * submitted to the compiler, then the program is submitted to the linker once every compilation is
+   * finished, and finally the link result is checked once the link is finished. When the driver exposes
+   * \c GL_KHR_parallel_shader_compile, compilation and linking run in the background between two calls
+   * to Step(). Otherwise, each step waits for the driver.
+   *
+   * When the build is finished, the shader objects are detached and released, so that the driver can free
+   * them, and the built program can be retrieved with GetProgram() or TakeProgram().
+   *
+   * If something goes wrong during compilation or linking, the error is reported by the \c ErrorPolicy of the
+   * shaders and the program, so a CShaderException is thrown by Step() with CThrowErrorPolicy. In any case,
+   * GetState() becomes BuildState::failed and TakeProgram() returns \c nullptr.
+   *
+   * \tparam ErrorPolicy The error policy of the built CBasicShader and CBasicShaderProgram objects.
+   * \see CProgramBuilder, CBasicShader, CBasicShaderProgram
+   */
+  template<typename ErrorPolicy = CDefaultErrorPolicy>
+  class CBasicProgramBuilder
+  {
+  public:
+    using ShaderType = CBasicShader<ErrorPolicy>;          //!< The type of the compiled stages
+    using ProgramType = CBasicShaderProgram<ErrorPolicy>;  //!< The type of the built program
+
+  public:
+    //!\brief The state of the build
+    enum class BuildState
+    {
+      notStarted, //!< Nothing has been submitted to the driver yet
+      compiling,  //!< Stages are being compiled
+      linking,    //!< The program is being linked
+      ready,      //!< The program is linked and ready to be used
+      failed      //!< Compilation or linking failed
+    };
+
+  private:
+    //!\brief Source of one stage of the program
+    struct SStage
+    {
+      GLenum eType;          //!< OpenGL type of this stage
+      std::string strSource; //!< GLSL source code of this stage
+    };
+
+    BuildState m_eState = BuildState::notStarted;        //!< The state of the build
+    std::vector<SStage> m_stages;                        //!< Sources of each stage
+    std::vector<std::unique_ptr<ShaderType>> m_shaders;  //!< Shader objects while they are compiled and linked
+    std::unique_ptr<ProgramType> m_pProgram;             //!< The built shader program
+
+    CBasicProgramBuilder(const CBasicProgramBuilder&) = delete;
+    CBasicProgramBuilder& operator=(const CBasicProgramBuilder&) = delete;
+
+  public:
+    /**
+     * \brief Creates a builder without any stage.
+     *
+     * Add stages with AddStage() before the first call to Step().
+     */
+    CBasicProgramBuilder() = default;
+
+    /**
+     * \brief Moves a builder.
+     */
+    CBasicProgramBuilder(CBasicProgramBuilder&&) = default;
+
+    /**
+     * \brief Moves a builder.
+     */
+    CBasicProgramBuilder& operator=(CBasicProgramBuilder&&) = default;
+
+    /**
+     * \brief Adds a stage to the program to build.
+     *
+     * Stages added after the first call to Step() are ignored.
+     *
+     * \param eType OpenGL type of the stage (\c GL_VERTEX_SHADER, \c GL_FRAGMENT_SHADER...).
+     * \param strSource The string of the GLSL source code of the stage.
+     * \return A reference to this builder.
+     */
+    CBasicProgramBuilder& AddStage(GLenum eType, std::string strSource) &
+    {
+      if (m_eState == BuildState::notStarted)
+        m_stages.push_back({ eType, std::move(strSource) });
+      return *this;
+    }
+
+    /**
+     * \brief Adds a stage to a temporary builder.
+     *
+     * This overload allows to chain AddStage() calls on a temporary builder, for instance
+     * \c CProgramBuilder{}.AddStage(...).AddStage(...), and to pass the result by value.
+     *
+     * \param eType OpenGL type of the stage (\c GL_VERTEX_SHADER, \c GL_FRAGMENT_SHADER...).
+     * \param strSource The string of the GLSL source code of the stage.
+     * \return An rvalue reference to this builder.
+     */
+    CBasicProgramBuilder&& AddStage(GLenum eType, std::string strSource) &&
+    {
+      AddStage(eType, std::move(strSource));
+      return std::move(*this);
+    }
+
+    /**
+     * \brief Advances the build without waiting for the driver.
+     *
+     * \return \c true if the build made some progress, \c false if it is waiting for the driver or if it is finished.
+     *
+     * \throw CShaderException The exception thrown by CBasicShader::Compile(), CBasicShaderProgram::AttachShader()
+     * or CBasicShaderProgram::Link() with CThrowErrorPolicy.
+     */
+    bool Step()
+    {
+      try
+      {
+        return advance();
+      }
+      catch (...)
+      {
+        fail();
+        throw;
+      }
+    }
+
+    /**
+     * \brief Advances the build until it is finished, waiting for the driver if needed.
+     *
+     * \throw CShaderException See Step().
+     */
+    void Finish()
+    {
+      while (!IsFinished())
+        Step();
+    }
+
+    /**
+     * \brief Returns the state of the build.
+     */
+    BuildState GetState() const { return m_eState; }
+
+    /**
+     * \brief Tells if the build is ready or failed.
+     */
+    bool IsFinished() const { return m_eState == BuildState::ready || m_eState == BuildState::failed; }
+
+    /**
+     * \brief Returns the built program, or \c nullptr if it is not ready.
+     */
+    ProgramType* GetProgram() const { return m_eState == BuildState::ready ? m_pProgram.get() : nullptr; }
+
+    /**
+     * \brief Gives the ownership of the built program to the caller.
+     *
+     * \return The built program, or \c nullptr if it is not ready, if it failed or if it has already been taken.
+     */
+    std::unique_ptr<ProgramType> TakeProgram() { return m_eState == BuildState::ready ? std::move(m_pProgram) : nullptr; }
+
+  private:
+    /**
+     * \brief Performs the next step of the build if the driver is ready for it.
+     */
+    bool advance()
+    {
+      switch (m_eState)
+      {
+      case BuildState::notStarted:
+        for (const SStage& stage : m_stages)
+        {
+          m_shaders.push_back(std::make_unique<ShaderType>(stage.eType));
+          m_shaders.back()->SetSource(stage.strSource);
+          m_shaders.back()->SubmitCompile();
+        }
+        m_stages.clear();
+        m_eState = BuildState::compiling;
+        return true;
+
+      case BuildState::compiling:
+        for (const auto& pShader : m_shaders)
+          if (!pShader->IsCompileCompleted())
+            return false;
+        m_pProgram = std::make_unique<ProgramType>();
+        m_pProgram->SetDetachShadersAfterLink(true);
+        for (const auto& pShader : m_shaders)
+        {
+          pShader->Compile();
+          m_pProgram->AttachShader(*pShader);
+        }
+        if (m_pProgram->GetLinkingStatus() != ProgramType::LinkingStatus::notLinked)
+        {
+          fail();
+          return true;
+        }
+        m_pProgram->SubmitLink();
+        m_eState = BuildState::linking;
+        return true;
+
+      case BuildState::linking:
+        if (!m_pProgram->IsLinkCompleted())
+          return false;
+        m_pProgram->Link();
+        m_shaders.clear();
+        if (m_pProgram->GetLinkingStatus() != ProgramType::LinkingStatus::linkingOk)
+          fail();
+        else
+          m_eState = BuildState::ready;
+        return true;
+
+      default:
+        return false;
+      }
+    }
+
+    /**
+     * \brief Marks the build as failed and releases every OpenGL object.
+     */
+    void fail()
+    {
+      m_eState = BuildState::failed;
+      m_stages.clear();
+      m_shaders.clear();
+      m_pProgram.reset();
+    }
+  };
+
+  /**
+   * \brief A program builder using the default error policy.
+   */
+  using CProgramBuilder = CBasicProgramBuilder<>;
+
+}
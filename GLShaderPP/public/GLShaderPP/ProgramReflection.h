@@ -0,0 +1,508 @@
+/*****************************************************************//**
+ * \file      ProgramReflection.h
+ * \brief     Declaration of CProgramReflection and CReflectionCache classes
+ *
+ * \author    Benjamin ALBOUY-KISSI
+ * \date      2022
+ * \copyright GNU Lesser Public License v3
+ *********************************************************************/
+#pragma once
+#include "ShaderProgram.h"
+#include "Hash.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <iterator>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace GLShaderPP {
+
+  /**
+   * \brief Computes the identity key of a shader program from its sources and the current driver.
+   *
+   * The key mixes the GLSL sources of the stages with the vendor, renderer and version strings of the
+   * current OpenGL context, so that it changes when a source changes or when the driver is updated. It
+   * is the key of the data cached for a program, such as its reflection in a CReflectionCache.
+   *
+   * \param sources The GLSL sources of the stages of the program, always given in the same order.
+   */
+  inline std::uint64_t ComputeProgramKey(std::initializer_list<std::string_view> sources)
+  {
+    std::uint64_t nKey = fnv1a64Basis;
+    for (GLenum eName : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+    {
+      const GLubyte* pString = glGetString(eName);
+      nKey = Fnv1a64(pString ? reinterpret_cast<const char*>(pString) : "", nKey);
+      nKey = Fnv1a64(std::string_view("", 1), nKey);
+    }
+    //Sources are separated by a null character, which GLSL sources never contain
+    for (std::string_view strSource : sources)
+    {
+      nKey = Fnv1a64(strSource, nKey);
+      nKey = Fnv1a64(std::string_view("", 1), nKey);
+    }
+    return nKey;
+  }
+
+  /**
+   * \brief The active uniforms, vertex attributes and uniform blocks of a linked shader program.
+   *
+   * Query() gathers them with the program interface queries of OpenGL 4.3 (or \c GL_ARB_program_interface_query),
+   * which costs several driver round trips per resource. Write() and Read() serialize them in a compact binary
+   * form, so that they can be restored without any query, typically through a CReflectionCache.
+   *
+   * Uniforms and attributes are sorted by name, so that finding them is a binary search.
+   */
+  class CProgramReflection
+  {
+  public:
+    //!\brief An active uniform or vertex attribute
+    struct SVariable
+    {
+      std::string strName;    //!< Name of the variable, with a "[0]" suffix for arrays
+      GLint nLocation = -1;   //!< Location of the variable, -1 for uniforms of blocks and built-in attributes
+      GLenum eType = 0;       //!< OpenGL type of the variable (GL_FLOAT_VEC3...)
+      GLint nArraySize = 1;   //!< Number of elements of the variable, 1 if it is not an array
+      GLint nBlockIndex = -1; //!< Index of the uniform block of the variable, -1 if it is not in a block
+    };
+
+    //!\brief An active uniform block
+    struct SBlock
+    {
+      std::string strName;    //!< Name of the block
+      GLint nBinding = 0;     //!< Binding point of the block
+      GLint nDataSize = 0;    //!< Minimum size of the buffer bound to the block, in bytes
+    };
+
+  private:
+    static constexpr char magic[4] = { 'G', 'L', 'R', 'F' };  //!< Signature of serialized reflections
+    static constexpr std::uint32_t version = 1;                 //!< Version of the serialized format
+
+    std::vector<SVariable> m_uniforms;    //!< Active uniforms, sorted by name
+    std::vector<SVariable> m_attributes;  //!< Active vertex attributes, sorted by name
+    std::vector<SBlock> m_blocks;         //!< Active uniform blocks, by block index
+
+  public:
+    /**
+     * \brief Queries the active resources of a linked program.
+     *
+     * \param program The program to reflect. It must be successfully linked.
+     */
+    static CProgramReflection Query(const CShaderProgramBase& program)
+    {
+      const GLuint nProgram = program.GetProgramId();
+      CProgramReflection reflection;
+
+      const GLenum uniformProperties[] = { GL_LOCATION, GL_TYPE, GL_ARRAY_SIZE, GL_BLOCK_INDEX };
+      reflection.m_uniforms = queryVariables(nProgram, GL_UNIFORM, uniformProperties, 4);
+      //Vertex attributes have no GL_BLOCK_INDEX property
+      reflection.m_attributes = queryVariables(nProgram, GL_PROGRAM_INPUT, uniformProperties, 3);
+
+      GLint nBlocks = 0;
+      glGetProgramInterfaceiv(nProgram, GL_UNIFORM_BLOCK, GL_ACTIVE_RESOURCES, &nBlocks);
+      reflection.m_blocks.resize(nBlocks);
+      const GLenum blockProperties[] = { GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE };
+      for (GLint i = 0; i < nBlocks; ++i)
+      {
+        SBlock& block = reflection.m_blocks[i];
+        block.strName = queryName(nProgram, GL_UNIFORM_BLOCK, i);
+        GLint values[2];
+        glGetProgramResourceiv(nProgram, GL_UNIFORM_BLOCK, i, 2, blockProperties, 2, nullptr, values);
+        block.nBinding = values[0];
+        block.nDataSize = values[1];
+      }
+      return reflection;
+    }
+
+    /**
+     * \brief Gets the active uniforms, sorted by name.
+     */
+    const std::vector<SVariable>& GetUniforms() const { return m_uniforms; }
+
+    /**
+     * \brief Gets the active vertex attributes, sorted by name.
+     */
+    const std::vector<SVariable>& GetAttributes() const { return m_attributes; }
+
+    /**
+     * \brief Gets the active uniform blocks, by block index.
+     */
+    const std::vector<SBlock>& GetUniformBlocks() const { return m_blocks; }
+
+    /**
+     * \brief Finds an active uniform by name.
+     *
+     * \return The uniform, or \c nullptr if the program has no active uniform with this name.
+     */
+    const SVariable* FindUniform(std::string_view strName) const { return find(m_uniforms, strName); }
+
+    /**
+     * \brief Finds an active vertex attribute by name.
+     *
+     * \return The attribute, or \c nullptr if the program has no active attribute with this name.
+     */
+    const SVariable* FindAttribute(std::string_view strName) const { return find(m_attributes, strName); }
+
+    /**
+     * \brief Gets the location of an active uniform, like \c glGetUniformLocation() but without querying the driver.
+     *
+     * \return The location of the uniform, or -1 if it is not found or is in a uniform block.
+     */
+    GLint GetUniformLocation(std::string_view strName) const
+    {
+      const SVariable* pUniform = FindUniform(strName);
+      return pUniform ? pUniform->nLocation : -1;
+    }
+
+    /**
+     * \brief Gets the location of an active vertex attribute, like \c glGetAttribLocation() but without querying the driver.
+     *
+     * \return The location of the attribute, or -1 if it is not found.
+     */
+    GLint GetAttribLocation(std::string_view strName) const
+    {
+      const SVariable* pAttribute = FindAttribute(strName);
+      return pAttribute ? pAttribute->nLocation : -1;
+    }
+
+    /**
+     * \brief Checks that a program has as many active resources as this reflection.
+     *
+     * This costs three queries instead of several per resource. It is meant for debug builds, to detect
+     * a restored reflection which does not match its program.
+     */
+    bool Matches(const CShaderProgramBase& program) const
+    {
+      GLint nUniforms = 0, nAttributes = 0, nBlocks = 0;
+      glGetProgramInterfaceiv(program.GetProgramId(), GL_UNIFORM, GL_ACTIVE_RESOURCES, &nUniforms);
+      glGetProgramInterfaceiv(program.GetProgramId(), GL_PROGRAM_INPUT, GL_ACTIVE_RESOURCES, &nAttributes);
+      glGetProgramInterfaceiv(program.GetProgramId(), GL_UNIFORM_BLOCK, GL_ACTIVE_RESOURCES, &nBlocks);
+      return static_cast<std::size_t>(nUniforms) == m_uniforms.size()
+        && static_cast<std::size_t>(nAttributes) == m_attributes.size()
+        && static_cast<std::size_t>(nBlocks) == m_blocks.size();
+    }
+
+    /**
+     * \brief Serializes the reflection.
+     *
+     * The serialized form starts with a signature, a format version and the key, and ends with a hash of
+     * its content, so that Read() detects stale and corrupted data.
+     *
+     * \param stream A binary output stream.
+     * \param nKey The key of the program, usually from ComputeProgramKey().
+     * \return \c false if the stream fails.
+     */
+    bool Write(std::ostream& stream, std::uint64_t nKey) const
+    {
+      std::string strData(magic, sizeof(magic));
+      writeValue(strData, version);
+      writeValue(strData, nKey);
+      writeValue(strData, static_cast<std::uint32_t>(m_uniforms.size()));
+      writeValue(strData, static_cast<std::uint32_t>(m_attributes.size()));
+      writeValue(strData, static_cast<std::uint32_t>(m_blocks.size()));
+      for (const std::vector<SVariable>* pVariables : { &m_uniforms, &m_attributes })
+        for (const SVariable& variable : *pVariables)
+        {
+          writeString(strData, variable.strName);
+          writeValue(strData, variable.nLocation);
+          writeValue(strData, variable.eType);
+          writeValue(strData, variable.nArraySize);
+          writeValue(strData, variable.nBlockIndex);
+        }
+      for (const SBlock& block : m_blocks)
+      {
+        writeString(strData, block.strName);
+        writeValue(strData, block.nBinding);
+        writeValue(strData, block.nDataSize);
+      }
+      writeValue(strData, Fnv1a64(strData));
+      stream.write(strData.data(), strData.size());
+      return stream.good();
+    }
+
+    /**
+     * \brief Restores a serialized reflection.
+     *
+     * \param stream A binary input stream, as written by Write().
+     * \param nKey The expected key of the program.
+     * \return The reflection, or \c std::nullopt if the data is truncated, corrupted, of another format
+     * version or of another key.
+     */
+    static std::optional<CProgramReflection> Read(std::istream& stream, std::uint64_t nKey)
+    {
+      const std::string strData{ std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>() };
+      if (strData.size() < sizeof(magic) + sizeof(std::uint64_t) || std::memcmp(strData.data(), magic, sizeof(magic)) != 0)
+        return std::nullopt;
+      std::string_view strContent(strData.data(), strData.size() - sizeof(std::uint64_t));
+      std::uint64_t nHash = 0;
+      std::memcpy(&nHash, strData.data() + strContent.size(), sizeof(nHash));
+      if (nHash != Fnv1a64(strContent))
+        return std::nullopt;
+
+      strContent.remove_prefix(sizeof(magic));
+      std::uint32_t nVersion = 0, nUniforms = 0, nAttributes = 0, nBlocks = 0;
+      std::uint64_t nStoredKey = 0;
+      if (!readValue(strContent, nVersion) || nVersion != version || !readValue(strContent, nStoredKey) || nStoredKey != nKey
+        || !readValue(strContent, nUniforms) || !readValue(strContent, nAttributes) || !readValue(strContent, nBlocks))
+        return std::nullopt;
+
+      CProgramReflection reflection;
+      for (auto [pVariables, nCount] : { std::make_pair(&reflection.m_uniforms, nUniforms), std::make_pair(&reflection.m_attributes, nAttributes) })
+        for (std::uint32_t i = 0; i < nCount; ++i)
+        {
+          SVariable variable;
+          if (!readString(strContent, variable.strName) || !readValue(strContent, variable.nLocation) || !readValue(strContent, variable.eType)
+            || !readValue(strContent, variable.nArraySize) || !readValue(strContent, variable.nBlockIndex))
+            return std::nullopt;
+          pVariables->push_back(std::move(variable));
+        }
+      for (std::uint32_t i = 0; i < nBlocks; ++i)
+      {
+        SBlock block;
+        if (!readString(strContent, block.strName) || !readValue(strContent, block.nBinding) || !readValue(strContent, block.nDataSize))
+          return std::nullopt;
+        reflection.m_blocks.push_back(std::move(block));
+      }
+      if (!strContent.empty())
+        return std::nullopt;
+      return reflection;
+    }
+
+  private:
+    /**
+     * \brief Gets the name of a program resource.
+     */
+    static std::string queryName(GLuint nProgram, GLenum eInterface, GLint nIndex)
+    {
+      GLint nLength = 0;
+      const GLenum property = GL_NAME_LENGTH;
+      glGetProgramResourceiv(nProgram, eInterface, nIndex, 1, &property, 1, nullptr, &nLength);
+      std::string strName(nLength > 0 ? nLength : 1, '\0');
+      glGetProgramResourceName(nProgram, eInterface, nIndex, static_cast<GLsizei>(strName.size()), &nLength, &strName.front());
+      strName.resize(nLength);
+      return strName;
+    }
+
+    /**
+     * \brief Queries the active variables of a program interface, and sorts them by name.
+     *
+     * \param properties Location, type, array size and optionally block index properties.
+     * \param nProperties The number of properties to query, 3 or 4.
+     */
+    static std::vector<SVariable> queryVariables(GLuint nProgram, GLenum eInterface, const GLenum* properties, GLsizei nProperties)
+    {
+      GLint nCount = 0;
+      glGetProgramInterfaceiv(nProgram, eInterface, GL_ACTIVE_RESOURCES, &nCount);
+      std::vector<SVariable> variables(nCount);
+      for (GLint i = 0; i < nCount; ++i)
+      {
+        SVariable& variable = variables[i];
+        variable.strName = queryName(nProgram, eInterface, i);
+        GLint values[4] = { -1, 0, 1, -1 };
+        glGetProgramResourceiv(nProgram, eInterface, i, nProperties, properties, nProperties, nullptr, values);
+        variable.nLocation = values[0];
+        variable.eType = static_cast<GLenum>(values[1]);
+        variable.nArraySize = values[2];
+        variable.nBlockIndex = values[3];
+      }
+      std::sort(variables.begin(), variables.end(), [](const SVariable& a, const SVariable& b) { return a.strName < b.strName; });
+      return variables;
+    }
+
+    /**
+     * \brief Finds a variable by name in a sorted vector.
+     */
+    static const SVariable* find(const std::vector<SVariable>& variables, std::string_view strName)
+    {
+      auto it = std::lower_bound(variables.begin(), variables.end(), strName, [](const SVariable& variable, std::string_view str) { return variable.strName < str; });
+      return it != variables.end() && it->strName == strName ? &*it : nullptr;
+    }
+
+    //!\brief Appends the bytes of a value to serialized data
+    template<typename T>
+    static void writeValue(std::string& strData, T value) { strData.append(reinterpret_cast<const char*>(&value), sizeof(value)); }
+
+    //!\brief Appends a string and its length to serialized data
+    static void writeString(std::string& strData, const std::string& str)
+    {
+      writeValue(strData, static_cast<std::uint16_t>(str.size()));
+      strData += str;
+    }
+
+    //!\brief Reads a value from serialized data, returns \c false if it is truncated
+    template<typename T>
+    static bool readValue(std::string_view& strData, T& value)
+    {
+      if (strData.size() < sizeof(value))
+        return false;
+      std::memcpy(&value, strData.data(), sizeof(value));
+      strData.remove_prefix(sizeof(value));
+      return true;
+    }
+
+    //!\brief Reads a string and its length from serialized data, returns \c false if it is truncated
+    static bool readString(std::string_view& strData, std::string& str)
+    {
+      std::uint16_t nLength = 0;
+      if (!readValue(strData, nLength) || strData.size() < nLength)
+        return false;
+      str.assign(strData.data(), nLength);
+      strData.remove_prefix(nLength);
+      return true;
+    }
+  };
+
+  /**
+   * \brief A directory of serialized program reflections, keyed by program key.
+   *
+   * On a cold start, GetReflection() queries the reflection of each program and stores it. On a warm start, it
+   * restores them from disk without any introspection query. When a stored reflection is stale or corrupted, it
+   * is queried again and overwritten. Since keys depend on sources and driver (see ComputeProgramKey()), editing
+   * a shader or updating the driver never restores a wrong reflection.
+   *
+   * \code{.cpp}
+   * GLShaderPP::CReflectionCache cache("cache/reflection");
+   * const std::uint64_t nKey = GLShaderPP::ComputeProgramKey({ strVertexSource, strFragmentSource });
+   * GLShaderPP::CProgramReflection reflection = cache.GetReflection(program, nKey);
+   * glUniform1f(reflection.GetUniformLocation("time"), fTime);
+   * \endcode
+   */
+  class CReflectionCache
+  {
+    std::filesystem::path m_directory;  //!< The directory of serialized reflections
+    std::size_t m_nHits = 0;            //!< Number of reflections restored by GetReflection()
+    std::size_t m_nMisses = 0;          //!< Number of reflections queried by GetReflection()
+
+  public:
+    /**
+     * \brief Creates a cache in a directory. The directory is created if needed.
+     */
+    explicit CReflectionCache(std::filesystem::path directory) : m_directory(std::move(directory))
+    {
+      std::error_code error;
+      std::filesystem::create_directories(m_directory, error);
+    }
+
+    /**
+     * \brief Restores the reflection of a program, or queries and stores it if it is not in the cache.
+     *
+     * \param program The linked program.
+     * \param nKey The key of the program, usually from ComputeProgramKey().
+     */
+    CProgramReflection GetReflection(const CShaderProgramBase& program, std::uint64_t nKey)
+    {
+      if (std::optional<CProgramReflection> reflection = Load(nKey))
+      {
+        ++m_nHits;
+        return std::move(*reflection);
+      }
+      ++m_nMisses;
+      CProgramReflection reflection = CProgramReflection::Query(program);
+      Store(nKey, reflection);
+      return reflection;
+    }
+
+    /**
+     * \brief Restores a reflection from the cache.
+     *
+     * \return The reflection, or \c std::nullopt if it is not in the cache, or is stale or corrupted.
+     */
+    std::optional<CProgramReflection> Load(std::uint64_t nKey) const
+    {
+      std::ifstream file(GetPath(nKey), std::ios::binary);
+      if (!file)
+        return std::nullopt;
+      return CProgramReflection::Read(file, nKey);
+    }
+
+    /**
+     * \brief Stores a reflection in the cache.
+     *
+     * The reflection is written to a temporary file which is then renamed, so that concurrent processes never
+     * read a partially written reflection. The temporary file name is unique to the calling process and thread,
+     * so that concurrent writers of the same key never write into the same file.
+     *
+     * \return \c false if the reflection cannot be written.
+     */
+    bool Store(std::uint64_t nKey, const CProgramReflection& reflection) const
+    {
+      const std::filesystem::path path = GetPath(nKey);
+      const std::filesystem::path temporaryPath = getTemporaryPath(path);
+      std::error_code error;
+      {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file || !reflection.Write(file, nKey))
+        {
+          file.close();
+          std::filesystem::remove(temporaryPath, error);
+          return false;
+        }
+      }
+      std::filesystem::rename(temporaryPath, path, error);
+      if (error)
+      {
+        std::error_code removeError;
+        std::filesystem::remove(temporaryPath, removeError);
+      }
+      return !error;
+    }
+
+    /**
+     * \brief Gets the path of the file storing the reflection of a key.
+     */
+    std::filesystem::path GetPath(std::uint64_t nKey) const
+    {
+      char szName[24];
+      std::snprintf(szName, sizeof(szName), "%016llx.glrefl", static_cast<unsigned long long>(nKey));
+      return m_directory / szName;
+    }
+
+    /**
+     * \brief Gets the number of reflections restored from disk by GetReflection().
+     */
+    std::size_t GetHitCount() const { return m_nHits; }
+
+    /**
+     * \brief Gets the number of reflections queried by GetReflection(), because they were missing, stale or corrupted.
+     */
+    std::size_t GetMissCount() const { return m_nMisses; }
+
+  private:
+    /**
+     * \brief Gets a temporary path next to \c path, unique to the calling process and thread.
+     *
+     * The name is made of the process identifier, a hash of the thread identifier and a random suffix.
+     */
+    static std::filesystem::path getTemporaryPath(const std::filesystem::path& path)
+    {
+#ifdef _WIN32
+      const unsigned long long nProcess = static_cast<unsigned long long>(_getpid());
+#else
+      const unsigned long long nProcess = static_cast<unsigned long long>(getpid());
+#endif
+      thread_local std::mt19937_64 random{ std::random_device{}() };
+      char szSuffix[64];
+      std::snprintf(szSuffix, sizeof(szSuffix), ".%llu-%016llx-%016llx.tmp", nProcess,
+        static_cast<unsigned long long>(std::hash<std::thread::id>{}(std::this_thread::get_id())), static_cast<unsigned long long>(random()));
+      std::filesystem::path temporaryPath = path;
+      temporaryPath += szSuffix;
+      return temporaryPath;
+    }
+  };
+
+}
@@ -0,0 +1,361 @@
+/*****************************************************************//**
+ * \file      ProgramRegistry.h
+ * \brief     Declaration of CProgramRegistry class
+ *
+ * \author    Benjamin ALBOUY-KISSI
+ * \date      2022
+ * \copyright GNU Lesser Public License v3
+ *********************************************************************/
+#pragma once
+#include "ShaderProgram.h"
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace GLShaderPP {
+
+  /**
+   * \brief A thread safe registry of named shader programs, whose lookups never lock.
+   *
+   * The registry owns its programs. Each one is registered with a name and identified by a Handle, which
+   * stays the same when its program is replaced, for instance when shaders are reloaded.
+   *
+   * Lookups go through an immutable snapshot of the registry. Each thread looking up programs creates its
+   * own CReader, then pins the current snapshot with CReader::Pin() for the time it uses the found programs.
+   * Pinning and looking up only involve atomic loads and stores, never a lock, so that many threads (render,
+   * culling, UI...) can look up programs every frame without contention.
+   *
+   * Register(), Replace() and Remove() may be called from any thread. They are serialized by a mutex, and
+   * publish a new snapshot with an atomic pointer swap. The previous snapshot and the replaced or removed
+   * programs are retired instead of being deleted, since some threads may still use them. Reclaim(), called
+   * by the thread whose OpenGL context owns the programs (typically once per frame), deletes those which
+   * can no longer be seen by any pinned snapshot. This is an epoch based reclamation scheme: a retired object
+   * is tagged with the epoch at which it was retired, and each pinned snapshot records the epoch at which it
+   * was pinned.
+   *
+   * \code{.cpp}
+   * //On any thread, once
+   * GLShaderPP::CProgramRegistry::CReader reader(registry);
+   * //Every frame
+   * {
+   *   auto snapshot = reader.Pin();
+   *   if (GLShaderPP::CShaderProgram* pSky = snapshot.Find("sky"))
+   *     pSky->Use();
+   * }
+   * \endcode
+   */
+  class CProgramRegistry
+  {
+  public:
+    //!\brief Identifier of a registered program
+    using Handle = std::size_t;
+
+    //!\brief Handle never given to a registered program
+    static constexpr Handle invalidHandle = 0;
+
+  private:
+    //!\brief Epoch of a reader which has not pinned any snapshot
+    static constexpr std::uint64_t idleEpoch = std::numeric_limits<std::uint64_t>::max();
+
+    //!\brief An immutable view of the registry
+    struct SSnapshot
+    {
+      std::unordered_map<std::string, Handle> handles;        //!< Handles of programs, by name
+      std::unordered_map<Handle, CShaderProgram*> programs;   //!< Programs, by handle
+    };
+
+    //!\brief A registered program
+    struct SEntry
+    {
+      std::string strName;                      //!< Name of the program
+      std::unique_ptr<CShaderProgram> pProgram; //!< The program
+    };
+
+    //!\brief A snapshot or a program waiting to be deleted
+    struct SRetired
+    {
+      std::uint64_t nEpoch;                     //!< Epoch at which it was retired
+      std::unique_ptr<const SSnapshot> pSnapshot; //!< The retired snapshot, may be \c nullptr
+      std::unique_ptr<CShaderProgram> pProgram; //!< The retired program, may be \c nullptr
+    };
+
+    //!\brief The epoch pinned by a reader
+    struct SReaderSlot
+    {
+      std::atomic<std::uint64_t> nEpoch{ idleEpoch }; //!< Epoch of the pinned snapshot, idleEpoch if none
+      std::atomic<bool> bUsed{ true };                //!< Whether a CReader owns this slot
+      SReaderSlot* pNext = nullptr;                   //!< Next slot of the registry
+    };
+
+    std::atomic<const SSnapshot*> m_pSnapshot;          //!< The current snapshot
+    std::atomic<std::uint64_t> m_nEpoch{ 1 };           //!< The current epoch
+    std::atomic<SReaderSlot*> m_pReaders{ nullptr };    //!< Slots of readers, never deleted before the registry
+    std::mutex m_writeMutex;                            //!< Serializes writes and reclamation
+    std::unordered_map<Handle, SEntry> m_entries;       //!< Registered programs, guarded by m_writeMutex
+    std::vector<SRetired> m_retired;                    //!< Retired objects, guarded by m_writeMutex
+    Handle m_nNextHandle = invalidHandle + 1;           //!< Handle of the next registered program, guarded by m_writeMutex
+
+    CProgramRegistry(const CProgramRegistry&) = delete;
+    CProgramRegistry& operator=(const CProgramRegistry&) = delete;
+
+  public:
+    /**
+     * \brief A snapshot of the registry pinned by a reader.
+     *
+     * Programs found in a pinned snapshot are not deleted before it is unpinned, even if they are replaced or
+     * removed meanwhile. A snapshot is unpinned when this object is destroyed.
+     */
+    class CPinnedSnapshot
+    {
+      friend class CProgramRegistry;
+
+      SReaderSlot* m_pSlot;          //!< Slot of the reader which pinned the snapshot
+      const SSnapshot* m_pSnapshot;  //!< The pinned snapshot
+
+      CPinnedSnapshot(SReaderSlot* pSlot, const SSnapshot* pSnapshot) : m_pSlot(pSlot), m_pSnapshot(pSnapshot) {}
+      CPinnedSnapshot(const CPinnedSnapshot&) = delete;
+      CPinnedSnapshot& operator=(const CPinnedSnapshot&) = delete;
+
+    public:
+      /**
+       * \brief Unpins the snapshot.
+       */
+      ~CPinnedSnapshot() { m_pSlot->nEpoch.store(idleEpoch); }
+
+      /**
+       * \brief Returns the program registered with a name, or \c nullptr if there is none.
+       */
+      CShaderProgram* Find(const std::string& strName) const
+      {
+        auto it = m_pSnapshot->handles.find(strName);
+        return it != m_pSnapshot->handles.end() ? Find(it->second) : nullptr;
+      }
+
+      /**
+       * \brief Returns the program registered with a handle, or \c nullptr if there is none.
+       */
+      CShaderProgram* Find(Handle handle) const
+      {
+        auto it = m_pSnapshot->programs.find(handle);
+        return it != m_pSnapshot->programs.end() ? it->second : nullptr;
+      }
+
+      /**
+       * \brief Returns the handle of the program registered with a name, or invalidHandle if there is none.
+       */
+      Handle GetHandle(const std::string& strName) const
+      {
+        auto it = m_pSnapshot->handles.find(strName);
+        return it != m_pSnapshot->handles.end() ? it->second : invalidHandle;
+      }
+
+      /**
+       * \brief Returns the number of programs in the snapshot.
+       */
+      std::size_t GetSize() const { return m_pSnapshot->programs.size(); }
+    };
+
+    /**
+     * \brief The access of a thread to the snapshots of a registry.
+     *
+     * Each thread looking up programs needs its own reader, which must not outlive the registry. A reader
+     * pins at most one snapshot at a time.
+     */
+    class CReader
+    {
+      CProgramRegistry& m_registry; //!< The registry to read
+      SReaderSlot* m_pSlot;         //!< The slot owned by this reader
+
+      CReader(const CReader&) = delete;
+      CReader& operator=(const CReader&) = delete;
+
+    public:
+      /**
+       * \brief Creates a reader of a registry.
+       */
+      explicit CReader(CProgramRegistry& registry) : m_registry(registry), m_pSlot(registry.acquireSlot()) {}
+
+      /**
+       * \brief Gives the slot of this reader back to the registry.
+       */
+      ~CReader() { m_pSlot->bUsed.store(false); }
+
+      /**
+       * \brief Pins the current snapshot of the registry.
+       *
+       * This function never locks. The previous snapshot pinned by this reader must have been unpinned.
+       */
+      CPinnedSnapshot Pin()
+      {
+        m_pSlot->nEpoch.store(m_registry.m_nEpoch.load());
+        return CPinnedSnapshot(m_pSlot, m_registry.m_pSnapshot.load());
+      }
+    };
+
+    /**
+     * \brief Creates an empty registry.
+     */
+    CProgramRegistry() : m_pSnapshot(new SSnapshot) {}
+
+    /**
+     * \brief Deletes every program of the registry.
+     *
+     * The registry must be destroyed while the OpenGL context owning its programs is current, and after every
+     * CReader.
+     */
+    ~CProgramRegistry()
+    {
+      delete m_pSnapshot.load();
+      for (SReaderSlot* pSlot = m_pReaders.load(); pSlot;)
+      {
+        SReaderSlot* pNext = pSlot->pNext;
+        delete pSlot;
+        pSlot = pNext;
+      }
+    }
+
+    /**
+     * \brief Registers a program with a name.
+     *
+     * If a program is already registered with this name, it is replaced as by Replace().
+     *
+     * \param strName The name of the program.
+     * \param pProgram The program, owned by the registry from now on.
+     * \return The handle of the program.
+     */
+    Handle Register(std::string strName, std::unique_ptr<CShaderProgram> pProgram)
+    {
+      std::lock_guard<std::mutex> lock(m_writeMutex);
+      const SSnapshot* pCurrent = m_pSnapshot.load();
+      auto itHandle = pCurrent->handles.find(strName);
+      if (itHandle != pCurrent->handles.end())
+      {
+        SEntry& entry = m_entries[itHandle->second];
+        std::unique_ptr<CShaderProgram> pOld = std::exchange(entry.pProgram, std::move(pProgram));
+        publish(std::move(pOld));
+        return itHandle->second;
+      }
+
+      const Handle handle = m_nNextHandle++;
+      m_entries.emplace(handle, SEntry{ std::move(strName), std::move(pProgram) });
+      publish(nullptr);
+      return handle;
+    }
+
+    /**
+     * \brief Replaces the program registered with a handle.
+     *
+     * Threads which pinned a snapshot before the replacement keep on seeing the previous program until they
+     * unpin it, then Reclaim() deletes it.
+     *
+     * \param handle The handle of the program to replace.
+     * \param pProgram The new program, owned by the registry from now on.
+     * \return \c false if there is no program with this handle.
+     */
+    bool Replace(Handle handle, std::unique_ptr<CShaderProgram> pProgram)
+    {
+      std::lock_guard<std::mutex> lock(m_writeMutex);
+      auto it = m_entries.find(handle);
+      if (it == m_entries.end())
+        return false;
+      std::unique_ptr<CShaderProgram> pOld = std::exchange(it->second.pProgram, std::move(pProgram));
+      publish(std::move(pOld));
+      return true;
+    }
+
+    /**
+     * \brief Removes a program from the registry.
+     *
+     * The program is deleted by Reclaim() once no pinned snapshot can see it.
+     *
+     * \param handle The handle of the program to remove.
+     * \return \c false if there is no program with this handle.
+     */
+    bool Remove(Handle handle)
+    {
+      std::lock_guard<std::mutex> lock(m_writeMutex);
+      auto it = m_entries.find(handle);
+      if (it == m_entries.end())
+        return false;
+      std::unique_ptr<CShaderProgram> pOld = std::move(it->second.pProgram);
+      m_entries.erase(it);
+      publish(std::move(pOld));
+      return true;
+    }
+
+    /**
+     * \brief Deletes the retired snapshots and programs which can no longer be seen by a pinned snapshot.
+     *
+     * This function must be called while the OpenGL context owning the programs is current.
+     *
+     * \return The number of deleted programs.
+     */
+    std::size_t Reclaim()
+    {
+      std::vector<SRetired> reclaimed;
+      {
+        //Readers are scanned with writes locked out, so that nothing is retired after a reader is seen idle
+        std::lock_guard<std::mutex> lock(m_writeMutex);
+        std::uint64_t nOldestPinned = idleEpoch;
+        for (SReaderSlot* pSlot = m_pReaders.load(); pSlot; pSlot = pSlot->pNext)
+          nOldestPinned = std::min(nOldestPinned, pSlot->nEpoch.load());
+        auto itKept = std::partition(m_retired.begin(), m_retired.end(), [nOldestPinned](const SRetired& retired) { return retired.nEpoch > nOldestPinned; });
+        std::move(itKept, m_retired.end(), std::back_inserter(reclaimed));
+        m_retired.erase(itKept, m_retired.end());
+      }
+      return static_cast<std::size_t>(std::count_if(reclaimed.begin(), reclaimed.end(), [](const SRetired& retired) { return retired.pProgram != nullptr; }));
+    }
+
+    /**
+     * \brief Returns the number of retired snapshots and programs waiting for Reclaim().
+     */
+    std::size_t GetRetiredCount()
+    {
+      std::lock_guard<std::mutex> lock(m_writeMutex);
+      return m_retired.size();
+    }
+
+  private:
+    /**
+     * \brief Returns a free reader slot, or creates one.
+     */
+    SReaderSlot* acquireSlot()
+    {
+      for (SReaderSlot* pSlot = m_pReaders.load(); pSlot; pSlot = pSlot->pNext)
+      {
+        bool bUsed = false;
+        if (pSlot->bUsed.compare_exchange_strong(bUsed, true))
+          return pSlot;
+      }
+      SReaderSlot* pSlot = new SReaderSlot;
+      pSlot->pNext = m_pReaders.load();
+      while (!m_pReaders.compare_exchange_weak(pSlot->pNext, pSlot));
+      return pSlot;
+    }
+
+    /**
+     * \brief Publishes a snapshot of m_entries and retires the previous one. m_writeMutex must be locked.
+     *
+     * \param pOldProgram A replaced or removed program to retire with the previous snapshot, may be \c nullptr.
+     */
+    void publish(std::unique_ptr<CShaderProgram> pOldProgram)
+    {
+      auto pSnapshot = std::make_unique<SSnapshot>();
+      for (const auto& [handle, entry] : m_entries)
+      {
+        pSnapshot->handles.emplace(entry.strName, handle);
+        pSnapshot->programs.emplace(handle, entry.pProgram.get());
+      }
+      const SSnapshot* pOld = m_pSnapshot.exchange(pSnapshot.release());
+      //Readers pinning from now on can only see the new snapshot
+      const std::uint64_t nEpoch = m_nEpoch.fetch_add(1) + 1;
+      m_retired.push_back(SRetired{ nEpoch, std::unique_ptr<const SSnapshot>(pOld), std::move(pOldProgram) });
+    }
+  };
+
+}
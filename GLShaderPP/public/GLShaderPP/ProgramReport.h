@@ -0,0 +1,479 @@
+/*****************************************************************//**
+ * \file      ProgramReport.h
+ * \brief     Declaration of CProgramReport class
+ *
+ * \author    Benjamin ALBOUY-KISSI
+ * \date      2022
+ * \copyright GNU Lesser Public License v3
+ *********************************************************************/
+#pragma once
+#include "ShaderProgram.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <iomanip>
+#include <istream>
+#include <iterator>
+#include <locale>
+#include <map>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace GLShaderPP {
+
+  /**
+   * \brief Size and complexity metrics of a linked shader program.
+   */
+  struct SProgramMetrics
+  {
+    std::size_t nBinarySize = 0;        //!< Binary size reported by \c GL_PROGRAM_BINARY_LENGTH, 0 if the driver can't report it
+    std::size_t nActiveUniforms = 0;    //!< Number of active uniforms, including members of uniform blocks
+    std::size_t nActiveAttributes = 0;  //!< Number of active vertex attributes
+    std::size_t nUniformBlocks = 0;     //!< Number of active uniform blocks
+    double dCompileMilliseconds = 0.;   //!< Time spent compiling the shaders of the program
+    double dLinkMilliseconds = 0.;      //!< Time spent linking the program
+  };
+
+  /**
+   * \brief Thresholds of the metric growths reported as regressions by CProgramReport::Compare().
+   *
+   * A metric regresses when it grows by more than its ratio of the baseline value and, for durations, by more
+   * than \c dMinimumMilliseconds, so that timing noise on tiny programs is not reported.
+   */
+  struct SReportThresholds
+  {
+    double dBinarySize = 0.1;           //!< Allowed relative growth of the binary size
+    double dCounts = 0.25;              //!< Allowed relative growth of uniform, attribute and block counts
+    double dDurations = 0.5;            //!< Allowed relative growth of compile and link durations
+    double dMinimumMilliseconds = 2.;   //!< Growth of durations below this is never reported
+  };
+
+  /**
+   * \brief A metric of a program which grew beyond its threshold.
+   */
+  struct SRegression
+  {
+    std::string strProgram;   //!< The name of the program
+    std::string strMetric;    //!< The name of the metric, as written in JSON reports
+    double dBaseline = 0.;    //!< The value of the metric in the baseline
+    double dCurrent = 0.;     //!< The current value of the metric
+  };
+
+  /**
+   * \brief Records size and complexity metrics of shader programs, and compares them with a baseline.
+   *
+   * Shader edits may silently grow the binary size or the compile time of a program. A CProgramReport records
+   * the metrics of each program by name, writes them in a stable JSON format with WriteJson(), reads a stored
+   * report back with ReadJson(), and lists the metrics which regressed from a baseline report with Compare(),
+   * so that a continuous integration job can fail on shader regressions.
+   *
+   * \code{.cpp}
+   * GLShaderPP::CProgramReport report;
+   * report.RecordDriver();
+   * report.Record("sky", skyProgram, dCompileMilliseconds, dLinkMilliseconds);
+   * std::ifstream baselineFile("baseline.json");
+   * if (std::optional<GLShaderPP::CProgramReport> baseline = GLShaderPP::CProgramReport::ReadJson(baselineFile))
+   *   for (const GLShaderPP::SRegression& regression : report.Compare(*baseline))
+   *     std::cerr << regression.strProgram << ": " << regression.strMetric << " regressed\n";
+   * \endcode
+   *
+   * The \c programReport command line tool builds programs from GLSL files and does the same.
+   *
+   * Compile durations only mean something on drivers which compile shaders when asked to. Some drivers defer
+   * the work until link, or skip it thanks to their shader cache, which should be disabled while measuring.
+   */
+  class CProgramReport
+  {
+    static constexpr const char* format = "glshaderpp-program-report"; //!< Value of the "format" key of JSON reports
+    static constexpr int version = 1;                                   //!< Value of the "version" key of JSON reports
+
+    std::string m_strDriver;                            //!< Vendor, renderer and version of the driver which built programs
+    std::map<std::string, SProgramMetrics> m_programs;  //!< Metrics of programs, sorted by name for stable output
+
+  public:
+    /**
+     * \brief Records the vendor, renderer and version strings of the current OpenGL context.
+     */
+    void RecordDriver()
+    {
+      m_strDriver.clear();
+      for (GLenum eName : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+      {
+        const GLubyte* pString = glGetString(eName);
+        if (!m_strDriver.empty())
+          m_strDriver += " / ";
+        m_strDriver += pString ? reinterpret_cast<const char*>(pString) : "";
+      }
+    }
+
+    /**
+     * \brief Queries and records the metrics of a linked program.
+     *
+     * \param strName The name of the program in the report. A program already recorded with this name is replaced.
+     * \param program The linked program.
+     * \param dCompileMilliseconds The time spent compiling its shaders, measured by the caller.
+     * \param dLinkMilliseconds The time spent linking it, measured by the caller.
+     * \return The recorded metrics.
+     */
+    const SProgramMetrics& Record(const std::string& strName, const CShaderProgramBase& program, double dCompileMilliseconds, double dLinkMilliseconds)
+    {
+      SProgramMetrics metrics;
+      metrics.nBinarySize = program.GetBinarySize();
+      GLint nValue = 0;
+      glGetProgramiv(program.GetProgramId(), GL_ACTIVE_UNIFORMS, &nValue);
+      metrics.nActiveUniforms = static_cast<std::size_t>(nValue);
+      nValue = 0;
+      glGetProgramiv(program.GetProgramId(), GL_ACTIVE_ATTRIBUTES, &nValue);
+      metrics.nActiveAttributes = static_cast<std::size_t>(nValue);
+      nValue = 0;
+      glGetProgramiv(program.GetProgramId(), GL_ACTIVE_UNIFORM_BLOCKS, &nValue);
+      metrics.nUniformBlocks = static_cast<std::size_t>(nValue);
+      metrics.dCompileMilliseconds = dCompileMilliseconds;
+      metrics.dLinkMilliseconds = dLinkMilliseconds;
+      return Record(strName, metrics);
+    }
+
+    /**
+     * \brief Records the metrics of a program.
+     *
+     * \param strName The name of the program in the report. A program already recorded with this name is replaced.
+     * \param metrics The metrics of the program.
+     * \return The recorded metrics.
+     */
+    const SProgramMetrics& Record(const std::string& strName, const SProgramMetrics& metrics) { return m_programs[strName] = metrics; }
+
+    /**
+     * \brief Returns the metrics of a recorded program, or \c nullptr if no program has this name.
+     */
+    const SProgramMetrics* Find(const std::string& strName) const
+    {
+      auto it = m_programs.find(strName);
+      return it == m_programs.end() ? nullptr : &it->second;
+    }
+
+    /**
+     * \brief Returns the metrics of the recorded programs, sorted by name.
+     */
+    const std::map<std::string, SProgramMetrics>& GetPrograms() const { return m_programs; }
+
+    /**
+     * \brief Returns the driver recorded by RecordDriver(), or an empty string.
+     */
+    const std::string& GetDriver() const { return m_strDriver; }
+
+    /**
+     * \brief Lists the metrics which grew beyond their thresholds since a baseline report.
+     *
+     * Programs which are not in both reports are ignored.
+     *
+     * \param baseline The reference report, usually read from a stored file.
+     * \param thresholds The allowed growths.
+     * \return The regressions, sorted by program name, then in the order of the metrics in JSON reports.
+     */
+    std::vector<SRegression> Compare(const CProgramReport& baseline, const SReportThresholds& thresholds = {}) const
+    {
+      std::vector<SRegression> regressions;
+      for (const auto& [strName, metrics] : m_programs)
+      {
+        const SProgramMetrics* pBaseline = baseline.Find(strName);
+        if (!pBaseline)
+          continue;
+        auto check = [&](const char* pMetric, double dBaseline, double dCurrent, double dRatio, double dMinimum) {
+          if (dCurrent - dBaseline > std::max(dBaseline * dRatio, dMinimum))
+            regressions.push_back({ strName, pMetric, dBaseline, dCurrent });
+        };
+        check("binarySize", static_cast<double>(pBaseline->nBinarySize), static_cast<double>(metrics.nBinarySize), thresholds.dBinarySize, 0.);
+        check("activeUniforms", static_cast<double>(pBaseline->nActiveUniforms), static_cast<double>(metrics.nActiveUniforms), thresholds.dCounts, 0.);
+        check("activeAttributes", static_cast<double>(pBaseline->nActiveAttributes), static_cast<double>(metrics.nActiveAttributes), thresholds.dCounts, 0.);
+        check("uniformBlocks", static_cast<double>(pBaseline->nUniformBlocks), static_cast<double>(metrics.nUniformBlocks), thresholds.dCounts, 0.);
+        check("compileMilliseconds", pBaseline->dCompileMilliseconds, metrics.dCompileMilliseconds, thresholds.dDurations, thresholds.dMinimumMilliseconds);
+        check("linkMilliseconds", pBaseline->dLinkMilliseconds, metrics.dLinkMilliseconds, thresholds.dDurations, thresholds.dMinimumMilliseconds);
+      }
+      return regressions;
+    }
+
+    /**
+     * \brief Writes this report in JSON.
+     *
+     * The output only depends on the recorded values: programs are sorted by name, keys are always written in the
+     * same order, and durations are written with three decimals whatever the locale is, so that reports can be
+     * stored and diffed.
+     *
+     * \return \c false if the stream is in error.
+     */
+    bool WriteJson(std::ostream& stream) const
+    {
+      std::ostringstream json;
+      json.imbue(std::locale::classic());
+      json << std::fixed << std::setprecision(3);
+      json << "{\n  \"format\": \"" << format << "\",\n  \"version\": " << version << ",\n";
+      json << "  \"driver\": ";
+      writeString(json, m_strDriver);
+      json << ",\n  \"programs\": [";
+      bool bFirst = true;
+      for (const auto& [strName, metrics] : m_programs)
+      {
+        json << (bFirst ? "\n" : ",\n") << "    {\n      \"name\": ";
+        writeString(json, strName);
+        json << ",\n      \"binarySize\": " << metrics.nBinarySize
+             << ",\n      \"activeUniforms\": " << metrics.nActiveUniforms
+             << ",\n      \"activeAttributes\": " << metrics.nActiveAttributes
+             << ",\n      \"uniformBlocks\": " << metrics.nUniformBlocks
+             << ",\n      \"compileMilliseconds\": " << metrics.dCompileMilliseconds
+             << ",\n      \"linkMilliseconds\": " << metrics.dLinkMilliseconds << "\n    }";
+        bFirst = false;
+      }
+      json << (bFirst ? "]\n}\n" : "\n  ]\n}\n");
+      const std::string strJson = json.str();
+      stream.write(strJson.data(), strJson.size());
+      return stream.good();
+    }
+
+    /**
+     * \brief Reads a report written by WriteJson().
+     *
+     * Unknown keys are ignored, so that reports written by later versions can be read.
+     *
+     * \return The report, or \c std::nullopt if the stream does not contain a valid report.
+     */
+    static std::optional<CProgramReport> ReadJson(std::istream& stream)
+    {
+      const std::string strJson{ std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>() };
+      CJsonParser parser{ strJson };
+      CProgramReport report;
+      std::string strFormat;
+      double dVersion = 0.;
+      bool bProgramsOk = true;
+      const bool bOk = parser.ParseObject([&](const std::string& strKey) {
+        if (strKey == "format")
+          return parser.ParseString(strFormat);
+        if (strKey == "version")
+          return parser.ParseNumber(dVersion);
+        if (strKey == "driver")
+          return parser.ParseString(report.m_strDriver);
+        if (strKey == "programs")
+          return parser.ParseArray([&]() {
+            std::string strName;
+            SProgramMetrics metrics;
+            if (!parser.ParseObject([&](const std::string& strMetric) { return parseMetric(parser, strMetric, strName, metrics); }) || strName.empty())
+              return bProgramsOk = false;
+            report.m_programs[strName] = metrics;
+            return true;
+          });
+        return parser.SkipValue();
+        });
+      if (!bOk || !bProgramsOk || !parser.AtEnd() || strFormat != format || dVersion != version)
+        return std::nullopt;
+      return report;
+    }
+
+  private:
+    /**
+     * \brief Writes a JSON string literal.
+     */
+    static void writeString(std::ostream& json, std::string_view str)
+    {
+      json << '"';
+      for (char c : str)
+        switch (c)
+        {
+        case '"': json << "\\\""; break;
+        case '\\': json << "\\\\"; break;
+        case '\n': json << "\\n"; break;
+        case '\r': json << "\\r"; break;
+        case '\t': json << "\\t"; break;
+        default:
+          if (static_cast<unsigned char>(c) < 0x20)
+          {
+            char escape[7];
+            std::snprintf(escape, sizeof(escape), "\\u%04x", static_cast<unsigned>(c));
+            json << escape;
+          }
+          else
+            json << c;
+        }
+      json << '"';
+    }
+
+    /**
+     * \brief A minimal JSON parser, for the reports written by WriteJson().
+     */
+    class CJsonParser
+    {
+      std::string_view m_strJson; //!< The remaining JSON text
+
+    public:
+      explicit CJsonParser(std::string_view strJson) : m_strJson(strJson) {}
+
+      //!\brief Tells if only white spaces remain.
+      bool AtEnd() { skipSpaces(); return m_strJson.empty(); }
+
+      //!\brief Parses an object, calling \c onMember with each key, which must parse the value.
+      template<typename F>
+      bool ParseObject(F onMember)
+      {
+        if (!consume('{'))
+          return false;
+        if (consume('}'))
+          return true;
+        do
+        {
+          std::string strKey;
+          if (!ParseString(strKey) || !consume(':') || !onMember(strKey))
+            return false;
+        } while (consume(','));
+        return consume('}');
+      }
+
+      //!\brief Parses an array, calling \c onElement, which must parse each element.
+      template<typename F>
+      bool ParseArray(F onElement)
+      {
+        if (!consume('['))
+          return false;
+        if (consume(']'))
+          return true;
+        do
+        {
+          if (!onElement())
+            return false;
+        } while (consume(','));
+        return consume(']');
+      }
+
+      //!\brief Parses a string. Escaped characters beyond ASCII are replaced by '?'.
+      bool ParseString(std::string& str)
+      {
+        if (!consume('"'))
+          return false;
+        str.clear();
+        while (!m_strJson.empty())
+        {
+          char c = m_strJson.front();
+          m_strJson.remove_prefix(1);
+          if (c == '"')
+            return true;
+          if (c != '\\')
+          {
+            str += c;
+            continue;
+          }
+          if (m_strJson.empty())
+            return false;
+          c = m_strJson.front();
+          m_strJson.remove_prefix(1);
+          switch (c)
+          {
+          case 'n': str += '\n'; break;
+          case 'r': str += '\r'; break;
+          case 't': str += '\t'; break;
+          case 'b': str += '\b'; break;
+          case 'f': str += '\f'; break;
+          case 'u':
+          {
+            if (m_strJson.size() < 4)
+              return false;
+            unsigned nCode = 0;
+            for (char digit : m_strJson.substr(0, 4))
+            {
+              const std::size_t nDigit = std::string_view("0123456789abcdef").find(static_cast<char>(std::tolower(digit, std::locale::classic())));
+              if (nDigit == std::string_view::npos)
+                return false;
+              nCode = nCode * 16 + static_cast<unsigned>(nDigit);
+            }
+            m_strJson.remove_prefix(4);
+            str += nCode < 0x80 ? static_cast<char>(nCode) : '?';
+            break;
+          }
+          default: str += c; break;
+          }
+        }
+        return false;
+      }
+
+      //!\brief Parses a number.
+      bool ParseNumber(double& dValue)
+      {
+        skipSpaces();
+        const std::size_t nLength = m_strJson.find_first_not_of("+-0123456789.eE");
+        std::istringstream number(std::string(m_strJson.substr(0, nLength)));
+        number.imbue(std::locale::classic());
+        if (!(number >> dValue) || number.peek() != std::char_traits<char>::eof())
+          return false;
+        m_strJson.remove_prefix(nLength == std::string_view::npos ? m_strJson.size() : nLength);
+        return true;
+      }
+
+      //!\brief Skips a value of any type.
+      bool SkipValue()
+      {
+        skipSpaces();
+        if (m_strJson.empty())
+          return false;
+        std::string str;
+        double dValue;
+        switch (m_strJson.front())
+        {
+        case '{': return ParseObject([this](const std::string&) { return SkipValue(); });
+        case '[': return ParseArray([this]() { return SkipValue(); });
+        case '"': return ParseString(str);
+        case 't': return consumeWord("true");
+        case 'f': return consumeWord("false");
+        case 'n': return consumeWord("null");
+        default: return ParseNumber(dValue);
+        }
+      }
+
+    private:
+      void skipSpaces()
+      {
+        const std::size_t nStart = m_strJson.find_first_not_of(" \t\r\n");
+        m_strJson.remove_prefix(nStart == std::string_view::npos ? m_strJson.size() : nStart);
+      }
+
+      bool consume(char c)
+      {
+        skipSpaces();
+        if (m_strJson.empty() || m_strJson.front() != c)
+          return false;
+        m_strJson.remove_prefix(1);
+        return true;
+      }
+
+      bool consumeWord(std::string_view strWord)
+      {
+        if (m_strJson.substr(0, strWord.size()) != strWord)
+          return false;
+        m_strJson.remove_prefix(strWord.size());
+        return true;
+      }
+    };
+
+    /**
+     * \brief Parses a member of a program object of a JSON report.
+     */
+    static bool parseMetric(CJsonParser& parser, const std::string& strKey, std::string& strName, SProgramMetrics& metrics)
+    {
+      if (strKey == "name")
+        return parser.ParseString(strName);
+      double dValue = 0.;
+      std::size_t* pCount = strKey == "binarySize" ? &metrics.nBinarySize : strKey == "activeUniforms" ? &metrics.nActiveUniforms
+        : strKey == "activeAttributes" ? &metrics.nActiveAttributes : strKey == "uniformBlocks" ? &metrics.nUniformBlocks : nullptr;
+      double* pDuration = strKey == "compileMilliseconds" ? &metrics.dCompileMilliseconds : strKey == "linkMilliseconds" ? &metrics.dLinkMilliseconds : nullptr;
+      if (!pCount && !pDuration)
+        return parser.SkipValue();
+      if (!parser.ParseNumber(dValue) || dValue < 0.)
+        return false;
+      if (pCount)
+        *pCount = static_cast<std::size_t>(dValue);
+      else
+        *pDuration = dValue;
+      return true;
+    }
+  };
+
+}
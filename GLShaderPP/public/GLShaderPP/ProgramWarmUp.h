@@ -0,0 +1,344 @@
+/*****************************************************************//**
+ * \file      ProgramWarmUp.h
+ * \brief     Declaration of CProgramWarmer class
+ *
+ * \author    Benjamin ALBOUY-KISSI
+ * \date      2022
+ * \copyright GNU Lesser Public License v3
+ *********************************************************************/
+#pragma once
+#include "ShaderProgram.h"
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <vector>
+
+namespace GLShaderPP {
+
+  /**
+   * \brief Forces drivers to finish the code generation of shader programs.
+   *
+   * Many drivers only finish the code generation of a shader program the first time it is used for
+   * drawing, not when it is linked. The first frame using a new program then takes longer than expected.
+   * A CProgramWarmer issues a minimal draw (or dispatch for compute programs) with a program into a tiny
+   * offscreen framebuffer, so that this work is done ahead of time, for instance during a loading screen.
+   *
+   * Warming up a program does not change the OpenGL state seen by the application: the current program,
+   * draw framebuffer, vertex array, viewport and the fixed function capabilities disabled for the draw are
+   * restored after each warm-up. Compute programs are warmed up by a dispatch of a single work group, with the
+   * storage and atomic counter buffers they use bound to a scratch buffer and the image units unbound, so they never
+   * touch the buffers and images bound by the application. Graphics programs run their stages once over a single
+   * pixel: if they write to storage buffers, images or atomic counters, these writes go to the current bindings, so
+   * unbind them before warming up such programs.
+   *
+   * A CProgramWarmer must be created and used while the OpenGL context is current.
+   */
+  class CProgramWarmer
+  {
+  public:
+    //!\brief Summary of a batch of warm-ups
+    struct SWarmUpReport
+    {
+      std::size_t nPrograms = 0;           //!< Number of warmed up programs
+      std::chrono::nanoseconds total{};    //!< Time spent to warm up all programs
+      std::chrono::nanoseconds longest{};  //!< Longest warm-up of a single program
+    };
+
+  private:
+    GLuint m_nFramebuffer = 0;           //!< The offscreen framebuffer
+    GLuint m_nRenderbuffer = 0;          //!< The single pixel color buffer of the offscreen framebuffer
+    GLuint m_nVertexArray = 0;           //!< An empty vertex array
+    GLuint m_nScratchBuffer = 0;         //!< Buffer bound to the storage and atomic counter buffers of compute programs, created on demand
+    GLsizeiptr m_nScratchBufferSize = 0; //!< Size of \c m_nScratchBuffer, in bytes
+
+    CProgramWarmer(const CProgramWarmer&) = delete;
+    CProgramWarmer& operator=(const CProgramWarmer&) = delete;
+
+  public:
+    /**
+     * \brief Creates the offscreen framebuffer and the empty vertex array used to warm up programs.
+     */
+    CProgramWarmer()
+    {
+      GLint nPreviousFramebuffer, nPreviousRenderbuffer;
+      glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &nPreviousFramebuffer);
+      glGetIntegerv(GL_RENDERBUFFER_BINDING, &nPreviousRenderbuffer);
+
+      glGenRenderbuffers(1, &m_nRenderbuffer);
+      glBindRenderbuffer(GL_RENDERBUFFER, m_nRenderbuffer);
+      glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, 1, 1);
+      glGenFramebuffers(1, &m_nFramebuffer);
+      glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_nFramebuffer);
+      glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_nRenderbuffer);
+      glGenVertexArrays(1, &m_nVertexArray);
+
+      glBindFramebuffer(GL_DRAW_FRAMEBUFFER, nPreviousFramebuffer);
+      glBindRenderbuffer(GL_RENDERBUFFER, nPreviousRenderbuffer);
+    }
+
+    /**
+     * \brief Deletes the offscreen framebuffer and the empty vertex array.
+     */
+    ~CProgramWarmer()
+    {
+      glDeleteBuffers(1, &m_nScratchBuffer);
+      glDeleteVertexArrays(1, &m_nVertexArray);
+      glDeleteFramebuffers(1, &m_nFramebuffer);
+      glDeleteRenderbuffers(1, &m_nRenderbuffer);
+    }
+
+    /**
+     * \brief Warms up a shader program.
+     *
+     * The program is used for a draw of a few vertices without any vertex attribute into a single pixel
+     * framebuffer, with blending, depth, stencil, scissor tests, face culling and rasterizer discard disabled,
+     * or for a dispatch of a single work group if it is a compute program. The draw mode matches the program
+     * stages (patches for tesselation, geometry shader input type otherwise). Then this function waits for the
+     * driver to finish.
+     *
+     * \param program The program to warm up. Nothing is done if it is not linked, or if transform feedback is
+     * active, since the draw would be captured.
+     * \return The time spent to warm up the program.
+     */
+    std::chrono::nanoseconds WarmUp(CShaderProgramBase& program)
+    {
+      if (program.GetLinkingStatus() != CShaderProgramBase::LinkingStatus::linkingOk)
+        return std::chrono::nanoseconds::zero();
+      GLboolean bTransformFeedback = GL_FALSE;
+      glGetBooleanv(GL_TRANSFORM_FEEDBACK_ACTIVE, &bTransformFeedback);
+      if (bTransformFeedback)
+        return std::chrono::nanoseconds::zero();
+
+      GLint nPreviousProgram, nPreviousFramebuffer, nPreviousVertexArray, viewport[4];
+      glGetIntegerv(GL_CURRENT_PROGRAM, &nPreviousProgram);
+      glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &nPreviousFramebuffer);
+      glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &nPreviousVertexArray);
+      glGetIntegerv(GL_VIEWPORT, viewport);
+      GLboolean capabilities[std::size(s_capabilities)];
+      for (std::size_t i = 0; i < std::size(s_capabilities); ++i)
+        capabilities[i] = glIsEnabled(s_capabilities[i]);
+
+#ifdef GL_COMPUTE_SHADER
+      SComputeBindings computeBindings;
+      const bool bCompute = program.HasStage(GL_COMPUTE_SHADER);
+      if (bCompute)
+        bindScratchResources(program.GetProgramId(), computeBindings);
+#endif
+
+      const auto start = std::chrono::steady_clock::now();
+      program.Use();
+#ifdef GL_COMPUTE_SHADER
+      if (bCompute)
+        glDispatchCompute(1, 1, 1);
+      else
+#endif
+      {
+        for (GLenum eCapability : s_capabilities)
+          glDisable(eCapability);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_nFramebuffer);
+        glBindVertexArray(m_nVertexArray);
+        glViewport(0, 0, 1, 1);
+        glDrawArrays(drawMode(program), 0, 6);
+      }
+      glFinish();
+      const auto duration = std::chrono::steady_clock::now() - start;
+
+#ifdef GL_COMPUTE_SHADER
+      if (bCompute)
+        restoreResources(computeBindings);
+#endif
+      for (std::size_t i = 0; i < std::size(s_capabilities); ++i)
+        if (capabilities[i])
+          glEnable(s_capabilities[i]);
+      CStateCache::Current().UseProgram(nPreviousProgram);
+      glBindFramebuffer(GL_DRAW_FRAMEBUFFER, nPreviousFramebuffer);
+      glBindVertexArray(nPreviousVertexArray);
+      glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+      return duration;
+    }
+
+    /**
+     * \brief Gets the scratch buffer bound to the storage and atomic counter buffers of compute programs during
+     * their warm-ups, or 0 if no such program has been warmed up yet. Its content is undefined.
+     */
+    GLuint GetScratchBuffer() const { return m_nScratchBuffer; }
+
+    /**
+     * \brief Warms up a batch of shader programs.
+     *
+     * \tparam It An iterator type whose dereferenced values are pointers (raw or smart) to CShaderProgram.
+     * \param first Iterator to the first program to warm up.
+     * \param last Iterator past the last program to warm up.
+     * \return A summary of the warm-ups.
+     */
+    template<typename It>
+    SWarmUpReport WarmUp(It first, It last)
+    {
+      SWarmUpReport report;
+      for (; first != last; ++first)
+      {
+        std::chrono::nanoseconds duration = WarmUp(**first);
+        ++report.nPrograms;
+        report.total += duration;
+        report.longest = std::max(report.longest, duration);
+      }
+      return report;
+    }
+
+  private:
+#ifdef GL_COMPUTE_SHADER
+    //!\brief An indexed buffer binding replaced during a compute warm-up
+    struct SBufferBinding
+    {
+      GLenum eTarget;   //!< \c GL_SHADER_STORAGE_BUFFER or \c GL_ATOMIC_COUNTER_BUFFER
+      GLuint nIndex;    //!< The binding point
+      GLint nBuffer;    //!< The bound buffer
+      GLint64 nStart;   //!< The start of the bound range
+      GLint64 nSize;    //!< The size of the bound range, 0 if the whole buffer is bound
+    };
+
+    //!\brief An image unit binding replaced during a compute warm-up
+    struct SImageBinding
+    {
+      GLint nTexture;     //!< The bound texture
+      GLint nLevel;       //!< The bound level
+      GLboolean bLayered; //!< Tells if all layers are bound
+      GLint nLayer;       //!< The bound layer if \c bLayered is \c GL_FALSE
+      GLint nAccess;      //!< The access of the binding
+      GLint nFormat;      //!< The format of the binding
+    };
+
+    //!\brief The application bindings replaced during a compute warm-up
+    struct SComputeBindings
+    {
+      GLint nStorageBuffer = 0;             //!< The generic \c GL_SHADER_STORAGE_BUFFER binding
+      GLint nAtomicCounterBuffer = 0;       //!< The generic \c GL_ATOMIC_COUNTER_BUFFER binding
+      std::vector<SBufferBinding> buffers;  //!< The indexed buffer bindings used by the program
+      std::vector<SImageBinding> images;    //!< All image units if the program has image uniforms, empty otherwise
+    };
+
+    //!\brief Smallest size of the scratch buffer, so that unsized arrays of storage blocks can be indexed a little
+    static constexpr GLsizeiptr s_nMinScratchBufferSize = 64 * 1024;
+
+    /**
+     * \brief Saves the buffer and image bindings a compute program uses, then binds the scratch buffer instead of
+     * the buffers, and unbinds the image units, whose stores then have no effect.
+     */
+    void bindScratchResources(GLuint nProgram, SComputeBindings& saved)
+    {
+      glGetIntegerv(GL_SHADER_STORAGE_BUFFER_BINDING, &saved.nStorageBuffer);
+      glGetIntegerv(GL_ATOMIC_COUNTER_BUFFER_BINDING, &saved.nAtomicCounterBuffer);
+
+      GLsizeiptr nScratchBufferSize = s_nMinScratchBufferSize;
+      for (GLenum eInterface : { GL_SHADER_STORAGE_BLOCK, GL_ATOMIC_COUNTER_BUFFER })
+      {
+        const GLenum eTarget = eInterface == GL_SHADER_STORAGE_BLOCK ? GL_SHADER_STORAGE_BUFFER : GL_ATOMIC_COUNTER_BUFFER;
+        GLint nResources = 0;
+        glGetProgramInterfaceiv(nProgram, eInterface, GL_ACTIVE_RESOURCES, &nResources);
+        for (GLint i = 0; i < nResources; ++i)
+        {
+          const GLenum properties[] = { GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE };
+          GLint values[2] = {};
+          glGetProgramResourceiv(nProgram, eInterface, i, 2, properties, 2, nullptr, values);
+          SBufferBinding binding{ eTarget, static_cast<GLuint>(values[0]), 0, 0, 0 };
+          if (eTarget == GL_SHADER_STORAGE_BUFFER)
+          {
+            glGetIntegeri_v(GL_SHADER_STORAGE_BUFFER_BINDING, binding.nIndex, &binding.nBuffer);
+            glGetInteger64i_v(GL_SHADER_STORAGE_BUFFER_START, binding.nIndex, &binding.nStart);
+            glGetInteger64i_v(GL_SHADER_STORAGE_BUFFER_SIZE, binding.nIndex, &binding.nSize);
+          }
+          else
+          {
+            glGetIntegeri_v(GL_ATOMIC_COUNTER_BUFFER_BINDING, binding.nIndex, &binding.nBuffer);
+            glGetInteger64i_v(GL_ATOMIC_COUNTER_BUFFER_START, binding.nIndex, &binding.nStart);
+            glGetInteger64i_v(GL_ATOMIC_COUNTER_BUFFER_SIZE, binding.nIndex, &binding.nSize);
+          }
+          saved.buffers.push_back(binding);
+          nScratchBufferSize = std::max<GLsizeiptr>(nScratchBufferSize, values[1]);
+        }
+      }
+
+      if (!saved.buffers.empty() && nScratchBufferSize > m_nScratchBufferSize)
+      {
+        if (m_nScratchBuffer == 0)
+          glGenBuffers(1, &m_nScratchBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_nScratchBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, nScratchBufferSize, std::vector<char>(static_cast<std::size_t>(nScratchBufferSize)).data(), GL_DYNAMIC_COPY);
+        m_nScratchBufferSize = nScratchBufferSize;
+      }
+      for (const SBufferBinding& binding : saved.buffers)
+        glBindBufferBase(binding.eTarget, binding.nIndex, m_nScratchBuffer);
+
+      //Image uniform types are the contiguous range from GL_IMAGE_1D to GL_UNSIGNED_INT_IMAGE_2D_MULTISAMPLE_ARRAY
+      GLint nUniforms = 0;
+      glGetProgramInterfaceiv(nProgram, GL_UNIFORM, GL_ACTIVE_RESOURCES, &nUniforms);
+      bool bImages = false;
+      for (GLint i = 0; i < nUniforms && !bImages; ++i)
+      {
+        const GLenum eProperty = GL_TYPE;
+        GLint nType = 0;
+        glGetProgramResourceiv(nProgram, GL_UNIFORM, i, 1, &eProperty, 1, nullptr, &nType);
+        bImages = nType >= GL_IMAGE_1D && nType <= GL_UNSIGNED_INT_IMAGE_2D_MULTISAMPLE_ARRAY;
+      }
+      if (!bImages)
+        return;
+      GLint nImageUnits = 0;
+      glGetIntegerv(GL_MAX_IMAGE_UNITS, &nImageUnits);
+      saved.images.resize(static_cast<std::size_t>(nImageUnits));
+      for (GLuint nUnit = 0; nUnit < saved.images.size(); ++nUnit)
+      {
+        SImageBinding& image = saved.images[nUnit];
+        glGetIntegeri_v(GL_IMAGE_BINDING_NAME, nUnit, &image.nTexture);
+        glGetIntegeri_v(GL_IMAGE_BINDING_LEVEL, nUnit, &image.nLevel);
+        glGetBooleani_v(GL_IMAGE_BINDING_LAYERED, nUnit, &image.bLayered);
+        glGetIntegeri_v(GL_IMAGE_BINDING_LAYER, nUnit, &image.nLayer);
+        glGetIntegeri_v(GL_IMAGE_BINDING_ACCESS, nUnit, &image.nAccess);
+        glGetIntegeri_v(GL_IMAGE_BINDING_FORMAT, nUnit, &image.nFormat);
+        glBindImageTexture(nUnit, 0, 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32UI);
+      }
+    }
+
+    /**
+     * \brief Restores the bindings saved by bindScratchResources().
+     */
+    static void restoreResources(const SComputeBindings& saved)
+    {
+      for (const SBufferBinding& binding : saved.buffers)
+        if (binding.nSize == 0)
+          glBindBufferBase(binding.eTarget, binding.nIndex, binding.nBuffer);
+        else
+          glBindBufferRange(binding.eTarget, binding.nIndex, binding.nBuffer, static_cast<GLintptr>(binding.nStart), static_cast<GLsizeiptr>(binding.nSize));
+      //Indexed binds also change the generic bindings
+      glBindBuffer(GL_SHADER_STORAGE_BUFFER, saved.nStorageBuffer);
+      glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, saved.nAtomicCounterBuffer);
+      for (GLuint nUnit = 0; nUnit < saved.images.size(); ++nUnit)
+      {
+        const SImageBinding& image = saved.images[nUnit];
+        glBindImageTexture(nUnit, image.nTexture, image.nLevel, image.bLayered, image.nLayer, image.nAccess, image.nFormat);
+      }
+    }
+#endif
+
+    //!\brief Capabilities disabled during the warm-up draws, so that they neither depend on nor change the application state
+    static constexpr GLenum s_capabilities[] = { GL_BLEND, GL_DEPTH_TEST, GL_STENCIL_TEST, GL_SCISSOR_TEST, GL_CULL_FACE, GL_RASTERIZER_DISCARD };
+
+    /**
+     * \brief Returns the primitive mode a program can draw.
+     */
+    static GLenum drawMode(const CShaderProgramBase& program)
+    {
+#ifdef GL_PATCHES
+      if (program.HasStage(GL_TESS_EVALUATION_SHADER))
+        return GL_PATCHES;
+#endif
+      if (program.HasStage(GL_GEOMETRY_SHADER))
+      {
+        GLint nInputType;
+        glGetProgramiv(program.GetProgramId(), GL_GEOMETRY_INPUT_TYPE, &nInputType);
+        return static_cast<GLenum>(nInputType);
+      }
+      return GL_TRIANGLES;
+    }
+  };
+
+}
@@ -0,0 +1,103 @@
+/*****************************************************************//**
+ * \file      ResourceStats.h
+ * \brief     Declaration of CResourceStats class
+ *
+ * \author    Benjamin ALBOUY-KISSI
+ * \date      2022
+ * \copyright GNU Lesser Public License v3
+ *********************************************************************/
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+namespace GLShaderPP {
+
+  /**
+   * \brief Accounting of the OpenGL objects held by GLShaderPP.
+   *
+   * CShader and CShaderProgram objects update these counters when they create and delete their
+   * underlying OpenGL objects, so that an application can track the driver memory footprint of
+   * its shaders. Counters are process wide and thread safe.
+   *
+   * Querying the binary size of a program costs a driver round trip, so it is not done at link time unless
+   * binary accounting is enabled with SetBinaryAccounting(). Otherwise, \c nBinaryBytes only counts the
+   * programs whose size has been asked with CShaderProgram::GetBinarySize().
+   */
+  class CResourceStats
+  {
+  public:
+    //!\brief A snapshot of the counters
+    struct SSnapshot
+    {
+      std::size_t nShaders = 0;     //!< Number of shader objects currently held
+      std::size_t nPrograms = 0;    //!< Number of shader program objects currently held
+      std::size_t nSourceBytes = 0; //!< Total size of the GLSL sources given to held shader objects
+      std::size_t nBinaryBytes = 0; //!< Total binary size of held linked programs whose size is known, as reported by \c GL_PROGRAM_BINARY_LENGTH
+    };
+
+  private:
+    static inline std::atomic<std::size_t> s_nShaders{ 0 };     //!< Number of shader objects currently held
+    static inline std::atomic<std::size_t> s_nPrograms{ 0 };    //!< Number of shader program objects currently held
+    static inline std::atomic<std::size_t> s_nSourceBytes{ 0 }; //!< Total size of held sources
+    static inline std::atomic<std::size_t> s_nBinaryBytes{ 0 }; //!< Total binary size of held programs
+    static inline std::atomic<bool> s_bBinaryAccounting{ false }; //!< Whether binary sizes are queried at link time
+
+  public:
+    /**
+     * \brief Returns the current value of the counters.
+     */
+    static SSnapshot Get()
+    {
+      SSnapshot snapshot;
+      snapshot.nShaders = s_nShaders.load(std::memory_order_relaxed);
+      snapshot.nPrograms = s_nPrograms.load(std::memory_order_relaxed);
+      snapshot.nSourceBytes = s_nSourceBytes.load(std::memory_order_relaxed);
+      snapshot.nBinaryBytes = s_nBinaryBytes.load(std::memory_order_relaxed);
+      return snapshot;
+    }
+
+    /**
+     * \brief Enables or disables the query of binary sizes when programs are linked.
+     *
+     * \param bEnable \c true to query the binary size of each program linked from now on.
+     */
+    static void SetBinaryAccounting(bool bEnable) { s_bBinaryAccounting.store(bEnable, std::memory_order_relaxed); }
+
+    //!\brief Tells if binary sizes are queried when programs are linked.
+    static bool IsBinaryAccountingEnabled() { return s_bBinaryAccounting.load(std::memory_order_relaxed); }
+
+    //!\brief Counts a created shader object.
+    static void AddShader() { s_nShaders.fetch_add(1, std::memory_order_relaxed); }
+    //!\brief Counts a deleted shader object.
+    static void RemoveShader() { s_nShaders.fetch_sub(1, std::memory_order_relaxed); }
+    //!\brief Counts a created shader program object.
+    static void AddProgram() { s_nPrograms.fetch_add(1, std::memory_order_relaxed); }
+    //!\brief Counts a deleted shader program object.
+    static void RemoveProgram() { s_nPrograms.fetch_sub(1, std::memory_order_relaxed); }
+
+    /**
+     * \brief Updates the total size of held sources when the source of a shader changes.
+     *
+     * \param nOldSize The previous source size of the shader.
+     * \param nNewSize The new source size of the shader.
+     */
+    static void UpdateSourceBytes(std::size_t nOldSize, std::size_t nNewSize)
+    {
+      s_nSourceBytes.fetch_add(nNewSize, std::memory_order_relaxed);
+      s_nSourceBytes.fetch_sub(nOldSize, std::memory_order_relaxed);
+    }
+
+    /**
+     * \brief Updates the total binary size of held programs when the binary of a program changes.
+     *
+     * \param nOldSize The previous binary size of the program.
+     * \param nNewSize The new binary size of the program.
+     */
+    static void UpdateBinaryBytes(std::size_t nOldSize, std::size_t nNewSize)
+    {
+      s_nBinaryBytes.fetch_add(nNewSize, std::memory_order_relaxed);
+      s_nBinaryBytes.fetch_sub(nOldSize, std::memory_order_relaxed);
+    }
+  };
+
+}
@@ -1,6 +1,6 @@
 /*****************************************************************//**
  * \file      Shader.h
- * \brief     Declaration of CShader class
+ * \brief     Declaration of CShader classes
  * 
  * \author    Benjamin ALBOUY-KISSI
  * \date      2022
@@ -8,12 +8,52 @@
  *********************************************************************/
 #pragma once
 #include <string>
-#include <istream>
-#include <sstream>
+#include <string_view>
+#include <iosfwd>
+#include <type_traits>
 #include "ShaderException.h"
+#include "ErrorPolicy.h"
+#include "ResourceStats.h"
+#include "GLUtils.h"
 
 namespace GLShaderPP {
 
+  /**
+   * \brief Reads the GLSL source code of a shader from a \c std::istream.
+   *
+   * It only uses members of \c IStream, which are looked up when the reader is instantiated, so that Shader.h
+   * does not include \c <istream> nor \c <sstream>: the code giving a stream has its definition already.
+   *
+   * \tparam IStream The type of the stream, \c std::istream or one of its derivative.
+   */
+  template<typename IStream>
+  struct SShaderStreamReader
+  {
+    /**
+     * \brief Reads the whole content of a stream.
+     *
+     * \param streamSource The stream containing the GLSL source code of a shader.
+     * \param strSource Receives the source code.
+     * \return \c false if the stream is not readable for any reason.
+     */
+    static bool Read(const IStream& streamSource, std::string& strSource)
+    {
+      auto* pBuffer = streamSource.rdbuf();
+      if (!streamSource.good() || !pBuffer)
+        return false;
+      char buffer[4096];
+      for (auto nRead = pBuffer->sgetn(buffer, sizeof(buffer)); nRead > 0; nRead = pBuffer->sgetn(buffer, sizeof(buffer)))
+        strSource.append(buffer, static_cast<std::size_t>(nRead));
+      return true;
+    }
+  };
+
+  /**
+   * \brief Enables a CBasicShader member function for \c std::istream and its derivatives.
+   */
+  template<typename IStream>
+  using EnableIfShaderStream = std::enable_if_t<std::is_base_of_v<std::istream, IStream>, int>;
+
 #ifdef GLEW_VERSION
   /**
    * \brief Initialise GLEW
@@ -32,20 +72,66 @@ namespace GLShaderPP {
   };
 #endif
 
-  /*!
-   * \brief Loads and compiles an OpenGL shader
-   *
-   * This class encapsulates the loading and compilation of OpenGL shaders. If #_DONT_USE_SHADER_EXCEPTION
-   * is defined before including this file, loading and compilation errors are reported to the error output
-   * stream. Otherwise, CShaderException objects are thrown. 
+  /**
+   * \brief Tells if the driver can report compilation and linking completion without blocking.
    * 
-   * To use this class, you can automatically load and compile a shader by constructing a CShader with
-   * CShader(GLenum eShaderType, const std::string& strSource) or CShader(GLenum eShaderType, const std::istream& streamSource)
+   * This is the case when the current OpenGL context exposes \c GL_KHR_parallel_shader_compile or
+   * \c GL_ARB_parallel_shader_compile. The extension list is only scanned at the first call, the result
+   * is then kept for the whole process lifetime.
    * 
-   * Alternatively, you can create an empty CShader object with CShader(GLenum eShaderType). Then, call one of the SetSource() 
-   * functions followed by a call to Compile()
+   * \return \c true if \c GL_COMPLETION_STATUS_KHR can be queried on shader and program objects.
    */
-  class CShader
+  inline bool IsParallelCompileSupported() {
+#ifdef GL_COMPLETION_STATUS_KHR
+    static const bool bSupported = IsExtensionSupported("GL_KHR_parallel_shader_compile") || IsExtensionSupported("GL_ARB_parallel_shader_compile");
+    return bSupported;
+#else
+    return false;
+#endif
+  }
+
+  /**
+   * \brief Returns a string representation of a shader type.
+   * 
+   * \param eStage The OpenGL type of the shader.
+   * \return Possible values are:
+   * - "compute"
+   * - "vertex"
+   * - "tesselation control"
+   * - "tesselation evaluation"
+   * - "geometry"
+   * - "fragment"
+   * - "unknown"
+   */
+  constexpr const char* GetStageName(GLenum eStage)
+  {
+    switch (eStage)
+    {
+    case GL_COMPUTE_SHADER:
+      return "compute";
+    case GL_VERTEX_SHADER:
+      return "vertex";
+    case GL_TESS_CONTROL_SHADER:
+      return "tesselation control";
+    case GL_TESS_EVALUATION_SHADER:
+      return "tesselation evaluation";
+    case GL_GEOMETRY_SHADER:
+      return "geometry";
+    case GL_FRAGMENT_SHADER:
+      return "fragment";
+    default:
+      return "unknown";
+    }
+  }
+
+  /**
+   * \brief The part of an OpenGL shader which does not depend on its error policy.
+   * 
+   * CShaderBase owns the underlying OpenGL shader object and tracks its state. Functions which may report
+   * errors are provided by CBasicShader, according to its error policy. Classes which only need to read a
+   * compiled shader, such as CBasicShaderProgram, take it as a CShaderBase.
+   */
+  class CShaderBase
   {
   public:
     /**
@@ -54,6 +140,7 @@ namespace GLShaderPP {
     enum class ShaderCompileState
     {
       notCompiled,      //!< Compilation has not been tried.
+      compilePending,   //!< Compilation has been submitted to the driver but its result has not been checked yet.
       badSourceStream,  //!< The source stream is not readable
       compileError,     //!< An error occured during compilation.
       compileOk         //!< Compilation is Ok.
@@ -62,16 +149,22 @@ namespace GLShaderPP {
 
     ShaderCompileState m_eCompileState = ShaderCompileState::notCompiled; //!< State of the shader compilation
     GLuint m_nShaderId; //!< Identifier of the underlying OpenGL shader object.
+    GLenum m_eType;     //!< OpenGL type of this shader.
+    std::size_t m_nSourceSize = 0; //!< Size of the GLSL source code given to the underlying OpenGL shader object.
 
-    CShader(const CShader&) = delete;
-    CShader& operator=(const CShader&) = delete;
+    CShaderBase(const CShaderBase&) = delete;
+    CShaderBase& operator=(const CShaderBase&) = delete;
 
+  protected:
     /**
      * \brief Create the underlying OpenGL shader object.
      * 
      * \param eShaderType OpenGL type of this shader.
+     * 
+     * \throw CShaderException If \c glCreateShader is \c nullptr, a CShaderException::ExceptionType::GlewInit typed CShaderException 
+     * is thrown, whatever the error policy is.
      */
-    void createShader(GLenum eShaderType) {
+    explicit CShaderBase(GLenum eShaderType) {
       if (!glCreateShader)
 #ifdef GLEW_VERSION
         GlewInit();
@@ -79,8 +172,136 @@ namespace GLShaderPP {
 #endif
         throw CShaderException("Error: OpenGL context seems not to be properly initialised.", CShaderException::ExceptionType::GlewInit);
       m_nShaderId = glCreateShader(eShaderType);
+      m_eType = eShaderType;
+      CResourceStats::AddShader();
     }
 
+    /**
+     * \brief Sets the state of this shader compilation.
+     */
+    void setCompileState(ShaderCompileState eCompileState) { m_eCompileState = eCompileState; }
+
+    /**
+     * \brief Returns the compilation log of the underlying OpenGL shader object.
+     */
+    std::string getInfoLog() const
+    {
+      GLint length = 0;
+      glGetShaderiv(m_nShaderId, GL_INFO_LOG_LENGTH, &length);
+      std::string infologbuffer;
+      infologbuffer.resize(length);
+      if (length > 0)
+        glGetShaderInfoLog(m_nShaderId, length, nullptr, &infologbuffer.front());
+      return infologbuffer;
+    }
+
+  public:
+    /**
+     * \brief Deletes the underlying OpenGL shader object.
+     */
+    ~CShaderBase() {
+      glDeleteShader(m_nShaderId);
+      CResourceStats::RemoveShader();
+      CResourceStats::UpdateSourceBytes(m_nSourceSize, 0);
+    }
+
+    /**
+     * \brief Sets the GLSL source code of the shader from a string.
+     * 
+     * The characters are given to the driver with their length, so \c strSource does not need to be null
+     * terminated and may point into a memory mapped file (see CShaderPackReader). It is not copied.
+     * 
+     * \param strSource The string of the GLSL source code of the shader.
+     */
+    void SetSource(std::string_view strSource)
+    {
+      const GLchar* vertexShaderSource = strSource.data();
+      const GLint nLength = static_cast<GLint>(strSource.size());
+      glShaderSource(m_nShaderId, 1, &vertexShaderSource, &nLength);
+      m_eCompileState = ShaderCompileState::notCompiled;
+      CResourceStats::UpdateSourceBytes(m_nSourceSize, strSource.size());
+      m_nSourceSize = strSource.size();
+    }
+
+    /**
+     * \brief Submits the GLSL source code of this shader to the driver compiler without waiting for the result.
+     * 
+     * The compilation state becomes ShaderCompileState::compilePending. Use IsCompileCompleted() to know if
+     * Compile() can be called without blocking to check the compilation result.
+     */
+    void SubmitCompile()
+    {
+      if (m_eCompileState != ShaderCompileState::notCompiled)
+        return;
+      glCompileShader(m_nShaderId);
+      m_eCompileState = ShaderCompileState::compilePending;
+    }
+
+    /**
+     * \brief Tells if a submitted compilation is finished.
+     * 
+     * \return \c false only if the compilation is pending and the driver reports that it is still running. If 
+     * the driver can't tell (see IsParallelCompileSupported()), \c true is returned and the next Compile() may block.
+     */
+    bool IsCompileCompleted() const
+    {
+      if (m_eCompileState != ShaderCompileState::compilePending)
+        return true;
+#ifdef GL_COMPLETION_STATUS_KHR
+      if (IsParallelCompileSupported())
+      {
+        GLint value = GL_TRUE;
+        glGetShaderiv(m_nShaderId, GL_COMPLETION_STATUS_KHR, &value);
+        return value == GL_TRUE;
+      }
+#endif
+      return true;
+    }
+
+    /**
+     * \brief Returns a string representation of this shader type.
+     * 
+     * \return See GetStageName() for possible values.
+     */
+    std::string GetType() const { return GetStageName(m_eType); }
+
+    /**
+     * \brief Returns the OpenGL type of this shader (\c GL_VERTEX_SHADER, \c GL_FRAGMENT_SHADER...).
+     */
+    GLenum GetStage() const { return m_eType; }
+
+    /**
+     * \brief Gets the state of this shader compilation.
+     */
+    ShaderCompileState GetCompileState() const { return m_eCompileState; }
+
+    /**
+     * \brief Gets the identifier of the underlying OpenGL shader object.
+     */
+    GLuint GetShaderId() const { return m_nShaderId; }
+  };
+
+  /*!
+   * \brief Loads and compiles an OpenGL shader
+   *
+   * This class encapsulates the loading and compilation of OpenGL shaders. Loading and compilation errors are
+   * reported through its error policy: CShaderException objects are thrown by CThrowErrorPolicy, messages are
+   * written to the error output stream by CStderrErrorPolicy, and so on (see ErrorPolicy.h). CShader uses
+   * CDefaultErrorPolicy, which depends on #_DONT_USE_SHADER_EXCEPTION.
+   * 
+   * To use this class, you can automatically load and compile a shader by constructing a CShader with
+   * CBasicShader(GLenum eShaderType, std::string_view strSource) or CBasicShader(GLenum eShaderType, const IStream& streamSource)
+   * 
+   * Alternatively, you can create an empty CShader object with CBasicShader(GLenum eShaderType). Then, call one of the SetSource() 
+   * functions followed by a call to Compile()
+   * 
+   * When the shader type is known at compile time, prefer CShaderT and its aliases (CVertexShader, CFragmentShader...).
+   * 
+   * \tparam ErrorPolicy The error policy, such as CThrowErrorPolicy or CStatusErrorPolicy.
+   */
+  template<typename ErrorPolicy = CDefaultErrorPolicy>
+  class CBasicShader : public CShaderBase
+  {
   public:
     /**
      * \brief Creates an empty shader object.
@@ -89,7 +310,7 @@ namespace GLShaderPP {
      * 
      * \see <a href="https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glCreateShader.xhtml">OpenGL's glCreateShader()</a> for \c eShaderType possible values
      */
-    CShader(GLenum eShaderType) { createShader(eShaderType); }
+    CBasicShader(GLenum eShaderType) : CShaderBase(eShaderType) {}
 
     /**
      * \brief Creates an shader object from string source.
@@ -101,8 +322,7 @@ namespace GLShaderPP {
      *
      * \see <a href="https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glCreateShader.xhtml">OpenGL's glCreateShader()</a> for \c eShaderType possible values
      */
-    CShader(GLenum eShaderType, const std::string& strSource) {
-      createShader(eShaderType);
+    CBasicShader(GLenum eShaderType, std::string_view strSource) : CShaderBase(eShaderType) {
       SetSource(strSource);
       Compile();
     }
@@ -112,141 +332,173 @@ namespace GLShaderPP {
      *
      * This constructor creates the shader, sets its source code from an istream then compiles it.
      *
+     * \tparam IStream \c std::istream or one of its derivative.
      * \param eShaderType OpenGL type of this shader.
      * \param streamSource The stream containing the GLSL source code of the shader.
      *
      * \see <a href="https://www.khronos.org/registry/OpenGL-Refpages/gl4/html/glCreateShader.xhtml">OpenGL's glCreateShader()</a> for \c eShaderType possible values
      */
-    CShader(GLenum eShaderType, const std::istream& streamSource) {
-      createShader(eShaderType);
+    template<typename IStream, EnableIfShaderStream<IStream> = 0>
+    CBasicShader(GLenum eShaderType, const IStream& streamSource) : CShaderBase(eShaderType) {
       SetSource(streamSource);
       Compile();
     }
 
-    /**
-     * \brief Deletes the underlying OpenGL shader object.
-     */
-    ~CShader() { glDeleteShader(m_nShaderId); }
-
-    /**
-     * \brief Sets the GLSL source code of the shader from a string.
-     * 
-     * \param strSource The string of the GLSL source code of the shader.
-     */
-    void SetSource(const std::string& strSource)
-    {
-      const GLchar* vertexShaderSource = strSource.c_str();
-      glShaderSource(m_nShaderId, 1, &vertexShaderSource, nullptr);
-      m_eCompileState = ShaderCompileState::notCompiled;
-    }
+    using CShaderBase::SetSource;
 
     /**
      * \brief Sets the GLSL source code of the shader from an istream.
      *
+     * \tparam IStream \c std::istream or one of its derivative.
      * \param streamSource The istream containing the GLSL source code of the shader.
      * 
-     * \throw CShaderException If #_DONT_USE_SHADER_EXCEPTION is defined, it may throw a CShaderException::ExceptionType::BadSourceStream 
+     * \throw CShaderException With CThrowErrorPolicy, a CShaderException::ExceptionType::BadSourceStream 
      * typed CShaderException if the source stream is not readable for any reason.
      */
-    void SetSource(const std::istream& streamSource)
+    template<typename IStream, EnableIfShaderStream<IStream> = 0>
+    void SetSource(const IStream& streamSource)
     {
-      if (streamSource.good())
-      {
-        std::stringstream vertexShaderStream;
-        vertexShaderStream << streamSource.rdbuf();
-
-        SetSource(vertexShaderStream.str());
-      }
+      std::string strSource;
+      if (SShaderStreamReader<IStream>::Read(streamSource, strSource))
+        SetSource(strSource);
       else
       {
-        m_eCompileState = ShaderCompileState::badSourceStream;
-        std::string what{ "Can not open " + GetType() + " shader sources" };
-#ifndef _DONT_USE_SHADER_EXCEPTION
-        throw CShaderException(what, CShaderException::ExceptionType::BadSourceStream);
-#else
-        std::cerr << what << '\n';
-#endif
+        setCompileState(ShaderCompileState::badSourceStream);
+        ErrorPolicy::Report(CShaderException::ExceptionType::BadSourceStream, [this]() {
+          return "Can not open " + GetType() + " shader sources";
+        });
       }
     }
 
     /**
      * \brief Compiles the GLSL source code of this shader.
      * 
-     * \throw CShaderException If #_DONT_USE_SHADER_EXCEPTION is defined, it may throw a CShaderException::ExceptionType::CompilationError
+     * If the compilation has already been submitted by SubmitCompile(), this function only checks its result.
+     * 
+     * \return The state of this shader compilation, as returned by GetCompileState() afterwards.
+     * 
+     * \throw CShaderException With CThrowErrorPolicy, a CShaderException::ExceptionType::CompilationError
      * typed CShaderException if the compilation fails.
      */
-    void Compile()
+    ShaderCompileState Compile()
     {
-      if (m_eCompileState != ShaderCompileState::notCompiled)
-        return;
-      glCompileShader(m_nShaderId);
+      SubmitCompile();
+      if (GetCompileState() != ShaderCompileState::compilePending)
+        return GetCompileState();
 
       GLint value;
-      glGetShaderiv(m_nShaderId, GL_COMPILE_STATUS, &value);
+      glGetShaderiv(GetShaderId(), GL_COMPILE_STATUS, &value);
 
       if (value == GL_TRUE)
-        m_eCompileState = ShaderCompileState::compileOk;
+        setCompileState(ShaderCompileState::compileOk);
       else
       {
-        m_eCompileState = ShaderCompileState::compileError;
-        GLint length = 0;
-        glGetShaderiv(m_nShaderId, GL_INFO_LOG_LENGTH, &length);
-        std::string infologbuffer;
-        infologbuffer.resize(length);
-        glGetShaderInfoLog(m_nShaderId, length, nullptr, &infologbuffer.front());
-        std::string what{ "An error occured during " + GetType() + " shader compilation\n" + infologbuffer };
-#ifndef _DONT_USE_SHADER_EXCEPTION
-        throw CShaderException(what, CShaderException::ExceptionType::CompilationError);
-#else
-        std::cerr << what << '\n';
-#endif
+        setCompileState(ShaderCompileState::compileError);
+        ErrorPolicy::Report(CShaderException::ExceptionType::CompilationError, [this]() {
+          return "An error occured during " + GetType() + " shader compilation\n" + getInfoLog();
+        });
       }
+      return GetCompileState();
     }
+  };
+
+  /**
+   * \brief An OpenGL shader using the default error policy.
+   */
+  using CShader = CBasicShader<>;
+
+  /**
+   * \brief An OpenGL shader whose type is known at compile time.
+   * 
+   * A CShaderT is a CShader whose type is given as template parameter, so that the type and its name are
+   * constant expressions. CShaderProgram::CShaderProgram(const S&...) uses them to reject, at compile time,
+   * a program with two shaders of the same type or mixing a compute shader with other shader types.
+   * 
+   * \tparam eShaderType OpenGL type of this shader.
+   * \tparam ErrorPolicy The error policy, see CBasicShader.
+   * 
+   * \see CVertexShader, CTessControlShader, CTessEvaluationShader, CGeometryShader, CFragmentShader, CComputeShader
+   */
+  template<GLenum eShaderType, typename ErrorPolicy = CDefaultErrorPolicy>
+  class CShaderT : public CBasicShader<ErrorPolicy>
+  {
+  public:
+    static constexpr GLenum stage = eShaderType;                      //!< OpenGL type of this shader
+    static constexpr const char* stageName = GetStageName(eShaderType); //!< String representation of this shader type
+
+    static_assert(std::string_view(GetStageName(eShaderType)) != "unknown", "CShaderT needs a shader type");
 
     /**
-     * \brief Returns a string representation of this shader type.
-     * 
-     * \return Possible values are:
-     * - "compute"
-     * - "vertex"
-     * - "tesselation control"
-     * - "tesselation evaluation"
-     * - "geometry"
-     * - "fragment"
-     * - "unknown"
+     * \brief Creates an empty shader object.
      */
-    std::string GetType() const
-    {
-      GLint type;
-      glGetShaderiv(m_nShaderId, GL_SHADER_TYPE, &type);
-      switch (type)
-      {
-      case GL_COMPUTE_SHADER:
-        return "compute";
-      case GL_VERTEX_SHADER:
-        return "vertex";
-      case GL_TESS_CONTROL_SHADER:
-        return "tesselation control";
-      case GL_TESS_EVALUATION_SHADER:
-        return "tesselation evaluation";
-      case GL_GEOMETRY_SHADER:
-        return "geometry";
-      case GL_FRAGMENT_SHADER:
-        return "fragment";
-      default:
-        return "unknown";
-      }
-    }
+    CShaderT() : CBasicShader<ErrorPolicy>(eShaderType) {}
 
     /**
-     * \brief Gets the state of this shader compilation.
+     * \brief Creates a shader object, sets its source code from a string then compiles it.
+     * 
+     * \param strSource The string of the GLSL source code of the shader.
      */
-    ShaderCompileState GetCompileState() const { return m_eCompileState; }
+    explicit CShaderT(std::string_view strSource) : CBasicShader<ErrorPolicy>(eShaderType, strSource) {}
 
     /**
-     * \brief Gets the identifier of the underlying OpenGL shader object.
+     * \brief Creates a shader object, sets its source code from an istream then compiles it.
+     * 
+     * \tparam IStream \c std::istream or one of its derivative.
+     * \param streamSource The stream containing the GLSL source code of the shader.
      */
-    GLuint GetShaderId() const { return m_nShaderId; }
+    template<typename IStream, EnableIfShaderStream<IStream> = 0>
+    explicit CShaderT(const IStream& streamSource) : CBasicShader<ErrorPolicy>(eShaderType, streamSource) {}
   };
 
+  using CVertexShader = CShaderT<GL_VERTEX_SHADER>;                   //!< A vertex shader
+  using CTessControlShader = CShaderT<GL_TESS_CONTROL_SHADER>;        //!< A tesselation control shader
+  using CTessEvaluationShader = CShaderT<GL_TESS_EVALUATION_SHADER>;  //!< A tesselation evaluation shader
+  using CGeometryShader = CShaderT<GL_GEOMETRY_SHADER>;               //!< A geometry shader
+  using CFragmentShader = CShaderT<GL_FRAGMENT_SHADER>;               //!< A fragment shader
+  using CComputeShader = CShaderT<GL_COMPUTE_SHADER>;                 //!< A compute shader
+
+  /**
+   * \brief Gives the shader type of a shader class, if it is known at compile time.
+   * 
+   * \c value is the OpenGL type of CShaderT classes and their derivatives, 0 for other classes such as CShader.
+   */
+  template<typename T, typename = void>
+  struct SStaticStage : std::integral_constant<GLenum, 0> {};
+
+  //!\brief Gives the shader type of a CShaderT class or one of its derivatives.
+  template<typename T>
+  struct SStaticStage<T, std::void_t<decltype(T::stage)>> : std::integral_constant<GLenum, T::stage> {};
+
+  /**
+   * \brief Tells if shader classes whose types are known at compile time all have different types.
+   */
+  template<typename... S>
+  constexpr bool HasDistinctStaticStages()
+  {
+    constexpr GLenum stages[] = { SStaticStage<S>::value..., 0 };
+    for (std::size_t i = 0; i < sizeof...(S); ++i)
+      for (std::size_t j = i + 1; j < sizeof...(S); ++j)
+        if (stages[i] != 0 && stages[i] == stages[j])
+          return false;
+    return true;
+  }
+
+  /**
+   * \brief Tells if shader classes whose types are known at compile time can be linked together.
+   * 
+   * A compute shader can not be linked with shaders of other types.
+   */
+  template<typename... S>
+  constexpr bool HasCompatibleStaticStages()
+  {
+    constexpr GLenum stages[] = { SStaticStage<S>::value..., 0 };
+    bool bCompute = false, bGraphics = false;
+    for (std::size_t i = 0; i < sizeof...(S); ++i)
+    {
+      bCompute = bCompute || stages[i] == GL_COMPUTE_SHADER;
+      bGraphics = bGraphics || (stages[i] != 0 && stages[i] != GL_COMPUTE_SHADER);
+    }
+    return !(bCompute && bGraphics);
+  }
+
 }
\ No newline at end of file
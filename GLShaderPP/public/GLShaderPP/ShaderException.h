@@ -15,6 +15,8 @@
  * If you define it before including Shader.h or ShaderProgram.h, no exception will be thrown 
  * during shader compilation or program linking. Instead of that, errors will be discreetly 
  * reported in stderr and by changing CShader and CShaderProgram corresponding members.
+ * It selects CStderrErrorPolicy instead of CThrowErrorPolicy as CDefaultErrorPolicy. Other error
+ * policies can be chosen per instantiation of CBasicShader and CBasicShaderProgram.
  */
 //For documentation purpose
 #ifndef _DONT_USE_SHADER_EXCEPTION
@@ -48,7 +50,9 @@ namespace GLShaderPP {
       CompilationError, //!< An error occured during shader compilation
       PrepareLinkError, //!< A shader stage was not compiled before linking the shader program
       LinkError,        //!< An error occured during shader program linking
-      GlewInit          //!< You use GLEW to get OpenGL functions but there is no compatible active context
+      GlewInit,         //!< You use GLEW to get OpenGL functions but there is no compatible active context
+      BadShaderPack,    //!< A shader pack file cannot be mapped or is malformed
+      BadDispatch       //!< A compute dispatch needs more work groups than the driver supports
     };
   private:
     ExceptionType m_eType;  //!< The type of this exception
@@ -0,0 +1,479 @@
+/*****************************************************************//**
+ * \file      ShaderPack.h
+ * \brief     Declaration of CBasicShaderPackReader and CShaderPackWriter classes
+ *
+ * This header does not need OpenGL, so that packing tools can use it without an OpenGL context.
+ *
+ * \author    Benjamin ALBOUY-KISSI
+ * \date      2022
+ * \copyright GNU Lesser Public License v3
+ *********************************************************************/
+#pragma once
+#include "ErrorPolicy.h"
+#include "Hash.h"
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace GLShaderPP {
+
+  /**
+   * \brief Gets the OpenGL shader type matching the extension of a shader file name.
+   *
+   * Known extensions are those of the Khronos reference compiler: \c .vert, \c .tesc, \c .tese, \c .geom,
+   * \c .frag and \c .comp.
+   *
+   * \return The value of \c GL_VERTEX_SHADER, \c GL_FRAGMENT_SHADER... or 0 if the extension is unknown.
+   */
+  constexpr std::uint32_t GetStageFromExtension(std::string_view strFileName)
+  {
+    const std::size_t nDot = strFileName.rfind('.');
+    if (nDot == std::string_view::npos)
+      return 0;
+    const std::string_view strExtension = strFileName.substr(nDot);
+    //Values are those of the GL_*_SHADER constants, since this header does not include OpenGL ones
+    if (strExtension == ".vert") return 0x8B31;
+    if (strExtension == ".tesc") return 0x8E88;
+    if (strExtension == ".tese") return 0x8E87;
+    if (strExtension == ".geom") return 0x8DD9;
+    if (strExtension == ".frag") return 0x8B30;
+    if (strExtension == ".comp") return 0x91B9;
+    return 0;
+  }
+
+  /**
+   * \brief Header of a shader pack file.
+   *
+   * A shader pack file is made of this header, followed by \c nEntryCount SShaderPackIndexEntry sorted by
+   * name, then by the names, then by the GLSL sources. Each source is followed by a null character, which
+   * is not counted in its length. Integers are stored with the byte order of the machine which wrote the
+   * pack, \c nByteOrderMark allows readers to reject packs written with another one.
+   */
+  struct SShaderPackHeader
+  {
+    static constexpr char magic[4] = { 'G', 'L', 'S', 'P' };  //!< Expected value of \c szMagic
+    static constexpr std::uint32_t version = 1;                 //!< Expected value of \c nVersion
+    static constexpr std::uint32_t byteOrderMark = 0x01020304;  //!< Expected value of \c nByteOrderMark
+
+    char szMagic[4];              //!< File signature
+    std::uint32_t nVersion;       //!< Version of the file format
+    std::uint32_t nByteOrderMark; //!< Detects a byte order different from the reader one
+    std::uint32_t nEntryCount;    //!< Number of shader sources in the pack
+  };
+
+  /**
+   * \brief An index entry of a shader pack file.
+   *
+   * Offsets are from the beginning of the file.
+   */
+  struct SShaderPackIndexEntry
+  {
+    std::uint64_t nSourceOffset;  //!< Offset of the GLSL source
+    std::uint64_t nHash;          //!< FNV-1a hash of the GLSL source
+    std::uint32_t nSourceLength;  //!< Length of the GLSL source, without its null character
+    std::uint32_t nNameOffset;    //!< Offset of the name
+    std::uint32_t nNameLength;    //!< Length of the name
+    std::uint32_t nStage;         //!< OpenGL type of the shader, or 0 if unknown
+  };
+
+  static_assert(sizeof(SShaderPackHeader) == 16 && sizeof(SShaderPackIndexEntry) == 32, "Shader pack structures must not be padded");
+
+  /**
+   * \brief A shader source found in a shader pack.
+   *
+   * Its strings point into the memory mapped pack file, so they are only valid while the pack is open.
+   */
+  struct SShaderPackEntry
+  {
+    std::string_view strName;     //!< Name of the source in the pack
+    std::string_view strSource;   //!< GLSL source, followed by a null character in the mapped file
+    std::uint32_t nStage = 0;     //!< OpenGL type of the shader, or 0 if unknown
+    std::uint64_t nHash = 0;      //!< FNV-1a hash of the GLSL source, usable as a cache key
+  };
+
+  /**
+   * \brief Reads GLSL sources from a memory mapped shader pack.
+   *
+   * Opening a pack maps its file read only and checks its header and index, so that opening costs one system
+   * call instead of one file read per shader. Sources are never copied: Find() returns views into the mapping,
+   * which can be given to CShader as is. Since the mapping is shared, processes using the same pack share its
+   * pages in the system page cache, and sources which are never used are never read from disk.
+   *
+   * Names are sorted in the pack, so that Find() is a binary search.
+   *
+   * \code{.cpp}
+   * GLShaderPP::CShaderPackReader pack("shaders.glsp");
+   * if (auto vertex = pack.Find("shaders/sky.vert"))
+   *   GLShaderPP::CShader shader(vertex->nStage, vertex->strSource);
+   * \endcode
+   *
+   * Errors are reported through the error policy, with the CShaderException::ExceptionType::BadShaderPack
+   * type, and the reader is left closed.
+   *
+   * \tparam ErrorPolicy The error policy, such as CThrowErrorPolicy or CStatusErrorPolicy.
+   *
+   * \see CShaderPackWriter
+   */
+  template<typename ErrorPolicy = CDefaultErrorPolicy>
+  class CBasicShaderPackReader
+  {
+    const char* m_pData = nullptr;  //!< The mapped file
+    std::size_t m_nSize = 0;        //!< Size of the mapped file
+    std::uint32_t m_nEntryCount = 0;//!< Number of sources in the pack
+
+    CBasicShaderPackReader(const CBasicShaderPackReader&) = delete;
+    CBasicShaderPackReader& operator=(const CBasicShaderPackReader&) = delete;
+
+  public:
+    /**
+     * \brief Creates a closed reader.
+     */
+    CBasicShaderPackReader() = default;
+
+    /**
+     * \brief Creates a reader and opens a shader pack.
+     *
+     * \param strPath The path of the shader pack file.
+     */
+    explicit CBasicShaderPackReader(const std::string& strPath) { Open(strPath); }
+
+    /**
+     * \brief Moves an open pack to a new reader.
+     */
+    CBasicShaderPackReader(CBasicShaderPackReader&& other) noexcept
+      : m_pData(std::exchange(other.m_pData, nullptr)), m_nSize(std::exchange(other.m_nSize, 0)), m_nEntryCount(std::exchange(other.m_nEntryCount, 0)) {}
+
+    /**
+     * \brief Closes the pack of this reader and moves the one of \c other to it.
+     */
+    CBasicShaderPackReader& operator=(CBasicShaderPackReader&& other) noexcept
+    {
+      if (this != &other)
+      {
+        Close();
+        m_pData = std::exchange(other.m_pData, nullptr);
+        m_nSize = std::exchange(other.m_nSize, 0);
+        m_nEntryCount = std::exchange(other.m_nEntryCount, 0);
+      }
+      return *this;
+    }
+
+    /**
+     * \brief Closes the pack. Views returned by Find() and GetEntry() become dangling.
+     */
+    ~CBasicShaderPackReader() { Close(); }
+
+    /**
+     * \brief Maps a shader pack file and checks its header and index.
+     *
+     * The previously opened pack, if any, is closed.
+     *
+     * \param strPath The path of the shader pack file.
+     * \return \c true if the pack is open.
+     *
+     * \throw CShaderException With CThrowErrorPolicy, a CShaderException::ExceptionType::BadShaderPack typed
+     * CShaderException if the file cannot be mapped or is not a valid shader pack.
+     */
+    bool Open(const std::string& strPath)
+    {
+      Close();
+      if (!map(strPath))
+        return fail(strPath, "cannot be mapped");
+
+      SShaderPackHeader header;
+      if (m_nSize < sizeof(header))
+        return fail(strPath, "is too small");
+      std::memcpy(&header, m_pData, sizeof(header));
+      if (std::memcmp(header.szMagic, SShaderPackHeader::magic, sizeof(header.szMagic)) != 0)
+        return fail(strPath, "is not a shader pack");
+      if (header.nVersion != SShaderPackHeader::version || header.nByteOrderMark != SShaderPackHeader::byteOrderMark)
+        return fail(strPath, "has an unsupported version or byte order");
+      if (header.nEntryCount > (m_nSize - sizeof(header)) / sizeof(SShaderPackIndexEntry))
+        return fail(strPath, "has a truncated index");
+      m_nEntryCount = header.nEntryCount;
+
+      //Only the index and the names are read here, so that unused sources are never loaded
+      std::string_view strPreviousName;
+      for (std::uint32_t i = 0; i < m_nEntryCount; ++i)
+      {
+        const SShaderPackIndexEntry entry = readIndexEntry(i);
+        if (entry.nNameOffset > m_nSize || entry.nNameLength > m_nSize - entry.nNameOffset
+          || entry.nSourceOffset > m_nSize || entry.nSourceLength >= m_nSize - entry.nSourceOffset)
+          return fail(strPath, "has an entry out of the file");
+        const std::string_view strName(m_pData + entry.nNameOffset, entry.nNameLength);
+        if (i > 0 && !(strPreviousName < strName))
+          return fail(strPath, "has an unsorted index");
+        strPreviousName = strName;
+      }
+      return true;
+    }
+
+    /**
+     * \brief Unmaps the pack file. Views returned by Find() and GetEntry() become dangling.
+     */
+    void Close()
+    {
+      if (m_pData)
+      {
+#ifdef _WIN32
+        UnmapViewOfFile(m_pData);
+#else
+        munmap(const_cast<char*>(m_pData), m_nSize);
+#endif
+      }
+      m_pData = nullptr;
+      m_nSize = 0;
+      m_nEntryCount = 0;
+    }
+
+    /**
+     * \brief Tells if a pack is open.
+     */
+    bool IsOpen() const { return m_pData != nullptr; }
+
+    /**
+     * \brief Gets the number of sources in the pack.
+     */
+    std::size_t GetSize() const { return m_nEntryCount; }
+
+    /**
+     * \brief Gets a source of the pack, by its rank in the index. Sources are sorted by name.
+     *
+     * \param nIndex The rank of the source, less than GetSize().
+     */
+    SShaderPackEntry GetEntry(std::size_t nIndex) const
+    {
+      const SShaderPackIndexEntry entry = readIndexEntry(nIndex);
+      return SShaderPackEntry{
+        std::string_view(m_pData + entry.nNameOffset, entry.nNameLength),
+        std::string_view(m_pData + entry.nSourceOffset, entry.nSourceLength),
+        entry.nStage,
+        entry.nHash };
+    }
+
+    /**
+     * \brief Finds a source of the pack by its name, with a binary search.
+     *
+     * \param strName The name of the source, as given to CShaderPackWriter::Add().
+     * \return The found source, or \c std::nullopt if the pack has no source with this name.
+     */
+    std::optional<SShaderPackEntry> Find(std::string_view strName) const
+    {
+      std::size_t nFirst = 0, nLast = m_nEntryCount;
+      while (nFirst < nLast)
+      {
+        const std::size_t nMiddle = nFirst + (nLast - nFirst) / 2;
+        const SShaderPackIndexEntry entry = readIndexEntry(nMiddle);
+        const std::string_view strMiddle(m_pData + entry.nNameOffset, entry.nNameLength);
+        if (strMiddle < strName)
+          nFirst = nMiddle + 1;
+        else if (strName < strMiddle)
+          nLast = nMiddle;
+        else
+          return GetEntry(nMiddle);
+      }
+      return std::nullopt;
+    }
+
+    /**
+     * \brief Checks the hashes of all sources of the pack.
+     *
+     * Opening a pack does not read its sources, so this is the only way to detect corrupted sources. It reads
+     * the whole pack.
+     *
+     * \return \c true if all hashes are right.
+     */
+    bool VerifyHashes() const
+    {
+      for (std::size_t i = 0; i < m_nEntryCount; ++i)
+      {
+        const SShaderPackEntry entry = GetEntry(i);
+        if (Fnv1a64(entry.strSource) != entry.nHash)
+          return false;
+      }
+      return true;
+    }
+
+  private:
+    /**
+     * \brief Reads an index entry. The mapping gives no alignment guarantee, so it is copied.
+     */
+    SShaderPackIndexEntry readIndexEntry(std::size_t nIndex) const
+    {
+      SShaderPackIndexEntry entry;
+      std::memcpy(&entry, m_pData + sizeof(SShaderPackHeader) + nIndex * sizeof(SShaderPackIndexEntry), sizeof(entry));
+      return entry;
+    }
+
+    /**
+     * \brief Maps a whole file read only and shared.
+     *
+     * \return \c false if the file cannot be opened or mapped, or is empty.
+     */
+    bool map(const std::string& strPath)
+    {
+#ifdef _WIN32
+      HANDLE hFile = CreateFileA(strPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+      if (hFile == INVALID_HANDLE_VALUE)
+        return false;
+      LARGE_INTEGER size;
+      if (!GetFileSizeEx(hFile, &size) || size.QuadPart == 0)
+      {
+        CloseHandle(hFile);
+        return false;
+      }
+      HANDLE hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      CloseHandle(hFile);
+      if (!hMapping)
+        return false;
+      //The view keeps the mapping alive
+      m_pData = static_cast<const char*>(MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0));
+      CloseHandle(hMapping);
+      m_nSize = m_pData ? static_cast<std::size_t>(size.QuadPart) : 0;
+#else
+      const int nFile = open(strPath.c_str(), O_RDONLY);
+      if (nFile < 0)
+        return false;
+      struct stat status;
+      if (fstat(nFile, &status) != 0 || status.st_size == 0)
+      {
+        close(nFile);
+        return false;
+      }
+      //The mapping stays valid after the file is closed
+      void* pData = mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_SHARED, nFile, 0);
+      close(nFile);
+      if (pData == MAP_FAILED)
+        return false;
+      m_pData = static_cast<const char*>(pData);
+      m_nSize = static_cast<std::size_t>(status.st_size);
+#endif
+      return m_pData != nullptr;
+    }
+
+    /**
+     * \brief Closes the pack and reports an error with the error policy.
+     *
+     * \return \c false
+     */
+    bool fail(const std::string& strPath, const char* szReason)
+    {
+      Close();
+      ErrorPolicy::Report(CShaderException::ExceptionType::BadShaderPack, [&strPath, szReason]() {
+        return "Error: shader pack \"" + strPath + "\" " + szReason;
+        });
+      return false;
+    }
+  };
+
+  using CShaderPackReader = CBasicShaderPackReader<>; //!< A shader pack reader using CDefaultErrorPolicy
+
+  /**
+   * \brief Writes shader packs, to be read by CBasicShaderPackReader.
+   *
+   * Sources are added with their name, usually their relative path, then the pack is written at once.
+   *
+   * \code{.cpp}
+   * GLShaderPP::CShaderPackWriter writer;
+   * writer.Add("shaders/sky.vert", GL_VERTEX_SHADER, readFile("shaders/sky.vert"));
+   * std::ofstream file("shaders.glsp", std::ios::binary);
+   * writer.Write(file);
+   * \endcode
+   */
+  class CShaderPackWriter
+  {
+    //!\brief A source to write
+    struct SSource
+    {
+      std::uint32_t nStage;   //!< OpenGL type of the shader
+      std::string strSource;  //!< GLSL source
+    };
+
+    std::map<std::string, SSource, std::less<>> m_sources; //!< Sources to write, sorted by name
+
+  public:
+    /**
+     * \brief Adds a source to the pack.
+     *
+     * \param strName The name of the source, used to find it in the pack.
+     * \param nStage The OpenGL type of the shader (\c GL_VERTEX_SHADER...), or 0 if unknown.
+     * \param strSource The GLSL source.
+     * \return \c false if the pack already has a source with this name. It is left unchanged.
+     */
+    bool Add(std::string strName, std::uint32_t nStage, std::string strSource)
+    {
+      return m_sources.try_emplace(std::move(strName), SSource{ nStage, std::move(strSource) }).second;
+    }
+
+    /**
+     * \brief Gets the number of sources added to the pack.
+     */
+    std::size_t GetSize() const { return m_sources.size(); }
+
+    /**
+     * \brief Writes the pack.
+     *
+     * \param stream A binary output stream.
+     * \return \c false if the pack is too large for the format or the stream fails.
+     */
+    bool Write(std::ostream& stream) const
+    {
+      const std::uint64_t nIndexSize = sizeof(SShaderPackIndexEntry) * static_cast<std::uint64_t>(m_sources.size());
+      std::uint64_t nNamesSize = 0;
+      for (const auto& [strName, source] : m_sources)
+      {
+        nNamesSize += strName.size();
+        if (source.strSource.size() >= std::numeric_limits<std::uint32_t>::max())
+          return false;
+      }
+      if (sizeof(SShaderPackHeader) + nIndexSize + nNamesSize > std::numeric_limits<std::uint32_t>::max())
+        return false;
+
+      SShaderPackHeader header;
+      std::memcpy(header.szMagic, SShaderPackHeader::magic, sizeof(header.szMagic));
+      header.nVersion = SShaderPackHeader::version;
+      header.nByteOrderMark = SShaderPackHeader::byteOrderMark;
+      header.nEntryCount = static_cast<std::uint32_t>(m_sources.size());
+      stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+      std::uint64_t nNameOffset = sizeof(SShaderPackHeader) + nIndexSize;
+      std::uint64_t nSourceOffset = nNameOffset + nNamesSize;
+      for (const auto& [strName, source] : m_sources)
+      {
+        SShaderPackIndexEntry entry;
+        entry.nSourceOffset = nSourceOffset;
+        entry.nHash = Fnv1a64(source.strSource);
+        entry.nSourceLength = static_cast<std::uint32_t>(source.strSource.size());
+        entry.nNameOffset = static_cast<std::uint32_t>(nNameOffset);
+        entry.nNameLength = static_cast<std::uint32_t>(strName.size());
+        entry.nStage = source.nStage;
+        stream.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+        nNameOffset += strName.size();
+        nSourceOffset += source.strSource.size() + 1;
+      }
+      for (const auto& [strName, source] : m_sources)
+        stream.write(strName.data(), strName.size());
+      for (const auto& [strName, source] : m_sources)
+        stream.write(source.strSource.c_str(), source.strSource.size() + 1);
+      return stream.good();
+    }
+  };
+
+}
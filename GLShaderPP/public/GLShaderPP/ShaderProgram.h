@@ -9,6 +9,9 @@
 
 #pragma once
 #include "Shader.h"
+#include "StateCache.h"
+#include <algorithm>
+#include <vector>
 #ifdef __cpp_lib_concepts
 #include <concepts>
 #endif
@@ -19,39 +22,43 @@ namespace GLShaderPP {
    * \brief Shader concept.
    * 
    * If C++20 is supported, Shader is a concept which ensures that CShaderProgram::CShaderProgram
-   * parameters are subclasses of CShader. Otherwise, it's simply a synonym of \c class
+   * parameters are subclasses of CShaderBase, whatever their error policy is. Otherwise, it's simply a synonym of \c class
    */
 #ifdef __cpp_lib_concepts
   template<typename T>
-  concept Shader = std::derived_from<T, CShader>;
+  concept Shader = std::derived_from<T, CShaderBase>;
 #else
 #define Shader class
 #endif
 
   /**
-   * \brief An OpenGL shader program.
-   * 
-   * This class represents an OpenGL shader program. The principle is to attach 
-   * compiled CShader objects to it (by AttachShader() or operator<<()), then to
-   * Link() the program. If everything is OK, you can then Use() your shader program 
-   * in your rendering.
+   * \brief Tag type to ask CShaderProgram to detach its shaders after linking.
    * 
-   * Attachements and linking can be done directly at construction by using templated 
-   * constructor CShaderProgram::CShaderProgram(Shader... S)
-   * 
-   * If something is going wrong during attachement or linking, a CShaderException will 
-   * be thrown except if you defined #_DONT_USE_SHADER_EXCEPTION before including this file. 
-   * In this case, you have to GetLinkingStatus() to know if everything is all right.
+   * \see CBasicShaderProgram::CBasicShaderProgram(SDetachShaders, const S&...), CShaderProgramBase::SetDetachShadersAfterLink()
+   */
+  struct SDetachShaders {};
+
+  /**
+   * \brief Tag value to ask CShaderProgram to detach its shaders after linking.
+   */
+  inline constexpr SDetachShaders detachShaders{};
+
+  class CUniformBatch;
+
+  /**
+   * \brief The part of an OpenGL shader program which does not depend on its error policy.
    * 
-   * \see CShader, CShaderException
+   * CShaderProgramBase owns the underlying OpenGL shader program object and tracks its state. Functions which
+   * may report errors are provided by CBasicShaderProgram, according to its error policy.
    */
-  class CShaderProgram
+  class CShaderProgramBase
   {
   public:
     //!\brief The status of the linking process
     enum class LinkingStatus
     {
       notLinked,        //!< The shader program has not been linked yet
+      linkPending,      //!< The link has been submitted to the driver but its result has not been checked yet
       linkingError,     //!< An error occured during the linking attempt
       prepareLinkError, //!< A non compiled shader has been attached
       linkingOk         //!< The link has been correctly done
@@ -59,36 +66,25 @@ namespace GLShaderPP {
 
   private:
     LinkingStatus m_eLinkingStatus = LinkingStatus::notLinked; //!< The status of the linking process of this shader program
-    GLuint m_nProgram; //!< The OpenGL object identifier of this shader program 
-
-    CShaderProgram(const CShaderProgram&) = delete;
-    CShaderProgram& operator=(const CShaderProgram&) = delete;
+    GLuint m_nProgram = 0; //!< The OpenGL object identifier of this shader program
+    std::vector<GLenum> m_stages; //!< OpenGL types of the attached shaders
+    bool m_bDetachShadersAfterLink = false; //!< Whether shaders are detached after a successful link
+    mutable std::size_t m_nBinarySize = 0; //!< Binary size of the linked program, as reported by the driver
+    mutable bool m_bBinarySizeKnown = false; //!< Whether m_nBinarySize has been queried since the last link
+    std::string m_strLabel; //!< A human readable name of this shader program
 
-  public:
-    /**
-     * \brief Automatically attaches and links shaders
-     * 
-     * This constructor take a list of CShader objects as parameters. Each CShader is attached to this
-     * constructed program shader, then the shader program is linked. CShader objects must be compiled before
-     * being passed to this constructor
-     * 
-     * \tparam S must be CShader class or one of its derivative. Must respect the GLShaderPP::Shader concept.
-     * 
-     * \param shaders must be CShader objects to be attached and linked into this shader program.
-     */
-    template<Shader... S>
-    CShaderProgram(const S&... shaders);
+    CShaderProgramBase(const CShaderProgramBase&) = delete;
+    CShaderProgramBase& operator=(const CShaderProgramBase&) = delete;
 
+  protected:
     /**
-     * \brief Simply creates an empty shader program.
-     * 
-     * After creating a CShaderProgram this way, you have to AttachShader()s to it then Link() it.
+     * \brief Creates the underlying OpenGL shader program object.
      * 
-     * \throw CShaderException If \c glCreateProgram is \c nullptr, a CShaderException::ExceptionType::GlewInit typed CShaderException 
-     * is thrown. It may append when your OpenGL function loader is not initialised. This exception is thrown whenever
-     * #_DONT_USE_SHADER_EXCEPTION is defined or not.
+     * \throw CShaderException If \c glCreateProgram is \c nullptr, a CShaderException::ExceptionType::GlewInit typed CShaderException
+     * is thrown. It may append when your OpenGL function loader is not initialised. This exception is thrown whatever
+     * the error policy is.
      */
-    CShaderProgram()
+    CShaderProgramBase()
     {
       if (!glCreateProgram)
 #ifdef GLEW_VERSION
@@ -97,13 +93,158 @@ namespace GLShaderPP {
 #endif
         throw CShaderException("Error: OpenGL context seems not to be properly initialised.", CShaderException::ExceptionType::GlewInit);
       m_nProgram = glCreateProgram();
+      CResourceStats::AddProgram();
     }
 
+    /**
+     * \brief Sets the status of the linking process.
+     */
+    void setLinkingStatus(LinkingStatus eLinkingStatus) { m_eLinkingStatus = eLinkingStatus; }
+
+    /**
+     * \brief Attaches a compiled shader to the underlying OpenGL shader program object.
+     */
+    void attachShader(const CShaderBase& s)
+    {
+      glAttachShader(m_nProgram, s.GetShaderId());
+      m_stages.push_back(s.GetStage());
+    }
+
+    /**
+     * \brief Checks the result of a submitted link.
+     * 
+     * On success, the binary size is queried if CResourceStats::IsBinaryAccountingEnabled(), and shaders are
+     * detached if asked.
+     * 
+     * \return \c true if the link succeeded.
+     */
+    bool checkLinkStatus()
+    {
+      GLint value;
+      glGetProgramiv(m_nProgram, GL_LINK_STATUS, &value);
+      forgetBinarySize();
+      if (value != GL_TRUE)
+      {
+        m_eLinkingStatus = LinkingStatus::linkingError;
+        return false;
+      }
+      m_eLinkingStatus = LinkingStatus::linkingOk;
+      if (CResourceStats::IsBinaryAccountingEnabled())
+        GetBinarySize();
+      if (m_bDetachShadersAfterLink)
+        detachShaders();
+      return true;
+    }
+
+    /**
+     * \brief Returns the link log of the underlying OpenGL shader program object.
+     */
+    std::string getInfoLog() const
+    {
+      GLint length = 0;
+      glGetProgramiv(m_nProgram, GL_INFO_LOG_LENGTH, &length);
+      std::string infologbuffer;
+      infologbuffer.resize(length);
+      if (length > 0)
+        glGetProgramInfoLog(m_nProgram, length, nullptr, &infologbuffer.front());
+      return infologbuffer;
+    }
+
+  public:
     /**
      * \brief Delete underlying OpenGL shader program object.
      */
-    ~CShaderProgram() {
-      glDeleteProgram(m_nProgram);
+    ~CShaderProgramBase() { release(); }
+
+    /**
+     * \brief Moves a shader program.
+     * 
+     * The underlying OpenGL shader program object is given to the constructed object. \c other is left
+     * without any OpenGL object and can only be destroyed or assigned.
+     */
+    CShaderProgramBase(CShaderProgramBase&& other) noexcept
+      : m_eLinkingStatus(other.m_eLinkingStatus), m_nProgram(other.m_nProgram), m_stages(std::move(other.m_stages)),
+        m_bDetachShadersAfterLink(other.m_bDetachShadersAfterLink), m_nBinarySize(other.m_nBinarySize),
+        m_bBinarySizeKnown(other.m_bBinarySizeKnown), m_strLabel(std::move(other.m_strLabel))
+    {
+      other.m_nProgram = 0;
+      other.m_nBinarySize = 0;
+      other.m_bBinarySizeKnown = false;
+      other.m_eLinkingStatus = LinkingStatus::notLinked;
+    }
+
+    /**
+     * \brief Moves a shader program.
+     * 
+     * The underlying OpenGL shader program object of this object is deleted, then the one of \c other is
+     * given to this object. \c other is left without any OpenGL object and can only be destroyed or assigned.
+     */
+    CShaderProgramBase& operator=(CShaderProgramBase&& other) noexcept
+    {
+      if (this != &other)
+      {
+        release();
+        m_eLinkingStatus = other.m_eLinkingStatus;
+        m_nProgram = other.m_nProgram;
+        m_stages = std::move(other.m_stages);
+        m_bDetachShadersAfterLink = other.m_bDetachShadersAfterLink;
+        m_nBinarySize = other.m_nBinarySize;
+        m_bBinarySizeKnown = other.m_bBinarySizeKnown;
+        m_strLabel = std::move(other.m_strLabel);
+        other.m_nProgram = 0;
+        other.m_nBinarySize = 0;
+        other.m_bBinarySizeKnown = false;
+        other.m_eLinkingStatus = LinkingStatus::notLinked;
+      }
+      return *this;
+    }
+
+    /**
+     * \brief Asks to detach shaders from this program once it is successfully linked.
+     * 
+     * An attached shader object is kept alive by the driver until the program is deleted, even if its
+     * CShader is destroyed. Detaching shaders after link lets the driver free them as soon as their CShader
+     * objects are destroyed. The program remains fully usable.
+     * 
+     * \param bDetach \c true to detach shaders at the next successful Link().
+     */
+    void SetDetachShadersAfterLink(bool bDetach) { m_bDetachShadersAfterLink = bDetach; }
+
+    /**
+     * \brief Tells if a shader of a given OpenGL type has been attached to this program.
+     * 
+     * This remains true after shaders have been detached (see SetDetachShadersAfterLink()).
+     * 
+     * \param eStage The OpenGL type of the shader (\c GL_VERTEX_SHADER, \c GL_FRAGMENT_SHADER...).
+     */
+    bool HasStage(GLenum eStage) const { return std::find(m_stages.begin(), m_stages.end(), eStage) != m_stages.end(); }
+
+    /**
+     * \brief Returns the binary size of the linked program as reported by \c GL_PROGRAM_BINARY_LENGTH.
+     * 
+     * The size is queried at the first call after each link, unless CResourceStats::IsBinaryAccountingEnabled()
+     * made the link query it, then it is counted by CResourceStats.
+     * 
+     * \return The size in bytes, or 0 if the program is not linked or if the driver can't report it.
+     */
+    std::size_t GetBinarySize() const
+    {
+      if (!m_bBinarySizeKnown && m_eLinkingStatus == LinkingStatus::linkingOk)
+      {
+        std::size_t nBinarySize = 0;
+#ifdef GL_PROGRAM_BINARY_LENGTH
+        if (CStateCache::Current().IsGLVersionAtLeast(4, 1))
+        {
+          GLint nLength = 0;
+          glGetProgramiv(m_nProgram, GL_PROGRAM_BINARY_LENGTH, &nLength);
+          nBinarySize = static_cast<std::size_t>(nLength);
+        }
+#endif
+        CResourceStats::UpdateBinaryBytes(0, nBinarySize);
+        m_nBinarySize = nBinarySize;
+        m_bBinarySizeKnown = true;
+      }
+      return m_nBinarySize;
     }
 
     /**
@@ -111,6 +252,18 @@ namespace GLShaderPP {
      */
     LinkingStatus GetLinkingStatus() const { return m_eLinkingStatus; }
 
+    /**
+     * \brief Gives a human readable name to this shader program.
+     * 
+     * The label is used by tools such as CGpuProfiler to aggregate and report measures by program.
+     */
+    void SetLabel(std::string strLabel) { m_strLabel = std::move(strLabel); }
+
+    /**
+     * \brief Returns the human readable name of this shader program, or "program #<id>" if none has been set.
+     */
+    std::string GetLabel() const { return m_strLabel.empty() ? "program #" + std::to_string(m_nProgram) : m_strLabel; }
+
     /**
      * \brief Returns the OpenGL object identifier of this shader program.
      */
@@ -118,37 +271,224 @@ namespace GLShaderPP {
 
     /**
      * Enable this shader program by calling \c glUseProgram().
+     * 
+     * The call is skipped if this program is already bound according to the CStateCache of the calling thread.
      */
-    void Use() { glUseProgram(m_nProgram); }
+    void Use() { CStateCache::Current().UseProgram(m_nProgram); }
+
+    /**
+     * \brief Returns the location of a uniform of the linked program, or -1 if it is not an active uniform.
+     */
+    GLint GetUniformLocation(const char* pName) const { return glGetUniformLocation(m_nProgram, pName); }
+
+    /**
+     * \brief Sets a uniform value of this program, without binding it if possible.
+     * 
+     * The uniform setters of CShaderProgramBase are defined in Uniforms.h, which must be included by the code
+     * calling them, so that ShaderProgram.h does not bring the uniform machinery to the code which does not use it.
+     * 
+     * \param nLocation The location of the uniform. A location of -1 is silently ignored.
+     * \param value The value, of a type supported by SUniformType.
+     * \see SetProgramUniform()
+     */
+    template<typename T>
+    void SetUniform(GLint nLocation, const T& value);
+
+    /**
+     * \brief Sets the values of an array uniform of this program, without binding it if possible.
+     * 
+     * \param nLocation The location of the first element of the array uniform.
+     * \param pValues The values, of a type supported by SUniformType.
+     * \param nCount The number of values.
+     */
+    template<typename T>
+    void SetUniformArray(GLint nLocation, const T* pValues, GLsizei nCount);
+
+    /**
+     * \brief Sets several uniform values of the same type of this program, without binding it if possible.
+     * 
+     * \param pUniforms (location, value) pairs, the values being of a type supported by SUniformType.
+     * \param nCount The number of pairs.
+     */
+    template<typename T>
+    void SetUniforms(const std::pair<GLint, T>* pUniforms, std::size_t nCount);
+
+    /**
+     * \brief Sets several uniform values of the same type of this program, without binding it if possible.
+     * 
+     * \param uniforms (location, value) pairs, the values being of a type supported by SUniformType.
+     */
+    template<typename T>
+    void SetUniforms(const std::vector<std::pair<GLint, T>>& uniforms);
+
+    /**
+     * \brief Sets uniform values of several types of this program, without binding it if possible.
+     * 
+     * \param batch The values, with locations of this program.
+     */
+    void SetUniforms(const CUniformBatch& batch);
+
+    /**
+     * \brief Submits the link of this shader program to the driver without waiting for the result.
+     * 
+     * The linking status becomes LinkingStatus::linkPending. Use IsLinkCompleted() to know if Link() can
+     * be called without blocking to check the link result.
+     */
+    void SubmitLink() {
+      if (m_eLinkingStatus == LinkingStatus::notLinked)
+      {
+        glLinkProgram(m_nProgram);
+        m_eLinkingStatus = LinkingStatus::linkPending;
+      }
+    }
+
+    /**
+     * \brief Tells if a submitted link is finished.
+     * 
+     * \return \c false only if the link is pending and the driver reports that it is still running. If
+     * the driver can't tell (see IsParallelCompileSupported()), \c true is returned and the next Link() may block.
+     */
+    bool IsLinkCompleted() const {
+      if (m_eLinkingStatus != LinkingStatus::linkPending)
+        return true;
+#ifdef GL_COMPLETION_STATUS_KHR
+      if (IsParallelCompileSupported())
+      {
+        GLint value = GL_TRUE;
+        glGetProgramiv(m_nProgram, GL_COMPLETION_STATUS_KHR, &value);
+        return value == GL_TRUE;
+      }
+#endif
+      return true;
+    }
+
+  private:
+    /**
+     * \brief Deletes the underlying OpenGL shader program object, if any.
+     */
+    void release()
+    {
+      if (m_nProgram == 0)
+        return;
+      CStateCache::Current().ForgetProgram(m_nProgram);
+      glDeleteProgram(m_nProgram);
+      CResourceStats::RemoveProgram();
+      forgetBinarySize();
+      m_nProgram = 0;
+    }
+
+    /**
+     * \brief Detaches every shader attached to this program.
+     */
+    void detachShaders()
+    {
+      GLint nShaders = 0;
+      glGetProgramiv(m_nProgram, GL_ATTACHED_SHADERS, &nShaders);
+      if (nShaders <= 0)
+        return;
+      std::vector<GLuint> shaders(nShaders);
+      glGetAttachedShaders(m_nProgram, nShaders, nullptr, shaders.data());
+      for (GLuint nShader : shaders)
+        glDetachShader(m_nProgram, nShader);
+    }
+
+    /**
+     * \brief Forgets the binary size of the program and removes it from resource accounting.
+     */
+    void forgetBinarySize()
+    {
+      CResourceStats::UpdateBinaryBytes(m_nBinarySize, 0);
+      m_nBinarySize = 0;
+      m_bBinarySizeKnown = false;
+    }
+  };
+
+  /**
+   * \brief An OpenGL shader program.
+   * 
+   * This class represents an OpenGL shader program. The principle is to attach
+   * compiled CShader objects to it (by AttachShader() or operator<<()), then to
+   * Link() the program. If everything is OK, you can then Use() your shader program
+   * in your rendering.
+   * 
+   * Attachements and linking can be done directly at construction by using templated
+   * constructor CBasicShaderProgram::CBasicShaderProgram(Shader... S)
+   * 
+   * If something is going wrong during attachement or linking, the error is reported through the error policy:
+   * a CShaderException is thrown by CThrowErrorPolicy, a message is written to stderr by CStderrErrorPolicy,
+   * and so on (see ErrorPolicy.h). Whatever the policy is, you can GetLinkingStatus() to know if everything is
+   * all right. CShaderProgram uses CDefaultErrorPolicy, which depends on #_DONT_USE_SHADER_EXCEPTION.
+   * 
+   * \tparam ErrorPolicy The error policy, such as CThrowErrorPolicy or CStatusErrorPolicy.
+   * 
+   * \see CShader, CShaderException
+   */
+  template<typename ErrorPolicy = CDefaultErrorPolicy>
+  class CBasicShaderProgram : public CShaderProgramBase
+  {
+  public:
+    /**
+     * \brief Automatically attaches and links shaders
+     * 
+     * This constructor take a list of CShader objects as parameters. Each CShader is attached to this
+     * constructed program shader, then the shader program is linked. CShader objects must be compiled before
+     * being passed to this constructor
+     * 
+     * \tparam S must be CShader class or one of its derivative. Must respect the GLShaderPP::Shader concept.
+     * When S are CShaderT classes, whose types are known at compile time, a program with two shaders of the same type
+     * or mixing a compute shader with other shader types does not compile.
+     * 
+     * \param shaders must be CShader objects to be attached and linked into this shader program.
+     */
+    template<Shader... S>
+    CBasicShaderProgram(const S&... shaders);
+
+    /**
+     * \brief Automatically attaches and links shaders, then detaches them
+     * 
+     * This constructor does the same as CBasicShaderProgram(const S&...), except that shaders are detached
+     * once the link succeeded (see SetDetachShadersAfterLink()).
+     * 
+     * \tparam S must be CShader class or one of its derivative. Must respect the GLShaderPP::Shader concept.
+     * 
+     * \param shaders must be CShader objects to be attached and linked into this shader program.
+     */
+    template<Shader... S>
+    CBasicShaderProgram(SDetachShaders, const S&... shaders);
+
+    /**
+     * \brief Simply creates an empty shader program.
+     * 
+     * After creating a CShaderProgram this way, you have to AttachShader()s to it then Link() it.
+     * 
+     * \throw CShaderException If \c glCreateProgram is \c nullptr, a CShaderException::ExceptionType::GlewInit typed CShaderException
+     * is thrown. It may append when your OpenGL function loader is not initialised. This exception is thrown whatever
+     * the error policy is.
+     */
+    CBasicShaderProgram() = default;
 
     /**
      * \brief Attaches a shader stage to this shader program.
      * 
-     * \param s The CShader object to attach. Note that \c s must be previously compiled.
+     * \param s The CShader object to attach, whatever its error policy is. Note that \c s must be previously compiled.
      * 
      * \note A possibly more convenient way to do the same task is to use operator<<().
      * 
-     * \throw CShaderException A CShaderException::ExceptionType::PrepareLinkError typed CShaderException if
-     * \c s is not compiled and #_DONT_USE_SHADER_EXCEPTION is not defined. If #_DONT_USE_SHADER_EXCEPTION
-     * is defined, a message is displayed in stderr.
+     * \throw CShaderException With CThrowErrorPolicy, a CShaderException::ExceptionType::PrepareLinkError typed
+     * CShaderException if \c s is not compiled.
      */
-    void AttachShader(const CShader& s) {
-      if (m_eLinkingStatus != LinkingStatus::notLinked)
+    void AttachShader(const CShaderBase& s) {
+      if (GetLinkingStatus() != LinkingStatus::notLinked)
         return;
-      if (s.GetCompileState() != CShader::ShaderCompileState::compileOk)
+      if (s.GetCompileState() != CShaderBase::ShaderCompileState::compileOk)
       {
-        m_eLinkingStatus = LinkingStatus::prepareLinkError;
-        std::string what{ s.GetType() + " shader has not been compiled before being attached to program" };
-#ifndef _DONT_USE_SHADER_EXCEPTION
-        throw CShaderException(what, CShaderException::ExceptionType::PrepareLinkError);
-#else
-        std::cerr << what << '\n';
-#endif
+        setLinkingStatus(LinkingStatus::prepareLinkError);
+        ErrorPolicy::Report(CShaderException::ExceptionType::PrepareLinkError, [&s]() {
+          return s.GetType() + " shader has not been compiled before being attached to program";
+        });
       }
       else
-      {
-        glAttachShader(m_nProgram, s.GetShaderId());
-      }
+        attachShader(s);
     }
 
     /**
@@ -159,69 +499,64 @@ namespace GLShaderPP {
      * \param s The CShader object to attach. Note that \c s must be previously compiled.
      * \return A reference to this shader program object.
      */
-    CShaderProgram& operator<<(const CShader& s) { AttachShader(s); return *this; }
+    CBasicShaderProgram& operator<<(const CShaderBase& s) { AttachShader(s); return *this; }
 
     /**
      * \brief Links this shader program.
-     *
-     * \throw CShaderException A CShaderException::ExceptionType::LinkError typed CShaderException if link is not possible
-     * and #_DONT_USE_SHADER_EXCEPTION is not defined. If #_DONT_USE_SHADER_EXCEPTION is defined, 
-     * a message is displayed in stderr.
+     * 
+     * If the link has already been submitted by SubmitLink(), this function only checks its result.
+     * 
+     * \return The status of the linking process, as returned by GetLinkingStatus() afterwards.
+     * 
+     * \throw CShaderException With CThrowErrorPolicy, a CShaderException::ExceptionType::LinkError typed
+     * CShaderException if link is not possible.
      */
-    void Link() {
-      if (m_eLinkingStatus == LinkingStatus::notLinked)
-      {
-        glLinkProgram(m_nProgram);
+    LinkingStatus Link() {
+      SubmitLink();
+      if (GetLinkingStatus() == LinkingStatus::linkPending)
         VerifLinking();
-      }
+      return GetLinkingStatus();
     }
 
-
   private:
     /**
      * \brief Checks the state of linking.
      * 
-     * If an error occured during linking, according to #_DONT_USE_SHADER_EXCEPTION definition, 
-     * a CShaderException containing the GLSL linker error message is thrown or this message 
-     * is displayed on \c stderr.
+     * If an error occured during linking, it is reported through the error policy, with the GLSL linker
+     * error message.
      */
     void VerifLinking()
     {
-      GLint value;
-      glGetProgramiv(m_nProgram, GL_LINK_STATUS, &value);
-      if (value == GL_TRUE)
-        m_eLinkingStatus = LinkingStatus::linkingOk;
-      else
-      {
-        m_eLinkingStatus = LinkingStatus::linkingError;
-        GLint length = 0;
-        glGetProgramiv(m_nProgram, GL_INFO_LOG_LENGTH, &length);
-        std::string infologbuffer;
-        infologbuffer.resize(length);
-        glGetProgramInfoLog(m_nProgram, length, nullptr, &infologbuffer.front());
-        std::string what{ "An error occured during program linking\n" + infologbuffer };
-#ifndef _DONT_USE_SHADER_EXCEPTION
-        throw CShaderException(what, CShaderException::ExceptionType::LinkError);
-#else
-        std::cerr << what << '\n';
-#endif
-      }
+      if (!checkLinkStatus())
+        ErrorPolicy::Report(CShaderException::ExceptionType::LinkError, [this]() {
+          return "An error occured during program linking\n" + getInfoLog();
+        });
     }
+  };
 
+  /**
+   * \brief An OpenGL shader program using the default error policy.
+   */
+  using CShaderProgram = CBasicShaderProgram<>;
 
-  };
+  template<typename ErrorPolicy>
+  template<Shader... S>
+  CBasicShaderProgram<ErrorPolicy>::CBasicShaderProgram(const S&... shaders)
+  {
+    static_assert(HasDistinctStaticStages<S...>(), "A shader program can not have two shaders of the same type");
+    static_assert(HasCompatibleStaticStages<S...>(), "A compute shader can not be linked with other shader types");
+    ((*this) << ... << shaders);
+    Link();
+  }
 
+  template<typename ErrorPolicy>
   template<Shader... S>
-  CShaderProgram::CShaderProgram(const S&... shaders)
+  CBasicShaderProgram<ErrorPolicy>::CBasicShaderProgram(SDetachShaders, const S&... shaders)
   {
-    if (!glCreateProgram)
-#ifdef GLEW_VERSION
-      GlewInit();
-    if (!glCreateProgram)
-#endif
-      throw CShaderException("Error: OpenGL context seems not to be properly initialised.", CShaderException::ExceptionType::GlewInit);
-    m_nProgram = glCreateProgram();
+    static_assert(HasDistinctStaticStages<S...>(), "A shader program can not have two shaders of the same type");
+    static_assert(HasCompatibleStaticStages<S...>(), "A compute shader can not be linked with other shader types");
+    SetDetachShadersAfterLink(true);
     ((*this) << ... << shaders);
     Link();
   }
-}
\ No newline at end of file
+}
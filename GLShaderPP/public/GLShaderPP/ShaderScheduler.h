@@ -0,0 +1,354 @@
+/*****************************************************************//**
+ * \file      ShaderScheduler.h
+ * \brief     Declaration of CBasicShaderScheduler class and CShaderScheduler alias
+ *
+ * \author    Benjamin ALBOUY-KISSI
+ * \date      2022
+ * \copyright GNU Lesser Public License v3
+ *********************************************************************/
+#pragma once
+#include "ProgramBuilder.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+
+namespace GLShaderPP {
+
+  /**
+   * \brief Builds shader programs within a time budget per frame.
+   *
+   * Shader programs to build are enqueued with a priority by Enqueue(). Then, the render loop calls Pump()
+   * once per frame with a time budget: pending builds are advanced by highest priority first (see
+   * CBasicProgramBuilder::Step()) until the budget is spent. A single step is never interrupted, so a Pump() may
+   * overrun its budget by the duration of one compilation or one link. At least one step is done at each
+   * Pump() so that every build eventually finishes.
+   *
+   * The program of a build is used with Use(). If it is not ready yet, its build is promoted to the highest
+   * priority and the fallback program given by SetFallbackProgram() is used instead.
+   *
+   * \tparam ErrorPolicy The error policy of the builders and of the built programs. CShaderScheduler uses
+   * CDefaultErrorPolicy.
+   *
+   * \see CBasicProgramBuilder
+   */
+  template<typename ErrorPolicy = CDefaultErrorPolicy>
+  class CBasicShaderScheduler
+  {
+  public:
+    using BuilderType = CBasicProgramBuilder<ErrorPolicy>;  //!< The type of the scheduled builders
+    using ProgramType = typename BuilderType::ProgramType;  //!< The type of the built programs
+    using BuildState = typename BuilderType::BuildState;    //!< The state of a build
+
+
+    /**
+     * \brief Identifier of a build in the scheduler.
+     *
+     * A handle is made of a slot index and of a generation of this slot, so that a handle of a removed build
+     * is never mistaken for the build which reuses its slot.
+     */
+    using Handle = std::uint64_t;
+
+    //!\brief Handle returned by Enqueue() for an invalid build. It behaves like the handle of a failed build
+    static constexpr Handle InvalidHandle = ~Handle(0);
+
+    //!\brief Priority given to a build requested by Use() before being ready
+    static constexpr int PromotedPriority = std::numeric_limits<int>::max();
+
+    //!\brief Statistics of the last call to Pump()
+    struct SFrameStats
+    {
+      std::size_t nQueueDepth = 0;          //!< Number of builds still pending after the pump
+      std::size_t nSteps = 0;               //!< Number of build steps done during the pump
+      std::chrono::nanoseconds timeSpent{}; //!< Time spent in the pump
+    };
+
+  private:
+    //!\brief A slot holding a build, its program once ready, or nothing once failed until the failure is observed
+    struct SEntry
+    {
+      std::unique_ptr<BuilderType> pBuilder;     //!< The build while it is pending
+      std::unique_ptr<ProgramType> pProgram;     //!< The built program, once the build is ready
+      int nPriority = 0;                         //!< Priority of the build, highest first
+      std::uint32_t nGeneration = 0;             //!< Incremented each time the slot is freed
+    };
+
+    std::vector<SEntry> m_entries;                //!< Every slot, indexed by the slot index of a Handle
+    std::vector<std::uint32_t> m_free;            //!< Indices of the free slots
+    std::vector<std::uint32_t> m_pending;         //!< Indices of the slots of the builds which are not finished
+    CShaderProgramBase* m_pFallback = nullptr;    //!< The program used while a requested one is not ready
+    SFrameStats m_lastFrame;                      //!< Statistics of the last Pump()
+
+    CBasicShaderScheduler(const CBasicShaderScheduler&) = delete;
+    CBasicShaderScheduler& operator=(const CBasicShaderScheduler&) = delete;
+
+  public:
+    /**
+     * \brief Creates an empty scheduler.
+     */
+    CBasicShaderScheduler() = default;
+
+    /**
+     * \brief Sets the program to use while a requested program is not ready.
+     *
+     * \param pFallback The fallback program, which must outlive this scheduler or be reset. May be \c nullptr.
+     */
+    void SetFallbackProgram(CShaderProgramBase* pFallback) { m_pFallback = pFallback; }
+
+    /**
+     * \brief Enqueues a shader program to build.
+     *
+     * \param pBuilder The builder of the program, with all its stages added.
+     * \param nPriority The priority of this build. Builds with higher priority are advanced first.
+     * \return The handle of this build, or InvalidHandle if \c pBuilder is \c nullptr.
+     */
+    Handle Enqueue(std::unique_ptr<BuilderType> pBuilder, int nPriority = 0)
+    {
+      if (!pBuilder)
+        return InvalidHandle;
+      std::uint32_t nIndex;
+      if (m_free.empty())
+      {
+        nIndex = static_cast<std::uint32_t>(m_entries.size());
+        m_entries.emplace_back();
+      }
+      else
+      {
+        nIndex = m_free.back();
+        m_free.pop_back();
+      }
+      SEntry& entry = m_entries[nIndex];
+      entry.pBuilder = std::move(pBuilder);
+      entry.nPriority = nPriority;
+      m_pending.push_back(nIndex);
+      return makeHandle(nIndex, entry.nGeneration);
+    }
+
+    /**
+     * \brief Advances pending builds until the time budget is spent.
+     *
+     * When a build is finished, its builder is released: the scheduler only keeps the program of a ready build,
+     * and the failure of a failed build until it is observed by GetState() or Use().
+     *
+     * \param budget The time which can be spent in this call.
+     * \return Statistics of this call. They are also available by GetLastFrameStats().
+     *
+     * \throw CShaderException See CBasicProgramBuilder::Step(). The failing build is removed from the pending ones
+     * before the exception is propagated.
+     */
+    const SFrameStats& Pump(std::chrono::nanoseconds budget)
+    {
+      const auto start = std::chrono::steady_clock::now();
+      m_lastFrame = SFrameStats{};
+
+      std::stable_sort(m_pending.begin(), m_pending.end(), [this](std::uint32_t a, std::uint32_t b) {
+        return m_entries[a].nPriority > m_entries[b].nPriority;
+        });
+
+      try
+      {
+        bool bProgress = true;
+        while (bProgress && !m_pending.empty())
+        {
+          bProgress = false;
+          for (std::size_t i = 0; i < m_pending.size();)
+          {
+            if (m_lastFrame.nSteps > 0 && std::chrono::steady_clock::now() - start >= budget)
+            {
+              bProgress = false;
+              break;
+            }
+            SEntry& entry = m_entries[m_pending[i]];
+            if (entry.pBuilder->Step())
+            {
+              ++m_lastFrame.nSteps;
+              bProgress = true;
+            }
+            if (entry.pBuilder->IsFinished())
+            {
+              finish(entry);
+              m_pending.erase(m_pending.begin() + i);
+            }
+            else
+              ++i;
+          }
+        }
+      }
+      catch (...)
+      {
+        removeFinished();
+        updateStats(start);
+        throw;
+      }
+
+      updateStats(start);
+      return m_lastFrame;
+    }
+
+    /**
+     * \brief Uses the program of a build, or the fallback program if it is not ready.
+     *
+     * If the program is not ready, its build is promoted to PromotedPriority. If the build failed, the failure
+     * is observed: the build is removed as by Remove().
+     *
+     * \param h The handle of the build.
+     * \return \c true if the program of the build has been used, \c false if the fallback program
+     * (or no program at all) has been used instead.
+     */
+    bool Use(Handle h)
+    {
+      if (SEntry* pEntry = find(h))
+      {
+        if (pEntry->pProgram)
+        {
+          pEntry->pProgram->Use();
+          return true;
+        }
+        if (pEntry->pBuilder)
+          pEntry->nPriority = PromotedPriority;
+        else
+          Remove(h);
+      }
+      if (m_pFallback)
+        m_pFallback->Use();
+      return false;
+    }
+
+    /**
+     * \brief Returns the state of a build.
+     *
+     * If the build failed, the failure is observed: the build is removed as by Remove(), and its handle keeps
+     * returning BuildState::failed.
+     */
+    BuildState GetState(Handle h)
+    {
+      SEntry* pEntry = find(h);
+      if (pEntry && pEntry->pBuilder)
+        return pEntry->pBuilder->GetState();
+      if (pEntry && pEntry->pProgram)
+        return BuildState::ready;
+      if (pEntry)
+        Remove(h);
+      return BuildState::failed;
+    }
+
+    /**
+     * \brief Returns the program of a build, or \c nullptr if it is not ready.
+     */
+    ProgramType* GetProgram(Handle h) const
+    {
+      const SEntry* pEntry = find(h);
+      return pEntry ? pEntry->pProgram.get() : nullptr;
+    }
+
+    /**
+     * \brief Gives the ownership of the program of a ready build to the caller, and removes the build.
+     *
+     * \return The built program, or \c nullptr if it is not ready. In this case, the build is not removed.
+     */
+    std::unique_ptr<ProgramType> TakeProgram(Handle h)
+    {
+      SEntry* pEntry = find(h);
+      if (!pEntry || !pEntry->pProgram)
+        return nullptr;
+      std::unique_ptr<ProgramType> pProgram = std::move(pEntry->pProgram);
+      Remove(h);
+      return pProgram;
+    }
+
+    /**
+     * \brief Removes a build and deletes its program.
+     *
+     * The slot of the build is reused by the next builds. The handle remains safe to use: GetState() then returns
+     * BuildState::failed, GetProgram() returns \c nullptr and Use() uses the fallback program.
+     */
+    void Remove(Handle h)
+    {
+      SEntry* pEntry = find(h);
+      if (!pEntry)
+        return;
+      const std::uint32_t nIndex = static_cast<std::uint32_t>(h);
+      m_pending.erase(std::remove(m_pending.begin(), m_pending.end(), nIndex), m_pending.end());
+      pEntry->pBuilder.reset();
+      pEntry->pProgram.reset();
+      ++pEntry->nGeneration;
+      m_free.push_back(nIndex);
+    }
+
+    /**
+     * \brief Returns the number of builds which are not finished.
+     */
+    std::size_t GetQueueDepth() const { return m_pending.size(); }
+
+    /**
+     * \brief Returns the number of builds held by the scheduler: pending ones, ready ones which have not been removed
+     * and failed ones whose failure has not been observed.
+     */
+    std::size_t GetBuildCount() const { return m_entries.size() - m_free.size(); }
+
+    /**
+     * \brief Returns the statistics of the last call to Pump().
+     */
+    const SFrameStats& GetLastFrameStats() const { return m_lastFrame; }
+
+  private:
+    /**
+     * \brief Makes the handle of a slot.
+     */
+    static Handle makeHandle(std::uint32_t nIndex, std::uint32_t nGeneration) { return (Handle(nGeneration) << 32) | nIndex; }
+
+    /**
+     * \brief Returns the slot of a handle, or \c nullptr if the handle is invalid or its build has been removed.
+     */
+    SEntry* find(Handle h)
+    {
+      const std::uint64_t nIndex = h & 0xFFFFFFFFu;
+      if (nIndex >= m_entries.size() || m_entries[nIndex].nGeneration != static_cast<std::uint32_t>(h >> 32))
+        return nullptr;
+      return &m_entries[nIndex];
+    }
+
+    /**
+     * \brief Returns the slot of a handle, or \c nullptr if the handle is invalid or its build has been removed.
+     */
+    const SEntry* find(Handle h) const { return const_cast<CBasicShaderScheduler*>(this)->find(h); }
+
+    /**
+     * \brief Keeps the program of a finished build, or its failure, and releases its builder.
+     */
+    static void finish(SEntry& entry)
+    {
+      entry.pProgram = entry.pBuilder->TakeProgram();
+      entry.pBuilder.reset();
+    }
+
+    /**
+     * \brief Removes finished builds from pending ones.
+     */
+    void removeFinished()
+    {
+      m_pending.erase(std::remove_if(m_pending.begin(), m_pending.end(), [this](std::uint32_t nIndex) {
+        SEntry& entry = m_entries[nIndex];
+        if (!entry.pBuilder->IsFinished())
+          return false;
+        finish(entry);
+        return true;
+        }), m_pending.end());
+    }
+
+    /**
+     * \brief Updates the statistics of the current Pump().
+     */
+    void updateStats(std::chrono::steady_clock::time_point start)
+    {
+      m_lastFrame.nQueueDepth = m_pending.size();
+      m_lastFrame.timeSpent = std::chrono::steady_clock::now() - start;
+    }
+  };
+
+  /**
+   * \brief A shader scheduler using the default error policy.
+   */
+  using CShaderScheduler = CBasicShaderScheduler<>;
+
+}
@@ -0,0 +1,331 @@
+/*****************************************************************//**
+ * \file      SourcePipeline.h
+ * \brief     Declaration of CSourcePipeline class
+ *
+ * This header does not need OpenGL.
+ *
+ * \author    Benjamin ALBOUY-KISSI
+ * \date      2022
+ * \copyright GNU Lesser Public License v3
+ *********************************************************************/
+#pragma once
+#include "Hash.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace GLShaderPP {
+
+  /**
+   * \brief Prepares GLSL sources on worker threads, for the thread owning the OpenGL context.
+   *
+   * Reading files, resolving \c \#include directives, injecting \c \#define directives and hashing sources
+   * need no OpenGL context. A CSourcePipeline does this work on a CThreadPool, and the OpenGL thread takes the
+   * prepared sources by batches with TakeReady(), so that it only has to give them to CShader objects.
+   *
+   * \code{.cpp}
+   * GLShaderPP::CSourcePipeline pipeline;
+   * pipeline.AddIncludeDirectory("shaders/include");
+   * pipeline.AddDefine("MAX_LIGHTS", "16");
+   * pipeline.Submit("shaders/sky.vert", GL_VERTEX_SHADER);
+   * //On the OpenGL thread, every frame
+   * for (GLShaderPP::CSourcePipeline::SPreparedSource& source : pipeline.TakeReady(32))
+   *   if (source.bOk)
+   *     shaders.emplace(source.strName, std::make_unique<GLShaderPP::CShader>(source.nStage, source.strSource));
+   * \endcode
+   *
+   * An \c \#include \c "file" directive is replaced by the content of \c file, searched in the directory of
+   * the including file, then in the include directories. Each file is included at most once per prepared
+   * source, as if all of them started with \c \#pragma \c once, which also stops include cycles. Defines are
+   * inserted after the \c \#version directive, which may follow comments and blank lines.
+   *
+   * \c \#line directives are emitted after the defines and around included files, so that the line numbers of
+   * compiler errors are those of the files. Their source string numbers are indices in SPreparedSource::files.
+   *
+   * The include directories, the defines and the loader must be set before the first call to Submit().
+   */
+  class CSourcePipeline
+  {
+  public:
+    //!\brief A function loading a file, called by worker threads. It returns \c std::nullopt if the file cannot be read
+    using Loader = std::function<std::optional<std::string>(const std::string& strPath)>;
+
+    //!\brief A prepared source
+    struct SPreparedSource
+    {
+      std::string strName;            //!< The name given to Submit()
+      std::uint32_t nStage = 0;       //!< The OpenGL type of the shader given to Submit()
+      std::string strSource;          //!< The GLSL source, with includes resolved and defines injected
+      std::uint64_t nHash = 0;        //!< The FNV-1a hash of \c strSource
+      bool bOk = false;               //!< \c false if the source or one of its includes cannot be loaded
+      std::string strError;           //!< Explanation of the error if \c bOk is \c false
+      std::vector<std::string> files; //!< The loaded files, indexed by the source string numbers of \c \#line directives
+    };
+
+  private:
+    std::vector<std::filesystem::path> m_includeDirectories;  //!< Directories searched by \c \#include directives
+    std::string m_strDefines;                                 //!< The \c \#define directives to inject
+    Loader m_loader;                                          //!< Loads files
+    std::mutex m_readyMutex;                                  //!< Protects \c m_ready
+    std::vector<SPreparedSource> m_ready;                     //!< Prepared sources, not taken yet
+    std::atomic<std::size_t> m_nPending{ 0 };                 //!< Number of submitted sources not prepared yet
+    CThreadPool m_pool;                                       //!< Worker threads, stopped before other members are destroyed
+
+  public:
+    /**
+     * \brief Starts the worker threads of the pipeline.
+     *
+     * \param nThreads The number of worker threads. 0 means one per hardware thread.
+     */
+    explicit CSourcePipeline(std::size_t nThreads = 0) : m_loader(&LoadFile), m_pool(nThreads) {}
+
+    /**
+     * \brief Reads a whole file. It is the default loader.
+     */
+    static std::optional<std::string> LoadFile(const std::string& strPath)
+    {
+      std::ifstream file(strPath, std::ios::binary | std::ios::ate);
+      if (!file)
+        return std::nullopt;
+      std::string strContent(static_cast<std::size_t>(file.tellg()), '\0');
+      file.seekg(0);
+      if (!file.read(strContent.data(), strContent.size()))
+        return std::nullopt;
+      return strContent;
+    }
+
+    /**
+     * \brief Adds a directory searched by \c \#include directives.
+     */
+    void AddIncludeDirectory(std::filesystem::path directory) { m_includeDirectories.push_back(std::move(directory)); }
+
+    /**
+     * \brief Adds a \c \#define directive injected into all sources.
+     *
+     * \param strName The name of the macro.
+     * \param strValue The value of the macro, possibly empty.
+     */
+    void AddDefine(std::string_view strName, std::string_view strValue = {})
+    {
+      m_strDefines.append("#define ").append(strName);
+      if (!strValue.empty())
+        m_strDefines.append(" ").append(strValue);
+      m_strDefines.append("\n");
+    }
+
+    /**
+     * \brief Sets the function loading files, for instance from a CShaderPackReader. It must be thread safe.
+     */
+    void SetLoader(Loader loader) { m_loader = std::move(loader); }
+
+    /**
+     * \brief Queues a source to prepare.
+     *
+     * \param strName The path of the source, given to the loader.
+     * \param nStage The OpenGL type of the shader, given back with the prepared source.
+     */
+    void Submit(std::string strName, std::uint32_t nStage)
+    {
+      ++m_nPending;
+      m_pool.Submit([this, strName = std::move(strName), nStage]() {
+        SPreparedSource source;
+        try
+        {
+          source = prepare(strName, nStage);
+        }
+        catch (const std::exception& e)
+        {
+          //A throwing loader must not lose the source, nor leave it pending
+          source.strName = strName;
+          source.nStage = nStage;
+          source.bOk = false;
+          source.strError = std::string("Error: cannot prepare \"") + strName + "\": " + e.what();
+        }
+        {
+          std::lock_guard<std::mutex> lock(m_readyMutex);
+          m_ready.push_back(std::move(source));
+        }
+        --m_nPending;
+        });
+    }
+
+    /**
+     * \brief Takes prepared sources without waiting, in the order they were prepared.
+     *
+     * \param nMaxCount The maximum number of sources to take, to bound the work of the OpenGL thread.
+     */
+    std::vector<SPreparedSource> TakeReady(std::size_t nMaxCount = SIZE_MAX)
+    {
+      std::vector<SPreparedSource> batch;
+      std::lock_guard<std::mutex> lock(m_readyMutex);
+      if (nMaxCount >= m_ready.size())
+        batch.swap(m_ready);
+      else
+      {
+        batch.assign(std::make_move_iterator(m_ready.begin()), std::make_move_iterator(m_ready.begin() + nMaxCount));
+        m_ready.erase(m_ready.begin(), m_ready.begin() + nMaxCount);
+      }
+      return batch;
+    }
+
+    /**
+     * \brief Waits until all submitted sources are prepared.
+     */
+    void Wait() { m_pool.WaitIdle(); }
+
+    /**
+     * \brief Gets the number of submitted sources which are not prepared yet.
+     */
+    std::size_t GetPendingCount() const { return m_nPending; }
+
+    /**
+     * \brief Gets the number of worker threads.
+     */
+    std::size_t GetThreadCount() const { return m_pool.GetThreadCount(); }
+
+  private:
+    /**
+     * \brief Loads, expands and hashes a source. Called by worker threads.
+     */
+    SPreparedSource prepare(const std::string& strName, std::uint32_t nStage) const
+    {
+      SPreparedSource source;
+      source.strName = strName;
+      source.nStage = nStage;
+      std::string strExpanded;
+      source.bOk = expand(std::filesystem::path(strName), {}, strExpanded, source.files, source.strError);
+      if (!source.bOk)
+        return source;
+
+      //Defines must follow the #version directive, which must be the first one of a GLSL source
+      const std::size_t nInsert = findEndOfVersion(strExpanded);
+      source.strSource.reserve(strExpanded.size() + m_strDefines.size() + 16);
+      source.strSource.append(strExpanded, 0, nInsert);
+      if (nInsert > 0 && source.strSource.back() != '\n')
+        source.strSource += '\n';
+      if (!m_strDefines.empty())
+      {
+        //The line following the #version directive is the first one after the defines
+        const std::size_t nLine = std::count(strExpanded.begin(), strExpanded.begin() + nInsert, '\n') + 1;
+        source.strSource.append(m_strDefines).append("#line ").append(std::to_string(nLine)).append(" 0\n");
+      }
+      source.strSource.append(strExpanded, nInsert, std::string::npos);
+      source.nHash = Fnv1a64(source.strSource);
+      return source;
+    }
+
+    /**
+     * \brief Finds the end of the \c \#version directive, skipping the comments and blank lines preceding it.
+     *
+     * \return The position following the line of the directive, or 0 if the source has no leading \c \#version.
+     */
+    static std::size_t findEndOfVersion(std::string_view strSource)
+    {
+      std::size_t nPos = 0;
+      for (;;)
+      {
+        nPos = strSource.find_first_not_of(" \t\r\n", nPos);
+        if (nPos == std::string_view::npos)
+          return 0;
+        if (strSource.compare(nPos, 2, "//") == 0)
+          nPos = strSource.find('\n', nPos);
+        else if (strSource.compare(nPos, 2, "/*") == 0)
+        {
+          nPos = strSource.find("*/", nPos + 2);
+          if (nPos != std::string_view::npos)
+            nPos += 2;
+        }
+        else
+          break;
+        if (nPos == std::string_view::npos)
+          return 0;
+      }
+      if (strSource[nPos] != '#')
+        return 0;
+      const std::size_t nDirective = strSource.find_first_not_of(" \t", nPos + 1);
+      if (nDirective == std::string_view::npos || strSource.compare(nDirective, 7, "version") != 0)
+        return 0;
+      const std::size_t nEndOfLine = strSource.find('\n', nDirective);
+      return nEndOfLine == std::string_view::npos ? strSource.size() : nEndOfLine + 1;
+    }
+
+    /**
+     * \brief Loads a file and appends it to \c strOutput, replacing its \c \#include directives by their files.
+     *
+     * \param path The path of the file, relative to \c directory.
+     * \param directory The directory of the including file, empty for the submitted file.
+     * \param included The files already included, which are skipped. The index of a file is its source string number.
+     * \return \c false if a file cannot be loaded.
+     */
+    bool expand(const std::filesystem::path& path, const std::filesystem::path& directory, std::string& strOutput,
+      std::vector<std::string>& included, std::string& strError) const
+    {
+      std::optional<std::string> strFile;
+      std::string strPath;
+      //Search the directory of the including file, then include directories
+      for (std::size_t i = 0; !strFile && i <= m_includeDirectories.size(); ++i)
+      {
+        strPath = ((i == 0 ? directory : m_includeDirectories[i - 1]) / path).lexically_normal().generic_string();
+        if (std::find(included.begin(), included.end(), strPath) != included.end())
+          return true;
+        strFile = m_loader(strPath);
+      }
+      if (!strFile)
+      {
+        strError = "Error: cannot load \"" + path.generic_string() + "\"" + (directory.empty() ? "" : " included from \"" + directory.generic_string() + "\"");
+        return false;
+      }
+      const std::size_t nSource = included.size();
+      included.push_back(strPath);
+      if (nSource > 0)
+        strOutput.append("#line 1 ").append(std::to_string(nSource)).append("\n");
+
+      const std::filesystem::path fileDirectory = std::filesystem::path(strPath).parent_path();
+      std::string_view strRemaining = *strFile;
+      for (std::size_t nLine = 1; !strRemaining.empty(); ++nLine)
+      {
+        const std::size_t nEndOfLine = strRemaining.find('\n');
+        const std::string_view strLine = strRemaining.substr(0, nEndOfLine == std::string_view::npos ? strRemaining.size() : nEndOfLine + 1);
+        strRemaining.remove_prefix(strLine.size());
+
+        const std::size_t nDirective = strLine.find_first_not_of(" \t");
+        if (nDirective != std::string_view::npos && strLine.compare(nDirective, 8, "#include") == 0)
+        {
+          const std::size_t nOpen = strLine.find('"', nDirective + 8);
+          const std::size_t nClose = nOpen == std::string_view::npos ? nOpen : strLine.find('"', nOpen + 1);
+          if (nClose != std::string_view::npos)
+          {
+            const std::size_t nIncluded = included.size();
+            if (!expand(std::filesystem::path(strLine.substr(nOpen + 1, nClose - nOpen - 1)), fileDirectory, strOutput, included, strError))
+              return false;
+            if (included.size() == nIncluded)
+            {
+              //A file already included keeps the line of its directive, to keep line numbers
+              strOutput += '\n';
+              continue;
+            }
+            if (!strOutput.empty() && strOutput.back() != '\n')
+              strOutput += '\n';
+            strOutput.append("#line ").append(std::to_string(nLine + 1)).append(" ").append(std::to_string(nSource)).append("\n");
+            continue;
+          }
+        }
+        strOutput.append(strLine);
+      }
+      return true;
+    }
+  };
+
+}
@@ -0,0 +1,180 @@
+/*****************************************************************//**
+ * \file      StateCache.h
+ * \brief     Declaration of CStateCache class
+ *
+ * \author    Benjamin ALBOUY-KISSI
+ * \date      2022
+ * \copyright GNU Lesser Public License v3
+ *********************************************************************/
+#pragma once
+#include "GLUtils.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace GLShaderPP {
+
+  /**
+   * \brief Tracks the OpenGL state changed by GLShaderPP to skip redundant calls.
+   *
+   * There is one CStateCache per thread, returned by Current(). Since an OpenGL context is current on
+   * a single thread at a time, it tracks the state of the context current on this thread. CShaderProgram::Use()
+   * goes through it, so that binding an already bound program does not call \c glUseProgram() again. It also
+   * keeps the OpenGL version and some extensions of the context, so that dependent code paths query them only once.
+   *
+   * The cache must be invalidated by Invalidate() when its assumptions may be wrong:
+   * - when another OpenGL context is made current on this thread,
+   * - when the bound program is changed by raw OpenGL calls instead of CShaderProgram::Use().
+   *
+   * Program names are shared by all contexts of a share group, so a program deleted on one thread may have its
+   * name reused by a new program while another thread still caches it as bound. To prevent this thread from
+   * skipping the bind of the new program, ForgetProgram() bumps a process wide release epoch, and each cache
+   * trusts its bound program only if no program has been released since it was bound.
+   */
+  class CStateCache
+  {
+    static constexpr GLuint unknownProgram = ~GLuint(0); //!< Value of m_nBoundProgram when the bound program is unknown
+
+    static inline std::atomic<std::uint64_t> s_nReleaseEpoch{ 0 }; //!< Incremented each time a program is released, by any thread
+
+    GLuint m_nBoundProgram = unknownProgram;   //!< The program currently bound in the current context
+    std::uint64_t m_nBoundEpoch = 0;           //!< s_nReleaseEpoch when m_nBoundProgram was bound
+    std::size_t m_nBindsIssued = 0;            //!< Number of \c glUseProgram() calls issued
+    std::size_t m_nBindsSkipped = 0;           //!< Number of \c glUseProgram() calls skipped
+    std::uint64_t m_nBindSerial = 0;           //!< Incremented each time the bound program may have been rebound
+    GLint m_nMajorVersion = 0;                 //!< OpenGL major version of the current context, 0 if not queried yet
+    GLint m_nMinorVersion = 0;                 //!< OpenGL minor version of the current context
+    signed char m_nSeparateShaderObjects = -1; //!< 1 if \c GL_ARB_separate_shader_objects is exposed, 0 if not, -1 if not queried yet
+
+    CStateCache() = default;
+    CStateCache(const CStateCache&) = delete;
+    CStateCache& operator=(const CStateCache&) = delete;
+
+  public:
+    /**
+     * \brief Returns the state cache of the calling thread.
+     */
+    static CStateCache& Current()
+    {
+      thread_local CStateCache cache;
+      return cache;
+    }
+
+    /**
+     * \brief Binds a program, unless it is already bound.
+     *
+     * \param nProgram The OpenGL identifier of the program to bind.
+     * \return \c true if \c glUseProgram() has been called.
+     */
+    bool UseProgram(GLuint nProgram)
+    {
+      if (IsProgramBound(nProgram))
+      {
+        ++m_nBindsSkipped;
+        return false;
+      }
+      glUseProgram(nProgram);
+      m_nBoundProgram = nProgram;
+      m_nBoundEpoch = s_nReleaseEpoch.load(std::memory_order_acquire);
+      ++m_nBindsIssued;
+      ++m_nBindSerial;
+      return true;
+    }
+
+    /**
+     * \brief Forgets the program to be deleted if it is the bound one.
+     *
+     * The release epoch is bumped, so that the caches of the other threads do not trust their bound program
+     * anymore, since it may be this one.
+     *
+     * \param nProgram The OpenGL identifier of the program to be deleted.
+     */
+    void ForgetProgram(GLuint nProgram)
+    {
+      s_nReleaseEpoch.fetch_add(1, std::memory_order_release);
+      if (m_nBoundProgram == nProgram)
+      {
+        m_nBoundProgram = unknownProgram;
+        ++m_nBindSerial;
+      }
+    }
+
+    /**
+     * \brief Forgets every tracked state, so that the next bind is always issued and the OpenGL version and
+     * extensions are queried again.
+     */
+    void Invalidate()
+    {
+      m_nBoundProgram = unknownProgram;
+      ++m_nBindSerial;
+      m_nMajorVersion = m_nMinorVersion = 0;
+      m_nSeparateShaderObjects = -1;
+    }
+
+    /**
+     * \brief Tells if the OpenGL version of the current context is at least a given version.
+     *
+     * The version is queried once, then kept until Invalidate().
+     *
+     * \param nMajor The required major version.
+     * \param nMinor The required minor version.
+     */
+    bool IsGLVersionAtLeast(GLint nMajor, GLint nMinor)
+    {
+      if (m_nMajorVersion == 0)
+      {
+        glGetIntegerv(GL_MAJOR_VERSION, &m_nMajorVersion);
+        glGetIntegerv(GL_MINOR_VERSION, &m_nMinorVersion);
+      }
+      return m_nMajorVersion > nMajor || (m_nMajorVersion == nMajor && m_nMinorVersion >= nMinor);
+    }
+
+    /**
+     * \brief Tells if the current context exposes \c GL_ARB_separate_shader_objects.
+     *
+     * The extension list is scanned once, then the answer is kept until Invalidate().
+     */
+    bool IsSeparateShaderObjectsSupported()
+    {
+      if (m_nSeparateShaderObjects < 0)
+        m_nSeparateShaderObjects = IsExtensionSupported("GL_ARB_separate_shader_objects") ? 1 : 0;
+      return m_nSeparateShaderObjects > 0;
+    }
+
+    /**
+     * \brief Returns a number which changes each time \c glUseProgram() may have been called.
+     * 
+     * OpenGL resets some per program state, such as subroutine uniforms, each time a program is bound. 
+     * Comparing this number with a previously saved value tells if such a state must be set again.
+     */
+    std::uint64_t GetBindSerial() const { return m_nBindSerial; }
+
+    /**
+     * \brief Tells if a program is known to be bound, and no program has been released since it was bound.
+     */
+    bool IsProgramBound(GLuint nProgram) const
+    {
+      return m_nBoundProgram == nProgram && m_nBoundEpoch == s_nReleaseEpoch.load(std::memory_order_acquire);
+    }
+
+    /**
+     * \brief Returns the number of \c glUseProgram() calls issued since the last ResetCounters().
+     */
+    std::size_t GetBindsIssued() const { return m_nBindsIssued; }
+
+    /**
+     * \brief Returns the number of redundant \c glUseProgram() calls skipped since the last ResetCounters().
+     */
+    std::size_t GetBindsSkipped() const { return m_nBindsSkipped; }
+
+    /**
+     * \brief Resets the counters of issued and skipped binds.
+     */
+    void ResetCounters()
+    {
+      m_nBindsIssued = 0;
+      m_nBindsSkipped = 0;
+    }
+  };
+
+}
@@ -0,0 +1,234 @@
+/*****************************************************************//**
+ * \file      Subroutines.h
+ * \brief     Declaration of CSubroutineSelector class
+ *
+ * \author    Benjamin ALBOUY-KISSI
+ * \date      2022
+ * \copyright GNU Lesser Public License v3
+ *********************************************************************/
+#pragma once
+#include "ShaderProgram.h"
+#include <algorithm>
+#include <unordered_map>
+
+namespace GLShaderPP {
+
+  /**
+   * \brief Selects shader subroutines of a linked shader program.
+   *
+   * Shader subroutines (OpenGL 4.0) let a single program switch between several implementations of a
+   * function without being compiled, linked and bound again. A CSubroutineSelector reflects the subroutine
+   * uniforms and the subroutines of each stage of a linked program once, at construction. Then, Select()
+   * changes the implementation used by a subroutine uniform, and Use() binds the program and uploads, with
+   * a single \c glUniformSubroutinesuiv() call per stage, the selections which are not already set.
+   *
+   * OpenGL forgets subroutine selections each time a program is bound. Use() knows it thanks to
+   * CStateCache::GetBindSerial() and uploads every stage again only in this case. Several selectors may share
+   * the same program: each thread remembers which selector uploaded the selections of the bound program, so
+   * that a selector uploads every stage again when another one has overwritten its selections.
+   *
+   * Selecting by name needs hash table lookups. For hot paths, resolve names once with GetUniformLocation()
+   * and GetSubroutineIndex() then use Select(GLenum, GLint, GLuint).
+   */
+  class CSubroutineSelector
+  {
+    //!\brief Subroutine uniforms and subroutines of one stage
+    struct SStage
+    {
+      GLenum eStage;                                         //!< OpenGL type of the stage
+      std::unordered_map<std::string, GLint> uniforms;       //!< Locations of subroutine uniforms, by name
+      std::unordered_map<std::string, GLuint> subroutines;   //!< Indices of subroutines, by name
+      std::vector<GLuint> indices;                           //!< Selected subroutine index, by subroutine uniform location
+      std::vector<std::vector<GLuint>> compatible;           //!< Sorted indices of compatible subroutines, by subroutine uniform location
+      bool bDirty = true;                                    //!< Whether indices must be uploaded
+    };
+
+    //!\brief The selector which uploaded the selections of the program bound on this thread
+    static inline thread_local const CSubroutineSelector* s_pUploader = nullptr;
+
+    const CShaderProgramBase& m_program;             //!< The program whose subroutines are selected
+    std::vector<SStage> m_stages;                    //!< Stages having subroutine uniforms
+    std::uint64_t m_nBindSerial = 0;                 //!< CStateCache::GetBindSerial() at the last upload
+    std::size_t m_nUploads = 0;                      //!< Number of \c glUniformSubroutinesuiv() calls issued
+
+  public:
+    /**
+     * \brief Reflects subroutine uniforms and subroutines of a linked program.
+     *
+     * Each subroutine uniform initially selects the first compatible subroutine.
+     *
+     * \param program The program, which must be linked and outlive this selector.
+     */
+    explicit CSubroutineSelector(const CShaderProgramBase& program) : m_program(program)
+    {
+      if (program.GetLinkingStatus() != CShaderProgramBase::LinkingStatus::linkingOk)
+        return;
+      for (GLenum eStage : { GL_VERTEX_SHADER, GL_TESS_CONTROL_SHADER, GL_TESS_EVALUATION_SHADER, GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER, GL_COMPUTE_SHADER })
+        if (program.HasStage(eStage))
+          reflectStage(eStage);
+    }
+
+    /**
+     * \brief Returns the location of a subroutine uniform, or -1 if there is no such uniform.
+     */
+    GLint GetUniformLocation(GLenum eStage, const std::string& strUniform) const
+    {
+      const SStage* pStage = findStage(eStage);
+      if (!pStage)
+        return -1;
+      auto it = pStage->uniforms.find(strUniform);
+      return it != pStage->uniforms.end() ? it->second : -1;
+    }
+
+    /**
+     * \brief Returns the index of a subroutine, or \c GL_INVALID_INDEX if there is no such subroutine.
+     */
+    GLuint GetSubroutineIndex(GLenum eStage, const std::string& strSubroutine) const
+    {
+      const SStage* pStage = findStage(eStage);
+      if (!pStage)
+        return GL_INVALID_INDEX;
+      auto it = pStage->subroutines.find(strSubroutine);
+      return it != pStage->subroutines.end() ? it->second : GL_INVALID_INDEX;
+    }
+
+    /**
+     * \brief Selects the subroutine used by a subroutine uniform.
+     *
+     * \param eStage The OpenGL type of the stage.
+     * \param strUniform The name of the subroutine uniform.
+     * \param strSubroutine The name of the subroutine to use.
+     * \return \c false if the stage, uniform or subroutine does not exist, or if the subroutine is not compatible
+     * with the uniform.
+     */
+    bool Select(GLenum eStage, const std::string& strUniform, const std::string& strSubroutine)
+    {
+      return Select(eStage, GetUniformLocation(eStage, strUniform), GetSubroutineIndex(eStage, strSubroutine));
+    }
+
+    /**
+     * \brief Selects the subroutine used by a subroutine uniform.
+     *
+     * \param eStage The OpenGL type of the stage.
+     * \param nLocation The location of the subroutine uniform, from GetUniformLocation().
+     * \param nSubroutine The index of the subroutine to use, from GetSubroutineIndex().
+     * \return \c false if the stage, location or subroutine does not exist, or if the subroutine is not compatible
+     * with the uniform (\c GL_COMPATIBLE_SUBROUTINES).
+     */
+    bool Select(GLenum eStage, GLint nLocation, GLuint nSubroutine)
+    {
+      SStage* pStage = findStage(eStage);
+      if (!pStage || nLocation < 0 || static_cast<std::size_t>(nLocation) >= pStage->indices.size() || nSubroutine == GL_INVALID_INDEX)
+        return false;
+      const std::vector<GLuint>& compatible = pStage->compatible[nLocation];
+      if (!std::binary_search(compatible.begin(), compatible.end(), nSubroutine))
+        return false;
+      if (pStage->indices[nLocation] != nSubroutine)
+      {
+        pStage->indices[nLocation] = nSubroutine;
+        pStage->bDirty = true;
+      }
+      return true;
+    }
+
+    /**
+     * \brief Binds the program and uploads changed selections.
+     */
+    void Use()
+    {
+      CStateCache& cache = CStateCache::Current();
+      cache.UseProgram(m_program.GetProgramId());
+      const bool bRebound = cache.GetBindSerial() != m_nBindSerial || s_pUploader != this;
+      for (SStage& stage : m_stages)
+      {
+        if (stage.bDirty || bRebound)
+        {
+          glUniformSubroutinesuiv(stage.eStage, static_cast<GLsizei>(stage.indices.size()), stage.indices.data());
+          stage.bDirty = false;
+          ++m_nUploads;
+        }
+      }
+      m_nBindSerial = cache.GetBindSerial();
+      s_pUploader = this;
+    }
+
+    /**
+     * \brief Returns the number of \c glUniformSubroutinesuiv() calls issued by Use().
+     */
+    std::size_t GetUploadCount() const { return m_nUploads; }
+
+  private:
+    /**
+     * \brief Returns the reflected stage of a given type, or \c nullptr.
+     */
+    SStage* findStage(GLenum eStage)
+    {
+      for (SStage& stage : m_stages)
+        if (stage.eStage == eStage)
+          return &stage;
+      return nullptr;
+    }
+
+    /**
+     * \brief Returns the reflected stage of a given type, or \c nullptr.
+     */
+    const SStage* findStage(GLenum eStage) const { return const_cast<CSubroutineSelector*>(this)->findStage(eStage); }
+
+    /**
+     * \brief Reflects subroutine uniforms and subroutines of a stage.
+     */
+    void reflectStage(GLenum eStage)
+    {
+      const GLuint nProgram = m_program.GetProgramId();
+      GLint nLocations = 0, nUniforms = 0, nSubroutines = 0, nMaxLength = 0, nLength = 0;
+      glGetProgramStageiv(nProgram, eStage, GL_ACTIVE_SUBROUTINE_UNIFORM_LOCATIONS, &nLocations);
+      if (nLocations <= 0)
+        return;
+
+      SStage stage{ eStage, {}, {}, {}, {}, true };
+      stage.indices.resize(nLocations, GL_INVALID_INDEX);
+      stage.compatible.resize(nLocations);
+      std::string strName;
+
+      glGetProgramStageiv(nProgram, eStage, GL_ACTIVE_SUBROUTINES, &nSubroutines);
+      glGetProgramStageiv(nProgram, eStage, GL_ACTIVE_SUBROUTINE_MAX_LENGTH, &nMaxLength);
+      strName.resize(nMaxLength);
+      for (GLint i = 0; i < nSubroutines; ++i)
+      {
+        glGetActiveSubroutineName(nProgram, eStage, i, nMaxLength, &nLength, &strName.front());
+        stage.subroutines.emplace(strName.substr(0, nLength), i);
+      }
+
+      glGetProgramStageiv(nProgram, eStage, GL_ACTIVE_SUBROUTINE_UNIFORMS, &nUniforms);
+      glGetProgramStageiv(nProgram, eStage, GL_ACTIVE_SUBROUTINE_UNIFORM_MAX_LENGTH, &nMaxLength);
+      strName.resize(nMaxLength);
+      for (GLint i = 0; i < nUniforms; ++i)
+      {
+        glGetActiveSubroutineUniformName(nProgram, eStage, i, nMaxLength, &nLength, &strName.front());
+        std::string strUniform = strName.substr(0, nLength);
+        GLint nLocation = glGetSubroutineUniformLocation(nProgram, eStage, strUniform.c_str());
+
+        //Arrays of subroutine uniforms use consecutive locations, select the first compatible subroutine for each
+        GLint nSize = 1, nCompatible = 0;
+        glGetActiveSubroutineUniformiv(nProgram, eStage, i, GL_UNIFORM_SIZE, &nSize);
+        glGetActiveSubroutineUniformiv(nProgram, eStage, i, GL_NUM_COMPATIBLE_SUBROUTINES, &nCompatible);
+        std::vector<GLint> compatible(nCompatible);
+        if (nCompatible > 0)
+          glGetActiveSubroutineUniformiv(nProgram, eStage, i, GL_COMPATIBLE_SUBROUTINES, compatible.data());
+        std::vector<GLuint> sorted(compatible.begin(), compatible.end());
+        std::sort(sorted.begin(), sorted.end());
+        for (GLint j = 0; j < nSize && nCompatible > 0; ++j)
+          if (nLocation >= 0 && nLocation + j < nLocations)
+          {
+            stage.indices[nLocation + j] = static_cast<GLuint>(compatible.front());
+            stage.compatible[nLocation + j] = sorted;
+          }
+
+        stage.uniforms.emplace(std::move(strUniform), nLocation);
+      }
+
+      m_stages.push_back(std::move(stage));
+    }
+  };
+
+}
@@ -0,0 +1,208 @@
+/*****************************************************************//**
+ * \file      ThreadPool.h
+ * \brief     Declaration of CThreadPool class
+ *
+ * This header does not need OpenGL.
+ *
+ * \author    Benjamin ALBOUY-KISSI
+ * \date      2022
+ * \copyright GNU Lesser Public License v3
+ *********************************************************************/
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace GLShaderPP {
+
+  /**
+   * \brief A work stealing pool of threads running CPU only tasks.
+   *
+   * Each worker thread has its own task queue. Tasks submitted by a worker go to its own queue, the others
+   * are spread over the queues in turn. A worker runs the most recent task of its queue first, and when its
+   * queue is empty, it steals the oldest task of another queue, so that no worker is idle while some work is
+   * queued.
+   *
+   * Tasks must not call OpenGL since worker threads have no OpenGL context. The result of a task, or the exception
+   * it throws, is given back by the \c std::future returned by Submit().
+   */
+  class CThreadPool
+  {
+    //!\brief The task queue of a worker thread
+    struct SQueue
+    {
+      std::mutex mutex;                         //!< Protects \c tasks
+      std::deque<std::function<void()>> tasks;  //!< Queued tasks, the most recent at the back
+    };
+
+    std::vector<std::unique_ptr<SQueue>> m_queues;  //!< Task queues, one per worker thread
+    std::atomic<std::size_t> m_nQueued{ 0 };        //!< Number of queued tasks
+    std::atomic<std::size_t> m_nPending{ 0 };       //!< Number of queued or running tasks
+    std::atomic<std::size_t> m_nNextQueue{ 0 };     //!< Queue receiving the next task submitted from outside the pool
+    std::mutex m_sleepMutex;                        //!< Protects \c m_bStop, and orders wake ups with sleeps
+    std::condition_variable m_wakeUp;               //!< Signaled when a task is queued or the pool stops
+    std::condition_variable m_idle;                 //!< Signaled when the last pending task is finished
+    bool m_bStop = false;                           //!< Tells worker threads to exit once queues are empty
+    std::vector<std::thread> m_threads;             //!< Worker threads
+
+    //!\brief The pool and the queue index of the current worker thread, if any
+    static inline thread_local std::pair<const CThreadPool*, std::size_t> s_worker{ nullptr, 0 };
+
+    CThreadPool(const CThreadPool&) = delete;
+    CThreadPool& operator=(const CThreadPool&) = delete;
+
+  public:
+    /**
+     * \brief Starts the worker threads.
+     *
+     * \param nThreads The number of worker threads. 0 means one per hardware thread.
+     */
+    explicit CThreadPool(std::size_t nThreads = 0)
+    {
+      if (nThreads == 0)
+        nThreads = std::max(1u, std::thread::hardware_concurrency());
+      for (std::size_t i = 0; i < nThreads; ++i)
+        m_queues.push_back(std::make_unique<SQueue>());
+      for (std::size_t i = 0; i < nThreads; ++i)
+        m_threads.emplace_back([this, i]() { run(i); });
+    }
+
+    /**
+     * \brief Runs the queued tasks, then stops the worker threads.
+     */
+    ~CThreadPool()
+    {
+      {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_bStop = true;
+      }
+      m_wakeUp.notify_all();
+      for (std::thread& thread : m_threads)
+        thread.join();
+    }
+
+    /**
+     * \brief Queues a task.
+     *
+     * It may be called from any thread, including from a task of this pool.
+     *
+     * \param task A callable object taking no argument.
+     * \return The future result of the task. An exception thrown by the task is stored in it, and rethrown by
+     * \c std::future::get(), instead of terminating the worker thread.
+     */
+    template<typename Task>
+    std::future<std::invoke_result_t<std::decay_t<Task>&>> Submit(Task&& task)
+    {
+      using Result = std::invoke_result_t<std::decay_t<Task>&>;
+      //std::function needs copyable tasks, so the packaged task is shared
+      auto pTask = std::make_shared<std::packaged_task<Result()>>(std::forward<Task>(task));
+      std::future<Result> result = pTask->get_future();
+      push([pTask]() { (*pTask)(); });
+      return result;
+    }
+
+    /**
+     * \brief Waits until all queued tasks are finished. It must not be called from a task of this pool.
+     */
+    void WaitIdle()
+    {
+      std::unique_lock<std::mutex> lock(m_sleepMutex);
+      m_idle.wait(lock, [this]() { return m_nPending == 0; });
+    }
+
+    /**
+     * \brief Gets the number of queued or running tasks.
+     */
+    std::size_t GetPendingCount() const { return m_nPending; }
+
+    /**
+     * \brief Gets the number of worker threads.
+     */
+    std::size_t GetThreadCount() const { return m_threads.size(); }
+
+  private:
+    /**
+     * \brief Queues a task which does not throw.
+     */
+    void push(std::function<void()> task)
+    {
+      const std::size_t nQueue = s_worker.first == this ? s_worker.second : m_nNextQueue++ % m_queues.size();
+      ++m_nPending;
+      {
+        std::lock_guard<std::mutex> lock(m_queues[nQueue]->mutex);
+        m_queues[nQueue]->tasks.push_back(std::move(task));
+        ++m_nQueued;
+      }
+      //Taking the mutex ensures a worker thread cannot miss the notification between its check and its wait
+      {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+      }
+      m_wakeUp.notify_one();
+    }
+
+    /**
+     * \brief The loop of a worker thread.
+     */
+    void run(std::size_t nIndex)
+    {
+      s_worker = { this, nIndex };
+      for (;;)
+      {
+        std::function<void()> task;
+        if (pop(nIndex, task))
+        {
+          task();
+          if (--m_nPending == 0)
+          {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            m_idle.notify_all();
+          }
+          continue;
+        }
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_wakeUp.wait(lock, [this]() { return m_bStop || m_nQueued > 0; });
+        if (m_bStop && m_nQueued == 0)
+          return;
+      }
+    }
+
+    /**
+     * \brief Takes the most recent task of a queue, or steals the oldest task of another one.
+     *
+     * \return \c false if all queues are empty.
+     */
+    bool pop(std::size_t nIndex, std::function<void()>& task)
+    {
+      for (std::size_t i = 0; i < m_queues.size(); ++i)
+      {
+        SQueue& queue = *m_queues[(nIndex + i) % m_queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+          continue;
+        if (i == 0)
+        {
+          task = std::move(queue.tasks.back());
+          queue.tasks.pop_back();
+        }
+        else
+        {
+          task = std::move(queue.tasks.front());
+          queue.tasks.pop_front();
+        }
+        --m_nQueued;
+        return true;
+      }
+      return false;
+    }
+  };
+
+}
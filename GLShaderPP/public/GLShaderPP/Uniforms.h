@@ -0,0 +1,350 @@
+/*****************************************************************//**
+ * \file      Uniforms.h
+ * \brief     Declaration of uniform setters and CUniformBatch class, definition of CShaderProgramBase uniform setters
+ *
+ * \author    Benjamin ALBOUY-KISSI
+ * \date      2022
+ * \copyright GNU Lesser Public License v3
+ *********************************************************************/
+#pragma once
+#include "ShaderProgram.h"
+#include "StateCache.h"
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace GLShaderPP {
+
+  /**
+   * \brief Tells if uniforms of a program can be set without binding it.
+   *
+   * \c glProgramUniform*() functions are core since OpenGL 4.1, and are provided to older contexts by
+   * \c GL_ARB_separate_shader_objects. The answer is about the context current on the calling thread, and is kept
+   * by its CStateCache until CStateCache::Invalidate(), which must be called when another context is made current.
+   */
+  inline bool IsProgramUniformSupported() {
+    CStateCache& cache = CStateCache::Current();
+    return cache.IsGLVersionAtLeast(4, 1) || cache.IsSeparateShaderObjectsSupported();
+  }
+
+  /**
+   * \brief Describes a C++ type which can be given as a uniform value.
+   *
+   * Supported types are \c GLfloat, \c GLint and \c GLuint (\c float, \c int and \c uint GLSL types), \c std::array
+   * of 2, 3 or 4 of them (\c vec, \c ivec and \c uvec GLSL types), and \c std::array of 9 or 16 \c GLfloat in column
+   * major order (\c mat3 and \c mat4 GLSL types).
+   */
+  template<typename T>
+  struct SUniformType;
+
+  //!\brief Description of scalar uniform types
+  template<typename T>
+  struct SUniformScalarType
+  {
+    using Element = T;
+    static constexpr std::size_t nComponents = 1;
+    static constexpr bool bMatrix = false;
+  };
+  template<> struct SUniformType<GLfloat> : SUniformScalarType<GLfloat> {};
+  template<> struct SUniformType<GLint> : SUniformScalarType<GLint> {};
+  template<> struct SUniformType<GLuint> : SUniformScalarType<GLuint> {};
+
+  template<typename T, std::size_t N>
+  struct SUniformType<std::array<T, N>>
+  {
+    static_assert(std::is_same_v<T, GLfloat> || std::is_same_v<T, GLint> || std::is_same_v<T, GLuint>, "Uniform components must be GLfloat, GLint or GLuint");
+    static_assert((N >= 2 && N <= 4) || (std::is_same_v<T, GLfloat> && (N == 9 || N == 16)), "Uniform arrays must be vectors of 2 to 4 components, or 3x3 or 4x4 matrices");
+    static_assert(sizeof(std::array<T, N>) == N * sizeof(T), "Uniform arrays must be tightly packed");
+    using Element = T;
+    static constexpr std::size_t nComponents = N;
+    static constexpr bool bMatrix = N > 4;
+  };
+
+  /**
+   * \brief Binds a program to set its uniforms with \c glUniform*(), and binds back the previous program when destroyed.
+   *
+   * Both binds go through the CStateCache of the calling thread. If the program is already known to be bound,
+   * nothing is done. Otherwise, the previous program is queried with \c GL_CURRENT_PROGRAM, so that it is restored
+   * even if it was bound by raw OpenGL calls.
+   */
+  class CScopedProgramBinding
+  {
+    GLuint m_nPrevious; //!< The program to bind back
+
+    CScopedProgramBinding(const CScopedProgramBinding&) = delete;
+    CScopedProgramBinding& operator=(const CScopedProgramBinding&) = delete;
+
+  public:
+    /**
+     * \brief Binds a program.
+     *
+     * \param nProgram The OpenGL identifier of the program.
+     */
+    explicit CScopedProgramBinding(GLuint nProgram) : m_nPrevious(nProgram)
+    {
+      CStateCache& cache = CStateCache::Current();
+      if (cache.IsProgramBound(nProgram))
+        return;
+      GLint nPrevious = 0;
+      glGetIntegerv(GL_CURRENT_PROGRAM, &nPrevious);
+      m_nPrevious = static_cast<GLuint>(nPrevious);
+      cache.UseProgram(nProgram);
+    }
+
+    /**
+     * \brief Binds back the previous program.
+     */
+    ~CScopedProgramBinding() { CStateCache::Current().UseProgram(m_nPrevious); }
+  };
+
+  /**
+   * \brief Sets uniform values of the bound program, with \c glUniform*().
+   *
+   * \param nLocation The location of the uniform. Like OpenGL, a location of -1 is silently ignored.
+   * \param nCount The number of values, more than one for an array uniform.
+   * \param pValues The values, of a type supported by SUniformType.
+   */
+  template<typename T>
+  void SetBoundProgramUniform(GLint nLocation, GLsizei nCount, const T* pValues)
+  {
+    using Type = SUniformType<T>;
+    using Element = typename Type::Element;
+    const Element* p = reinterpret_cast<const Element*>(pValues);
+    constexpr std::size_t N = Type::nComponents;
+    if constexpr (Type::bMatrix)
+    {
+      if constexpr (N == 9) glUniformMatrix3fv(nLocation, nCount, GL_FALSE, p);
+      else glUniformMatrix4fv(nLocation, nCount, GL_FALSE, p);
+    }
+    else if constexpr (std::is_same_v<Element, GLfloat>)
+    {
+      if constexpr (N == 1) glUniform1fv(nLocation, nCount, p);
+      else if constexpr (N == 2) glUniform2fv(nLocation, nCount, p);
+      else if constexpr (N == 3) glUniform3fv(nLocation, nCount, p);
+      else glUniform4fv(nLocation, nCount, p);
+    }
+    else if constexpr (std::is_same_v<Element, GLint>)
+    {
+      if constexpr (N == 1) glUniform1iv(nLocation, nCount, p);
+      else if constexpr (N == 2) glUniform2iv(nLocation, nCount, p);
+      else if constexpr (N == 3) glUniform3iv(nLocation, nCount, p);
+      else glUniform4iv(nLocation, nCount, p);
+    }
+    else
+    {
+      if constexpr (N == 1) glUniform1uiv(nLocation, nCount, p);
+      else if constexpr (N == 2) glUniform2uiv(nLocation, nCount, p);
+      else if constexpr (N == 3) glUniform3uiv(nLocation, nCount, p);
+      else glUniform4uiv(nLocation, nCount, p);
+    }
+  }
+
+  /**
+   * \brief Sets uniform values of a program, without binding it if possible.
+   *
+   * If IsProgramUniformSupported() is \c true, \c glProgramUniform*() is called and the bound program is left
+   * unchanged. Otherwise, the program is bound by a CScopedProgramBinding, \c glUniform*() is called, then the
+   * previous program is bound back.
+   *
+   * \param nProgram The OpenGL identifier of the program.
+   * \param nLocation The location of the uniform. Like OpenGL, a location of -1 is silently ignored.
+   * \param nCount The number of values, more than one for an array uniform.
+   * \param pValues The values, of a type supported by SUniformType.
+   */
+  template<typename T>
+  void SetProgramUniform(GLuint nProgram, GLint nLocation, GLsizei nCount, const T* pValues)
+  {
+    using Type = SUniformType<T>;
+    using Element = typename Type::Element;
+    const Element* p = reinterpret_cast<const Element*>(pValues);
+    constexpr std::size_t N = Type::nComponents;
+    if (IsProgramUniformSupported())
+    {
+      if constexpr (Type::bMatrix)
+      {
+        if constexpr (N == 9) glProgramUniformMatrix3fv(nProgram, nLocation, nCount, GL_FALSE, p);
+        else glProgramUniformMatrix4fv(nProgram, nLocation, nCount, GL_FALSE, p);
+      }
+      else if constexpr (std::is_same_v<Element, GLfloat>)
+      {
+        if constexpr (N == 1) glProgramUniform1fv(nProgram, nLocation, nCount, p);
+        else if constexpr (N == 2) glProgramUniform2fv(nProgram, nLocation, nCount, p);
+        else if constexpr (N == 3) glProgramUniform3fv(nProgram, nLocation, nCount, p);
+        else glProgramUniform4fv(nProgram, nLocation, nCount, p);
+      }
+      else if constexpr (std::is_same_v<Element, GLint>)
+      {
+        if constexpr (N == 1) glProgramUniform1iv(nProgram, nLocation, nCount, p);
+        else if constexpr (N == 2) glProgramUniform2iv(nProgram, nLocation, nCount, p);
+        else if constexpr (N == 3) glProgramUniform3iv(nProgram, nLocation, nCount, p);
+        else glProgramUniform4iv(nProgram, nLocation, nCount, p);
+      }
+      else
+      {
+        if constexpr (N == 1) glProgramUniform1uiv(nProgram, nLocation, nCount, p);
+        else if constexpr (N == 2) glProgramUniform2uiv(nProgram, nLocation, nCount, p);
+        else if constexpr (N == 3) glProgramUniform3uiv(nProgram, nLocation, nCount, p);
+        else glProgramUniform4uiv(nProgram, nLocation, nCount, p);
+      }
+      return;
+    }
+
+    CScopedProgramBinding binding(nProgram);
+    SetBoundProgramUniform(nLocation, nCount, pValues);
+  }
+
+  /**
+   * \brief Sets several uniform values of the same type of a program, without binding it if possible.
+   *
+   * Each pair is set by its own call: OpenGL refuses a count of more than one for a uniform which is not an array,
+   * so pairs of consecutive locations cannot be merged without knowing they are elements of the same array. Set
+   * arrays with SetProgramUniform() or CUniformBatch::SetArray() instead. Without \c glProgramUniform*(), the
+   * program is bound once for all pairs.
+   *
+   * \param nProgram The OpenGL identifier of the program.
+   * \param pUniforms (location, value) pairs, the values being of a type supported by SUniformType.
+   * \param nCount The number of pairs.
+   * \see SetProgramUniform()
+   */
+  template<typename T>
+  void SetProgramUniforms(GLuint nProgram, const std::pair<GLint, T>* pUniforms, std::size_t nCount)
+  {
+    std::optional<CScopedProgramBinding> binding;
+    if (!IsProgramUniformSupported())
+      binding.emplace(nProgram);
+    for (std::size_t i = 0; i < nCount; ++i)
+      SetProgramUniform(nProgram, pUniforms[i].first, 1, &pUniforms[i].second);
+  }
+
+  /**
+   * \brief A set of uniform values, grouped by type, to give to one or several programs.
+   *
+   * A CUniformBatch records (location, value) pairs with Set(), and arrays with SetArray(), then Apply() sets them to a
+   * program without binding it when IsProgramUniformSupported() is \c true. Values of the same type are stored and set
+   * together, and the elements of an array by a single call, so that material setup of many programs issues a tight
+   * sequence of \c glProgramUniform*() calls, and no \c glUseProgram(). Otherwise, the program is bound once per
+   * Apply(), and the previous program is bound back.
+   *
+   * \code{.cpp}
+   * GLShaderPP::CUniformBatch batch;
+   * batch.Set(program.GetUniformLocation("roughness"), 0.5f);
+   * batch.Set(program.GetUniformLocation("albedo"), std::array<GLfloat, 3>{ 1.f, 0.8f, 0.6f });
+   * batch.Set(program.GetUniformLocation("albedoMap"), 0);
+   * program.SetUniforms(batch);
+   * \endcode
+   *
+   * Locations are those of the program the batch is applied to. Programs sharing the same explicit uniform
+   * locations (\c layout(location = N)) can be given the same batch.
+   */
+  class CUniformBatch
+  {
+    //!\brief Values of a type, and the locations they are set to
+    template<typename T>
+    struct SGroup
+    {
+      std::vector<T> values;                          //!< Values of all ranges, one after the other
+      std::vector<std::pair<GLint, GLsizei>> ranges;  //!< (location, count) of each range, count being more than 1 for arrays
+    };
+
+    //!\brief One group per supported type
+    std::tuple<
+      SGroup<GLfloat>, SGroup<std::array<GLfloat, 2>>, SGroup<std::array<GLfloat, 3>>, SGroup<std::array<GLfloat, 4>>,
+      SGroup<GLint>, SGroup<std::array<GLint, 2>>, SGroup<std::array<GLint, 3>>, SGroup<std::array<GLint, 4>>,
+      SGroup<GLuint>, SGroup<std::array<GLuint, 2>>, SGroup<std::array<GLuint, 3>>, SGroup<std::array<GLuint, 4>>,
+      SGroup<std::array<GLfloat, 9>>, SGroup<std::array<GLfloat, 16>>
+    > m_groups;
+
+  public:
+    /**
+     * \brief Records a uniform value.
+     *
+     * \param nLocation The location of the uniform. A location of -1 is skipped.
+     * \param value The value, of a type supported by SUniformType.
+     */
+    template<typename T>
+    void Set(GLint nLocation, const T& value)
+    {
+      SetArray(nLocation, &value, 1);
+    }
+
+    /**
+     * \brief Records the values of an array uniform, which are set by a single call.
+     *
+     * \param nLocation The location of the first element to set. A location of -1 is skipped.
+     * \param pValues The values, of a type supported by SUniformType.
+     * \param nCount The number of values.
+     */
+    template<typename T>
+    void SetArray(GLint nLocation, const T* pValues, GLsizei nCount)
+    {
+      if (nLocation == -1 || nCount <= 0)
+        return;
+      SGroup<T>& group = std::get<SGroup<T>>(m_groups);
+      group.values.insert(group.values.end(), pValues, pValues + nCount);
+      group.ranges.emplace_back(nLocation, nCount);
+    }
+
+    /**
+     * \brief Sets the recorded values to a program, without binding it if possible.
+     *
+     * \param nProgram The OpenGL identifier of the program.
+     */
+    void Apply(GLuint nProgram) const
+    {
+      std::optional<CScopedProgramBinding> binding;
+      if (!IsProgramUniformSupported())
+        binding.emplace(nProgram);
+      std::apply([nProgram](const auto&... groups) { (applyGroup(nProgram, groups), ...); }, m_groups);
+    }
+
+    /**
+     * \brief Returns the number of recorded values, array elements included.
+     */
+    std::size_t GetSize() const
+    {
+      return std::apply([](const auto&... groups) { return (groups.values.size() + ...); }, m_groups);
+    }
+
+    /**
+     * \brief Forgets the recorded values.
+     */
+    void Clear()
+    {
+      std::apply([](auto&... groups) { ((groups.values.clear(), groups.ranges.clear()), ...); }, m_groups);
+    }
+
+  private:
+    /**
+     * \brief Sets the ranges of a group, one call per range.
+     */
+    template<typename T>
+    static void applyGroup(GLuint nProgram, const SGroup<T>& group)
+    {
+      const T* pValues = group.values.data();
+      for (const auto& [nLocation, nCount] : group.ranges)
+      {
+        SetProgramUniform(nProgram, nLocation, nCount, pValues);
+        pValues += nCount;
+      }
+    }
+  };
+
+  template<typename T>
+  void CShaderProgramBase::SetUniform(GLint nLocation, const T& value) { SetProgramUniform(m_nProgram, nLocation, 1, &value); }
+
+  template<typename T>
+  void CShaderProgramBase::SetUniformArray(GLint nLocation, const T* pValues, GLsizei nCount) { SetProgramUniform(m_nProgram, nLocation, nCount, pValues); }
+
+  template<typename T>
+  void CShaderProgramBase::SetUniforms(const std::pair<GLint, T>* pUniforms, std::size_t nCount) { SetProgramUniforms(m_nProgram, pUniforms, nCount); }
+
+  template<typename T>
+  void CShaderProgramBase::SetUniforms(const std::vector<std::pair<GLint, T>>& uniforms) { SetProgramUniforms(m_nProgram, uniforms.data(), uniforms.size()); }
+
+  inline void CShaderProgramBase::SetUniforms(const CUniformBatch& batch) { batch.Apply(m_nProgram); }
+
+}
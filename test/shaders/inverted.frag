@@ -0,0 +1,9 @@
+#version 330 core
+
+in vec3 color; 
+out vec4 fragColor;
+
+void main()
+{
+	fragColor = vec4(vec3(1.0f) - color, 1.0f);
+}
@@ -0,0 +1,31 @@
+#version 400 core
+
+in vec3 color; 
+out vec4 fragColor;
+
+subroutine vec3 ColorFilter(vec3 c);
+
+subroutine(ColorFilter) vec3 identity(vec3 c)
+{
+	return c;
+}
+
+subroutine(ColorFilter) vec3 inverted(vec3 c)
+{
+	return vec3(1.0f) - c;
+}
+
+subroutine float Intensity(float i);
+
+subroutine(Intensity) float full(float i)
+{
+	return i;
+}
+
+subroutine uniform ColorFilter colorFilter;
+subroutine uniform Intensity intensity;
+
+void main()
+{
+	fragColor = vec4(colorFilter(color) * intensity(1.0f), 1.0f);
+}
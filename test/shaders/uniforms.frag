@@ -0,0 +1,19 @@
+#version 330 core
+
+in vec3 color; 
+out vec4 fragColor;
+
+uniform float brightness;
+uniform vec3 tint;
+uniform int mode;
+uniform uvec2 flags;
+uniform mat4 colorTransform;
+uniform float weights[3];
+
+void main()
+{
+	vec4 result = colorTransform * vec4(color * tint * brightness, 1.0f);
+	if (mode != 0 || flags.x != flags.y)
+		result.rgb *= weights[0] + weights[1] + weights[2];
+	fragColor = result;
+}
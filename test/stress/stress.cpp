@@ -0,0 +1,393 @@
+#ifdef _WIN32
+#include <Windows.h>
+#include <Psapi.h>
+#elif defined(__linux__)
+#include <unistd.h>
+#endif
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <GLShaderPP/ShaderProgram.h>
+#include <GLShaderPP/ResourceStats.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//Stress harness of GLShaderPP: builds, uses and destroys many shaders and programs on several shared
+//contexts, then fails if OpenGL objects created by a round outlive it on any context, or if process memory
+//grows from one round to the next.
+//
+//GLSHADERPP_STRESS_ITERATIONS sets the number of programs built (20000 by default), and
+//GLSHADERPP_STRESS_CONTEXTS the number of shared contexts, each used by its own thread (3 by default).
+
+#ifdef _WIN32
+//This magic line is to force notebook computer that share NVidia and Intel graphics to use high performance GPU (NVidia).
+extern "C" _declspec(dllexport) unsigned long NvOptimusEnablement = 0x00000001;
+#endif
+
+namespace {
+
+  constexpr int nRounds = 10;               //Iterations are split in rounds, metrics are sampled after each one
+  constexpr int nSourceVariants = 64;       //Number of distinct sources, as many hot reloaded shaders would have
+  constexpr std::size_t nStreamedPrograms = 32; //Programs kept alive by the streaming pattern of each context
+  constexpr double rssToleranceMiB = 32.;   //Allowed resident memory growth after the first round
+  constexpr int nRssWindow = 3;             //Number of consecutive rounds of the sliding window of the memory trend
+  constexpr double rssWindowToleranceMiB = 16.; //Allowed resident memory growth within the sliding window
+
+  using Clock = std::chrono::steady_clock;
+
+  //A program built on a context, to be used and destroyed on another one
+  struct SHandOver
+  {
+    std::unique_ptr<GLShaderPP::CShaderProgram> pProgram;
+    GLsync sync; //Signaled when the producer context is done with the program
+  };
+
+  //A mailbox of programs handed over to a context
+  struct SMailbox
+  {
+    std::mutex mutex;
+    std::vector<SHandOver> programs;
+  };
+
+  //Durations of the operations of a round, in microseconds
+  struct SLatencies
+  {
+    std::vector<double> compile;
+    std::vector<double> link;
+
+    void Append(const SLatencies& other)
+    {
+      compile.insert(compile.end(), other.compile.begin(), other.compile.end());
+      link.insert(link.end(), other.link.begin(), other.link.end());
+    }
+  };
+
+  std::size_t getEnvironmentValue(const char* pName, std::size_t nDefault)
+  {
+    const char* pValue = std::getenv(pName);
+    return pValue && std::atoll(pValue) > 0 ? static_cast<std::size_t>(std::atoll(pValue)) : nDefault;
+  }
+
+  //Resident set size of the process, in MiB, or 0 if it is unknown
+  double getResidentMiB()
+  {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+      return counters.WorkingSetSize / (1024. * 1024.);
+#elif defined(__linux__)
+    std::ifstream statm("/proc/self/statm");
+    std::size_t nSize = 0, nResident = 0;
+    if (statm >> nSize >> nResident)
+      return nResident * static_cast<double>(sysconf(_SC_PAGESIZE)) / (1024. * 1024.);
+#endif
+    return 0.;
+  }
+
+  double getPercentile(std::vector<double>& values, double percentile)
+  {
+    if (values.empty())
+      return 0.;
+    const std::size_t nRank = std::min(values.size() - 1, static_cast<std::size_t>(percentile / 100. * values.size()));
+    std::nth_element(values.begin(), values.begin() + nRank, values.end());
+    return values[nRank];
+  }
+
+  void printLatencies(const char* pName, std::vector<double>& values)
+  {
+    const double p50 = getPercentile(values, 50.), p90 = getPercentile(values, 90.), p99 = getPercentile(values, 99.);
+    const double max = values.empty() ? 0. : *std::max_element(values.begin(), values.end());
+    std::printf("%-8s latency (us): p50 %8.1f  p90 %8.1f  p99 %8.1f  max %8.1f  (%zu samples)\n", pName, p50, p90, p99, max, values.size());
+  }
+
+  std::string makeFragmentSource(int nVariant)
+  {
+    return "#version 330 core\nout vec4 fragColor;\nvoid main()\n{\n  fragColor = vec4(" + std::to_string(nVariant) + ".0f / "
+      + std::to_string(nSourceVariants) + ".0f, 0.5f, 1.0f, 1.0f);\n}\n";
+  }
+
+  const char* const vertexSource = R"(#version 330 core
+void main()
+{
+  vec2 positions[3] = vec2[3](vec2(-1.0f, -1.0f), vec2(3.0f, -1.0f), vec2(-1.0f, 3.0f));
+  gl_Position = vec4(positions[gl_VertexID], 0.0f, 1.0f);
+})";
+
+  //The work of one context during one round
+  class CContextWorker
+  {
+    GLFWwindow* m_pContext;
+    SMailbox& m_inbox;
+    SMailbox& m_outbox;
+    GLuint m_nFramebuffer = 0, m_nRenderbuffer = 0, m_nVertexArray = 0;
+    std::deque<std::unique_ptr<GLShaderPP::CShaderProgram>> m_streamed;
+
+  public:
+    SLatencies latencies;
+    std::size_t nErrors = 0;
+    std::vector<GLuint> shaderIds;  //Shaders created during the round, which must all be deleted at its end
+    std::vector<GLuint> programIds; //Programs created during the round, which must all be deleted at its end
+
+    CContextWorker(GLFWwindow* pContext, SMailbox& inbox, SMailbox& outbox) : m_pContext(pContext), m_inbox(inbox), m_outbox(outbox) {}
+
+    void Run(std::size_t nIterations, std::size_t nFirstVariant)
+    {
+      glfwMakeContextCurrent(m_pContext);
+      GLShaderPP::CStateCache::Current().Invalidate();
+      //Framebuffers and vertex arrays are not shared between contexts
+      glGenRenderbuffers(1, &m_nRenderbuffer);
+      glBindRenderbuffer(GL_RENDERBUFFER, m_nRenderbuffer);
+      glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, 4, 4);
+      glGenFramebuffers(1, &m_nFramebuffer);
+      glBindFramebuffer(GL_FRAMEBUFFER, m_nFramebuffer);
+      glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_nRenderbuffer);
+      glGenVertexArrays(1, &m_nVertexArray);
+      glBindVertexArray(m_nVertexArray);
+      glViewport(0, 0, 4, 4);
+
+      for (std::size_t i = 0; i < nIterations; ++i)
+      {
+        std::unique_ptr<GLShaderPP::CShaderProgram> pProgram = build(static_cast<int>((nFirstVariant + i) % nSourceVariants));
+        if (!pProgram)
+          continue;
+        switch (i % 3)
+        {
+        case 0: //Hot reload: the program replaces the previous one and is destroyed at once
+          draw(*pProgram);
+          break;
+        case 1: //Streaming: the program lives while others are streamed in
+          draw(*pProgram);
+          m_streamed.push_back(std::move(pProgram));
+          if (m_streamed.size() > nStreamedPrograms)
+            m_streamed.pop_front();
+          break;
+        case 2: //Shared: the program is used and destroyed by another context
+          handOver(std::move(pProgram));
+          break;
+        }
+        if (i % 16 == 0)
+          DrainInbox();
+      }
+      m_streamed.clear();
+      glfwMakeContextCurrent(nullptr);
+    }
+
+    //Uses and destroys the programs handed over by another context
+    void DrainInbox()
+    {
+      std::vector<SHandOver> programs;
+      {
+        std::lock_guard<std::mutex> lock(m_inbox.mutex);
+        programs.swap(m_inbox.programs);
+      }
+      for (SHandOver& handOver : programs)
+      {
+        glWaitSync(handOver.sync, 0, GL_TIMEOUT_IGNORED);
+        glDeleteSync(handOver.sync);
+        draw(*handOver.pProgram);
+      }
+    }
+
+    void Finish()
+    {
+      //A program deleted while it is bound lives until it is unbound
+      glUseProgram(0);
+      GLShaderPP::CStateCache::Current().Invalidate();
+      glDeleteVertexArrays(1, &m_nVertexArray);
+      glDeleteFramebuffers(1, &m_nFramebuffer);
+      glDeleteRenderbuffers(1, &m_nRenderbuffer);
+      glFinish();
+      while (glGetError() != GL_NO_ERROR)
+        ++nErrors;
+      glfwMakeContextCurrent(nullptr);
+    }
+
+  private:
+    std::unique_ptr<GLShaderPP::CShaderProgram> build(int nVariant)
+    {
+      try
+      {
+        const std::string strFragment = makeFragmentSource(nVariant);
+        const Clock::time_point start = Clock::now();
+        GLShaderPP::CVertexShader vertex{ vertexSource };
+        const Clock::time_point vertexCompiled = Clock::now();
+        shaderIds.push_back(vertex.GetShaderId());
+        GLShaderPP::CFragmentShader fragment{ strFragment };
+        const Clock::time_point fragmentCompiled = Clock::now();
+        shaderIds.push_back(fragment.GetShaderId());
+        auto pProgram = std::make_unique<GLShaderPP::CShaderProgram>(GLShaderPP::detachShaders, vertex, fragment);
+        const Clock::time_point linked = Clock::now();
+        programIds.push_back(pProgram->GetProgramId());
+        latencies.compile.push_back(std::chrono::duration<double, std::micro>(vertexCompiled - start).count());
+        latencies.compile.push_back(std::chrono::duration<double, std::micro>(fragmentCompiled - vertexCompiled).count());
+        latencies.link.push_back(std::chrono::duration<double, std::micro>(linked - fragmentCompiled).count());
+        return pProgram;
+      }
+      catch (const GLShaderPP::CShaderException& e)
+      {
+        std::cerr << e.what() << '\n';
+        ++nErrors;
+        return nullptr;
+      }
+    }
+
+    void draw(GLShaderPP::CShaderProgram& program)
+    {
+      program.Use();
+      glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+
+    void handOver(std::unique_ptr<GLShaderPP::CShaderProgram> pProgram)
+    {
+      GLsync sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      glFlush();
+      std::lock_guard<std::mutex> lock(m_outbox.mutex);
+      m_outbox.programs.push_back({ std::move(pProgram), sync });
+    }
+  };
+
+}
+
+int main()
+{
+  const std::size_t nIterations = getEnvironmentValue("GLSHADERPP_STRESS_ITERATIONS", 20000);
+  const std::size_t nContexts = getEnvironmentValue("GLSHADERPP_STRESS_CONTEXTS", 3);
+  //Binary sizes are part of the leak check, so they are queried at each link
+  GLShaderPP::CResourceStats::SetBinaryAccounting(true);
+
+  if (glfwInit() != GLFW_TRUE)
+  {
+    std::cerr << "Cannot initialize GLFW\n";
+    return 1;
+  }
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+  std::vector<GLFWwindow*> contexts;
+  for (std::size_t i = 0; i < nContexts; ++i)
+  {
+    contexts.push_back(glfwCreateWindow(64, 64, "GLShaderPP stress", nullptr, i == 0 ? nullptr : contexts.front()));
+    if (!contexts.back())
+    {
+      std::cerr << "Cannot create OpenGL context #" << i << '\n';
+      return 1;
+    }
+  }
+  glfwMakeContextCurrent(contexts.front());
+  glewExperimental = GL_TRUE;
+  if (glewInit() != GLEW_OK)
+  {
+    std::cerr << "Cannot initialize GLEW\n";
+    return 1;
+  }
+  std::printf("GLShaderPP stress: %zu programs, %zu shared contexts, OpenGL %s on %s\n", nIterations, nContexts,
+    reinterpret_cast<const char*>(glGetString(GL_VERSION)), reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+  glfwMakeContextCurrent(nullptr);
+
+  const GLShaderPP::CResourceStats::SSnapshot baseline = GLShaderPP::CResourceStats::Get();
+  std::vector<SMailbox> mailboxes(nContexts);
+  SLatencies latencies;
+  std::vector<double> residentMiB;
+  std::size_t nErrors = 0;
+  bool bLeak = false;
+  std::size_t nLiveObjects = 0;
+
+  const std::size_t nIterationsPerRound = std::max<std::size_t>(1, nIterations / nRounds / nContexts);
+  for (int nRound = 0; nRound < nRounds; ++nRound)
+  {
+    std::deque<CContextWorker> workers; //Workers are not movable
+    for (std::size_t i = 0; i < nContexts; ++i)
+      workers.emplace_back(contexts[i], mailboxes[i], mailboxes[(i + 1) % nContexts]);
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < nContexts; ++i)
+      threads.emplace_back([&workers, i, nRound, nIterationsPerRound]() { workers[i].Run(nIterationsPerRound, nRound * nIterationsPerRound + i); });
+    for (std::thread& thread : threads)
+      thread.join();
+
+    //Handed over programs left in mailboxes are destroyed by their receiving context
+    for (std::size_t i = 0; i < nContexts; ++i)
+    {
+      glfwMakeContextCurrent(contexts[i]);
+      GLShaderPP::CStateCache::Current().Invalidate();
+      workers[i].DrainInbox();
+      workers[i].Finish();
+      latencies.Append(workers[i].latencies);
+      nErrors += workers[i].nErrors;
+    }
+
+    //Objects are shared, so no context may still see an object created during the round
+    std::size_t nRoundLiveObjects = 0;
+    for (GLFWwindow* pContext : contexts)
+    {
+      glfwMakeContextCurrent(pContext);
+      for (const CContextWorker& worker : workers)
+      {
+        nRoundLiveObjects += std::count_if(worker.shaderIds.begin(), worker.shaderIds.end(), [](GLuint nId) { return glIsShader(nId) == GL_TRUE; });
+        nRoundLiveObjects += std::count_if(worker.programIds.begin(), worker.programIds.end(), [](GLuint nId) { return glIsProgram(nId) == GL_TRUE; });
+      }
+    }
+    glfwMakeContextCurrent(nullptr);
+    nLiveObjects += nRoundLiveObjects;
+
+    const GLShaderPP::CResourceStats::SSnapshot stats = GLShaderPP::CResourceStats::Get();
+    residentMiB.push_back(getResidentMiB());
+    std::printf("round %2d: %zu shaders, %zu programs, %zu binary bytes held, %zu objects alive, resident memory %.1f MiB\n", nRound + 1,
+      stats.nShaders, stats.nPrograms, stats.nBinaryBytes, nRoundLiveObjects, residentMiB.back());
+    if (stats.nShaders != baseline.nShaders || stats.nPrograms != baseline.nPrograms || stats.nBinaryBytes != baseline.nBinaryBytes)
+      bLeak = true;
+  }
+
+  printLatencies("compile", latencies.compile);
+  printLatencies("link", latencies.link);
+
+  for (GLFWwindow* pContext : contexts)
+    glfwDestroyWindow(pContext);
+  glfwTerminate();
+
+  int nResult = 0;
+  if (nErrors > 0)
+  {
+    std::printf("FAILED: %zu OpenGL or GLShaderPP errors\n", nErrors);
+    nResult = 1;
+  }
+  if (bLeak)
+  {
+    std::printf("FAILED: shader or program objects are still held after a round\n");
+    nResult = 1;
+  }
+  if (nLiveObjects > 0)
+  {
+    std::printf("FAILED: %zu shader or program objects are still alive on a context after their round\n", nLiveObjects);
+    nResult = 1;
+  }
+  //The first round warms up allocators and driver caches, resident memory must then stay flat, overall and
+  //within any window of consecutive rounds, so that a steady leak is caught even if later rounds free memory
+  if (residentMiB.size() > 1 && residentMiB.back() - residentMiB.front() > rssToleranceMiB)
+  {
+    std::printf("FAILED: resident memory grew by %.1f MiB after the first round\n", residentMiB.back() - residentMiB.front());
+    nResult = 1;
+  }
+  double maxWindowGrowthMiB = 0.;
+  for (std::size_t i = 1; i + nRssWindow <= residentMiB.size(); ++i)
+    maxWindowGrowthMiB = std::max(maxWindowGrowthMiB, residentMiB[i + nRssWindow - 1] - residentMiB[i]);
+  std::printf("resident memory: %.1f MiB maximum growth over %d consecutive rounds\n", maxWindowGrowthMiB, nRssWindow);
+  if (maxWindowGrowthMiB > rssWindowToleranceMiB)
+  {
+    std::printf("FAILED: resident memory grew by %.1f MiB over %d consecutive rounds\n", maxWindowGrowthMiB, nRssWindow);
+    nResult = 1;
+  }
+  if (nResult == 0)
+    std::printf("PASSED\n");
+  return nResult;
+}
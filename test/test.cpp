@@ -2,14 +2,32 @@
 #include <Windows.h>
 #endif
 #define CATCH_CONFIG_MAIN // This tells Catch to provide a main() 
+#define CATCH_CONFIG_ENABLE_BENCHMARKING // Benchmarks are hidden test cases tagged [benchmark]
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
+#include <filesystem>
 #include <fstream>
+#include <map>
 #include <sstream>
+#include <thread>
 #include <GLShaderPP/ShaderProgram.h>
 #include <GLShaderPP/ShaderException.h>
+#include <GLShaderPP/ShaderScheduler.h>
+#include <GLShaderPP/ProgramWarmUp.h>
+#include <GLShaderPP/Subroutines.h>
+#include <GLShaderPP/ComputeProgram.h>
+#include <GLShaderPP/GpuProfiler.h>
+#include <GLShaderPP/ProgramRegistry.h>
+#include <GLShaderPP/ShaderPack.h>
+#include <GLShaderPP/ProgramReflection.h>
+#include <GLShaderPP/SourcePipeline.h>
+#include <GLShaderPP/Uniforms.h>
+#include <GLShaderPP/ProgramReport.h>
+#ifdef __cpp_impl_coroutine
+#include <GLShaderPP/AsyncProgram.h>
+#endif
 #include <catch2/catch.hpp>
 
 using namespace std::string_literals;
@@ -43,6 +61,13 @@ AreSimilarShaderExceptionMatcher AreSimilarShaderException(const GLShaderPP::CSh
 }
 
 
+std::string readFile(const char* pFileName)
+{
+  std::stringstream ss;
+  ss << std::ifstream{ pFileName }.rdbuf();
+  return ss.str();
+}
+
 const char* GetGLErrorString();
 void error_callback(int error, const char* description)
 {
@@ -67,6 +92,8 @@ std::string initWindow(const int nWndWidth, const int nWndHeight)
   REQUIRE(pWnd != nullptr);
 
   glfwMakeContextCurrent(pWnd);
+  //A new context is current on this thread, so what GLShaderPP knows about the previous one is obsolete
+  GLShaderPP::CStateCache::Current().Invalidate();
 
   glewExperimental = GL_TRUE;
   GLenum err;
@@ -504,6 +531,72 @@ void main()
   glfwTerminate();
 }
 
+TEST_CASE("Report errors through error policies", "[error-policies]")
+{
+  constexpr int nWndWidth = 800;
+  constexpr int nWndHeight = 600;
+
+  INFO(initWindow(nWndWidth, nWndHeight));
+
+  using CStatusShader = GLShaderPP::CBasicShader<GLShaderPP::CStatusErrorPolicy>;
+  using CStatusProgram = GLShaderPP::CBasicShaderProgram<GLShaderPP::CStatusErrorPolicy>;
+
+  //Errors are only reported by statuses
+  CStatusShader faulty{ GL_VERTEX_SHADER };
+  faulty.SetSource("This shader won't compile"s);
+  CHECK(faulty.Compile() == CStatusShader::ShaderCompileState::compileError);
+  CStatusShader unreadable{ GL_VERTEX_SHADER, std::ifstream{ "missing.vert" } };
+  CHECK(unreadable.GetCompileState() == CStatusShader::ShaderCompileState::badSourceStream);
+  CStatusProgram notReady{ faulty };
+  CHECK(notReady.GetLinkingStatus() == CStatusProgram::LinkingStatus::prepareLinkError);
+
+  const std::string strVertexSource = readFile("vertex.vert");
+  CStatusShader vertex1{ GL_VERTEX_SHADER, strVertexSource };
+  CStatusShader vertex2{ GL_VERTEX_SHADER, strVertexSource };
+  CStatusProgram unlinkable;
+  unlinkable << vertex1 << vertex2;
+  CHECK(unlinkable.Link() == CStatusProgram::LinkingStatus::linkingError);
+
+  //Shaders of any policy can be linked by programs of any policy
+  GLShaderPP::CShader fragment{ GL_FRAGMENT_SHADER, std::ifstream{ "fragment.frag" } };
+  CStatusProgram program{ vertex1, fragment };
+  CHECK(program.GetLinkingStatus() == CStatusProgram::LinkingStatus::linkingOk);
+
+  //Errors are given to a user callback with their messages
+  std::vector<std::pair<GLShaderPP::CShaderException::ExceptionType, std::string>> errors;
+  GLShaderPP::CCallbackErrorPolicy::SetCallback([&errors](GLShaderPP::CShaderException::ExceptionType eType, const std::string& strWhat) {
+    errors.emplace_back(eType, strWhat);
+  });
+  GLShaderPP::CBasicShader<GLShaderPP::CCallbackErrorPolicy> reported{ GL_FRAGMENT_SHADER, "This shader won't compile"s };
+  GLShaderPP::CBasicShaderProgram<GLShaderPP::CCallbackErrorPolicy> reportedProgram{ vertex1, vertex2 };
+  GLShaderPP::CCallbackErrorPolicy::SetCallback(nullptr);
+  REQUIRE(errors.size() == 2);
+  CHECK(errors[0].first == GLShaderPP::CShaderException::ExceptionType::CompilationError);
+  CHECK(errors[0].second.find("fragment shader compilation") != std::string::npos);
+  CHECK(errors[1].first == GLShaderPP::CShaderException::ExceptionType::LinkError);
+  CHECK(reportedProgram.GetLinkingStatus() == GLShaderPP::CShaderProgram::LinkingStatus::linkingError);
+
+  //Compute programs and schedulers report through their policies too
+  using CStatusComputeProgram = GLShaderPP::CBasicComputeProgram<GLShaderPP::CStatusErrorPolicy>;
+  CStatusComputeProgram notCompute{ vertex1 };
+  CHECK(notCompute.GetLinkingStatus() == CStatusComputeProgram::LinkingStatus::prepareLinkError);
+  CStatusComputeProgram compute{ CStatusShader{ GL_COMPUTE_SHADER, std::ifstream{ "count.comp" } } };
+  REQUIRE(compute.GetLinkingStatus() == CStatusComputeProgram::LinkingStatus::linkingOk);
+  compute.Dispatch(1, 1, 0xFFFFFFFFu);
+  CHECK(glGetError() == GL_NO_ERROR);
+
+  using CStatusScheduler = GLShaderPP::CBasicShaderScheduler<GLShaderPP::CStatusErrorPolicy>;
+  CStatusScheduler scheduler;
+  auto pFaulty = std::make_unique<CStatusScheduler::BuilderType>();
+  pFaulty->AddStage(GL_VERTEX_SHADER, "This shader won't compile"s);
+  const CStatusScheduler::Handle hFaulty = scheduler.Enqueue(std::move(pFaulty));
+  while (scheduler.GetQueueDepth() > 0)
+    scheduler.Pump(std::chrono::milliseconds(16));
+  CHECK(scheduler.GetState(hFaulty) == CStatusScheduler::BuildState::failed);
+
+  glfwTerminate();
+}
+
 TEST_CASE("Try to read source from a bad stream", "[bad-source-stream]")
 {
   constexpr int nWndWidth = 800;
@@ -523,6 +616,1453 @@ TEST_CASE("Try to read source from a bad stream", "[bad-source-stream]")
   glfwTerminate();
 }
 
+TEST_CASE("Build a typical GLSL program step by step with CProgramBuilder", "[program-builder]")
+{
+  constexpr int nWndWidth = 800;
+  constexpr int nWndHeight = 600;
+
+  INFO(initWindow(nWndWidth, nWndHeight));
+
+  GLShaderPP::CProgramBuilder builder;
+  builder.AddStage(GL_VERTEX_SHADER, readFile("vertex.vert"))
+         .AddStage(GL_FRAGMENT_SHADER, readFile("fragment.frag"));
+  CHECK(builder.GetState() == GLShaderPP::CProgramBuilder::BuildState::notStarted);
+  CHECK(builder.GetProgram() == nullptr);
+
+  CHECK(builder.Step());
+  CHECK(builder.GetState() == GLShaderPP::CProgramBuilder::BuildState::compiling);
+
+  builder.Finish();
+  REQUIRE(builder.GetState() == GLShaderPP::CProgramBuilder::BuildState::ready);
+  CHECK_FALSE(builder.Step());
+
+  std::unique_ptr<GLShaderPP::CShaderProgram> pProgram = builder.TakeProgram();
+  REQUIRE(pProgram != nullptr);
+  REQUIRE(pProgram->GetLinkingStatus() == GLShaderPP::CShaderProgram::LinkingStatus::linkingOk);
+  CHECK(builder.TakeProgram() == nullptr);
+  pProgram->Use();
+
+  testTriangle(nWndWidth, nWndHeight);
+
+  glfwTerminate();
+}
+
+TEST_CASE("Build a non compilable GLSL program with CProgramBuilder", "[faulty-program-builder]")
+{
+  constexpr int nWndWidth = 800;
+  constexpr int nWndHeight = 600;
+
+  INFO(initWindow(nWndWidth, nWndHeight));
+
+  GLShaderPP::CProgramBuilder builder;
+  builder.AddStage(GL_VERTEX_SHADER, "This shader won't compile"s)
+         .AddStage(GL_FRAGMENT_SHADER, readFile("fragment.frag"));
+
+  CHECK_THROWS_MATCHES(
+    builder.Finish(),
+    GLShaderPP::CShaderException,
+    AreSimilarShaderException(GLShaderPP::CShaderException(""s, GLShaderPP::CShaderException::ExceptionType::CompilationError))
+  );
+  CHECK(builder.GetState() == GLShaderPP::CProgramBuilder::BuildState::failed);
+  CHECK(builder.GetProgram() == nullptr);
+
+  glfwTerminate();
+}
+
+TEST_CASE("Build GLSL programs within a frame budget with CShaderScheduler", "[shader-scheduler]")
+{
+  constexpr int nWndWidth = 800;
+  constexpr int nWndHeight = 600;
+
+  INFO(initWindow(nWndWidth, nWndHeight));
+
+  GLShaderPP::CShaderProgram fallback{
+    GLShaderPP::CShader{ GL_VERTEX_SHADER, std::ifstream{ "vertex.vert" } },
+    GLShaderPP::CShader{ GL_FRAGMENT_SHADER, std::ifstream{ "fragment.frag" } }
+  };
+
+  GLShaderPP::CShaderScheduler scheduler;
+  scheduler.SetFallbackProgram(&fallback);
+
+  auto makeBuilder = []() {
+    auto pBuilder = std::make_unique<GLShaderPP::CProgramBuilder>();
+    pBuilder->AddStage(GL_VERTEX_SHADER, readFile("vertex.vert"))
+             .AddStage(GL_FRAGMENT_SHADER, readFile("fragment.frag"));
+    return pBuilder;
+  };
+  GLShaderPP::CShaderScheduler::Handle hLow = scheduler.Enqueue(makeBuilder(), 0);
+  GLShaderPP::CShaderScheduler::Handle hHigh = scheduler.Enqueue(makeBuilder(), 1);
+  CHECK(scheduler.GetQueueDepth() == 2);
+
+  //A null budget still does one step, on the highest priority build
+  const GLShaderPP::CShaderScheduler::SFrameStats& stats = scheduler.Pump(std::chrono::nanoseconds::zero());
+  CHECK(stats.nSteps == 1);
+  CHECK(stats.nQueueDepth == 2);
+  CHECK(scheduler.GetState(hHigh) == GLShaderPP::CProgramBuilder::BuildState::compiling);
+  CHECK(scheduler.GetState(hLow) == GLShaderPP::CProgramBuilder::BuildState::notStarted);
+
+  //Requesting the low priority program promotes it and uses the fallback one
+  CHECK_FALSE(scheduler.Use(hLow));
+  GLint nCurrentProgram = 0;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &nCurrentProgram);
+  CHECK(static_cast<GLuint>(nCurrentProgram) == fallback.GetProgramId());
+  scheduler.Pump(std::chrono::nanoseconds::zero());
+  CHECK(scheduler.GetState(hLow) == GLShaderPP::CProgramBuilder::BuildState::compiling);
+
+  while (scheduler.GetQueueDepth() > 0)
+    scheduler.Pump(std::chrono::milliseconds(16));
+  CHECK(scheduler.GetLastFrameStats().nQueueDepth == 0);
+  CHECK(scheduler.GetLastFrameStats().timeSpent > std::chrono::nanoseconds::zero());
+  REQUIRE(scheduler.GetState(hLow) == GLShaderPP::CProgramBuilder::BuildState::ready);
+  REQUIRE(scheduler.GetState(hHigh) == GLShaderPP::CProgramBuilder::BuildState::ready);
+
+  scheduler.Remove(hHigh);
+  CHECK(scheduler.GetProgram(hHigh) == nullptr);
+  REQUIRE(scheduler.Use(hLow));
+  glGetIntegerv(GL_CURRENT_PROGRAM, &nCurrentProgram);
+  CHECK(static_cast<GLuint>(nCurrentProgram) == scheduler.GetProgram(hLow)->GetProgramId());
+
+  //Invalid builders are rejected
+  CHECK(scheduler.Enqueue(nullptr) == GLShaderPP::CShaderScheduler::InvalidHandle);
+  CHECK(scheduler.GetState(GLShaderPP::CShaderScheduler::InvalidHandle) == GLShaderPP::CProgramBuilder::BuildState::failed);
+
+  //A failed build is forgotten once observed, and its slot is reused without confusing handles
+  CHECK(scheduler.GetBuildCount() == 1);
+  auto pFaulty = std::make_unique<GLShaderPP::CProgramBuilder>();
+  pFaulty->AddStage(GL_VERTEX_SHADER, "#version 330 core\nvoid main() { undefined(); }\n");
+  GLShaderPP::CShaderScheduler::Handle hFaulty = scheduler.Enqueue(std::move(pFaulty));
+  CHECK(hFaulty != hHigh);
+  try
+  {
+    while (scheduler.GetQueueDepth() > 0)
+      scheduler.Pump(std::chrono::milliseconds(16));
+  }
+  catch (const GLShaderPP::CShaderException&)
+  {
+  }
+  CHECK(scheduler.GetBuildCount() == 2);
+  CHECK(scheduler.GetState(hFaulty) == GLShaderPP::CProgramBuilder::BuildState::failed);
+  CHECK(scheduler.GetBuildCount() == 1);
+  GLShaderPP::CShaderScheduler::Handle hReused = scheduler.Enqueue(makeBuilder());
+  CHECK(hReused != hFaulty);
+  CHECK(scheduler.GetState(hFaulty) == GLShaderPP::CProgramBuilder::BuildState::failed);
+  CHECK(scheduler.GetState(hReused) == GLShaderPP::CProgramBuilder::BuildState::notStarted);
+  scheduler.Remove(hReused);
+
+  //A program taken from the scheduler is owned by the caller
+  std::unique_ptr<GLShaderPP::CShaderProgram> pTaken = scheduler.TakeProgram(hLow);
+  REQUIRE(pTaken);
+  CHECK(scheduler.GetBuildCount() == 0);
+  CHECK(scheduler.GetProgram(hLow) == nullptr);
+  pTaken->Use();
+
+  testTriangle(nWndWidth, nWndHeight);
+
+  glfwTerminate();
+}
+
+TEST_CASE("Warm up GLSL programs before using them", "[program-warmup]")
+{
+  constexpr int nWndWidth = 800;
+  constexpr int nWndHeight = 600;
+
+  INFO(initWindow(nWndWidth, nWndHeight));
+
+  auto pProgram1 = std::make_unique<GLShaderPP::CShaderProgram>(
+    GLShaderPP::CShader{ GL_VERTEX_SHADER, std::ifstream{ "vertex.vert" } },
+    GLShaderPP::CShader{ GL_FRAGMENT_SHADER, std::ifstream{ "fragment.frag" } }
+  );
+  auto pProgram2 = std::make_unique<GLShaderPP::CShaderProgram>(
+    GLShaderPP::CShader{ GL_VERTEX_SHADER, std::ifstream{ "vertex.vert" } },
+    GLShaderPP::CShader{ GL_FRAGMENT_SHADER, std::ifstream{ "fragment.frag" } }
+  );
+  GLShaderPP::CShaderProgram notLinked;
+
+  GLShaderPP::CProgramWarmer warmer;
+  pProgram2->Use();
+  glEnable(GL_BLEND);
+  CHECK(warmer.WarmUp(notLinked) == std::chrono::nanoseconds::zero());
+  CHECK(warmer.WarmUp(*pProgram1) > std::chrono::nanoseconds::zero());
+
+  std::vector<GLShaderPP::CShaderProgram*> programs{ pProgram1.get(), pProgram2.get() };
+  GLShaderPP::CProgramWarmer::SWarmUpReport report = warmer.WarmUp(programs.begin(), programs.end());
+  CHECK(report.nPrograms == 2);
+  CHECK(report.longest > std::chrono::nanoseconds::zero());
+  CHECK(report.total >= report.longest);
+
+  //Bindings are restored after warm-ups
+  GLint nCurrentProgram = 0;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &nCurrentProgram);
+  CHECK(static_cast<GLuint>(nCurrentProgram) == pProgram2->GetProgramId());
+  CHECK(glIsEnabled(GL_BLEND) == GL_TRUE);
+  CHECK(glIsEnabled(GL_DEPTH_TEST) == GL_FALSE);
+  CHECK(glGetError() == GL_NO_ERROR);
+  glDisable(GL_BLEND);
+
+  testTriangle(nWndWidth, nWndHeight);
+
+  glfwTerminate();
+}
+
+TEST_CASE("Detach shaders after linking a GLSL program", "[detach-shaders]")
+{
+  constexpr int nWndWidth = 800;
+  constexpr int nWndHeight = 600;
+
+  INFO(initWindow(nWndWidth, nWndHeight));
+
+  GLShaderPP::CShaderProgram program{
+    GLShaderPP::detachShaders,
+    GLShaderPP::CShader{ GL_VERTEX_SHADER, std::ifstream{ "vertex.vert" } },
+    GLShaderPP::CShader{ GL_FRAGMENT_SHADER, std::ifstream{ "fragment.frag" } }
+  };
+
+  REQUIRE(program.GetLinkingStatus() == GLShaderPP::CShaderProgram::LinkingStatus::linkingOk);
+  GLint nAttachedShaders = -1;
+  glGetProgramiv(program.GetProgramId(), GL_ATTACHED_SHADERS, &nAttachedShaders);
+  CHECK(nAttachedShaders == 0);
+  CHECK(program.HasStage(GL_VERTEX_SHADER));
+  CHECK(program.HasStage(GL_FRAGMENT_SHADER));
+  CHECK_FALSE(program.HasStage(GL_GEOMETRY_SHADER));
+  program.Use();
+
+  testTriangle(nWndWidth, nWndHeight);
+
+  glfwTerminate();
+}
+
+TEST_CASE("Account OpenGL objects held by GLShaderPP", "[resource-stats]")
+{
+  constexpr int nWndWidth = 800;
+  constexpr int nWndHeight = 600;
+
+  INFO(initWindow(nWndWidth, nWndHeight));
+
+  const GLShaderPP::CResourceStats::SSnapshot initial = GLShaderPP::CResourceStats::Get();
+  const std::string strVertexSource = readFile("vertex.vert");
+  {
+    GLShaderPP::CShader vertex{ GL_VERTEX_SHADER, strVertexSource };
+    GLShaderPP::CShader fragment{ GL_FRAGMENT_SHADER, std::ifstream{ "fragment.frag" } };
+    GLShaderPP::CShaderProgram program{ vertex, fragment };
+
+    const GLShaderPP::CResourceStats::SSnapshot current = GLShaderPP::CResourceStats::Get();
+    CHECK(current.nShaders == initial.nShaders + 2);
+    CHECK(current.nPrograms == initial.nPrograms + 1);
+    CHECK(current.nSourceBytes > initial.nSourceBytes + strVertexSource.size());
+
+    //Without binary accounting, the binary size is only queried and counted when asked
+    CHECK(current.nBinaryBytes == initial.nBinaryBytes);
+    const std::size_t nBinarySize = program.GetBinarySize();
+    CHECK(GLShaderPP::CResourceStats::Get().nBinaryBytes == initial.nBinaryBytes + nBinarySize);
+    CHECK(program.GetBinarySize() == nBinarySize);
+
+    //With binary accounting, it is counted at link time
+    GLShaderPP::CResourceStats::SetBinaryAccounting(true);
+    GLShaderPP::CShaderProgram accounted{ vertex, fragment };
+    GLShaderPP::CResourceStats::SetBinaryAccounting(false);
+    CHECK(GLShaderPP::CResourceStats::Get().nBinaryBytes == initial.nBinaryBytes + nBinarySize + accounted.GetBinarySize());
+
+    vertex.SetSource(""s);
+    CHECK(GLShaderPP::CResourceStats::Get().nSourceBytes == current.nSourceBytes - strVertexSource.size());
+  }
+  const GLShaderPP::CResourceStats::SSnapshot released = GLShaderPP::CResourceStats::Get();
+  CHECK(released.nShaders == initial.nShaders);
+  CHECK(released.nPrograms == initial.nPrograms);
+  CHECK(released.nSourceBytes == initial.nSourceBytes);
+  CHECK(released.nBinaryBytes == initial.nBinaryBytes);
+
+  glfwTerminate();
+}
+
+TEST_CASE("Skip redundant program binds with CStateCache", "[state-cache]")
+{
+  constexpr int nWndWidth = 800;
+  constexpr int nWndHeight = 600;
+
+  INFO(initWindow(nWndWidth, nWndHeight));
+
+  GLShaderPP::CStateCache& cache = GLShaderPP::CStateCache::Current();
+  cache.ResetCounters();
+
+  GLShaderPP::CShaderProgram program1{
+    GLShaderPP::CShader{ GL_VERTEX_SHADER, std::ifstream{ "vertex.vert" } },
+    GLShaderPP::CShader{ GL_FRAGMENT_SHADER, std::ifstream{ "fragment.frag" } }
+  };
+  auto pProgram2 = std::make_unique<GLShaderPP::CShaderProgram>(
+    GLShaderPP::CShader{ GL_VERTEX_SHADER, std::ifstream{ "vertex.vert" } },
+    GLShaderPP::CShader{ GL_FRAGMENT_SHADER, std::ifstream{ "fragment.frag" } }
+  );
+
+  program1.Use();
+  program1.Use();
+  CHECK(cache.GetBindsIssued() == 1);
+  CHECK(cache.GetBindsSkipped() == 1);
+
+  pProgram2->Use();
+  program1.Use();
+  CHECK(cache.GetBindsIssued() == 3);
+
+  //Raw OpenGL calls need an explicit invalidation
+  glUseProgram(0);
+  cache.Invalidate();
+  program1.Use();
+  CHECK(cache.GetBindsIssued() == 4);
+  GLint nCurrentProgram = 0;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &nCurrentProgram);
+  CHECK(static_cast<GLuint>(nCurrentProgram) == program1.GetProgramId());
+
+  //A moved program keeps its binding
+  GLShaderPP::CShaderProgram movedProgram{ std::move(program1) };
+  CHECK(program1.GetProgramId() == 0);
+  CHECK(movedProgram.GetLinkingStatus() == GLShaderPP::CShaderProgram::LinkingStatus::linkingOk);
+  movedProgram.Use();
+  CHECK(cache.GetBindsSkipped() == 2);
+
+  //A deleted program is forgotten
+  pProgram2->Use();
+  GLuint nDeletedProgram = pProgram2->GetProgramId();
+  pProgram2.reset();
+  CHECK_FALSE(cache.IsProgramBound(nDeletedProgram));
+
+  movedProgram = GLShaderPP::CShaderProgram{
+    GLShaderPP::CShader{ GL_VERTEX_SHADER, std::ifstream{ "vertex.vert" } },
+    GLShaderPP::CShader{ GL_FRAGMENT_SHADER, std::ifstream{ "fragment.frag" } }
+  };
+  REQUIRE(movedProgram.GetLinkingStatus() == GLShaderPP::CShaderProgram::LinkingStatus::linkingOk);
+  movedProgram.Use();
+  glGetIntegerv(GL_CURRENT_PROGRAM, &nCurrentProgram);
+  CHECK(static_cast<GLuint>(nCurrentProgram) == movedProgram.GetProgramId());
+
+  //A program released by another thread of the share group may have the name of the bound one, so it is bound again
+  const std::size_t nBindsIssued = cache.GetBindsIssued();
+  movedProgram.Use();
+  CHECK(cache.GetBindsIssued() == nBindsIssued);
+  std::thread([nOtherProgram = movedProgram.GetProgramId()]() { GLShaderPP::CStateCache::Current().ForgetProgram(nOtherProgram); }).join();
+  CHECK_FALSE(cache.IsProgramBound(movedProgram.GetProgramId()));
+  movedProgram.Use();
+  CHECK(cache.GetBindsIssued() == nBindsIssued + 1);
+  movedProgram.Use();
+  CHECK(cache.GetBindsIssued() == nBindsIssued + 1);
+
+  testTriangle(nWndWidth, nWndHeight);
+
+  glfwTerminate();
+}
+
+bool isGLVersionAtLeast(GLint nMajor, GLint nMinor)
+{
+  GLint nContextMajor = 0, nContextMinor = 0;
+  glGetIntegerv(GL_MAJOR_VERSION, &nContextMajor);
+  glGetIntegerv(GL_MINOR_VERSION, &nContextMinor);
+  return nContextMajor > nMajor || (nContextMajor == nMajor && nContextMinor >= nMinor);
+}
+
+TEST_CASE("Select shader subroutines of a GLSL program", "[subroutines]")
+{
+  constexpr int nWndWidth = 800;
+  constexpr int nWndHeight = 600;
+
+  INFO(initWindow(nWndWidth, nWndHeight));
+  if (!isGLVersionAtLeast(4, 0))
+  {
+    WARN("Shader subroutines need OpenGL 4.0");
+    glfwTerminate();
+    return;
+  }
+
+  GLShaderPP::CShaderProgram program{
+    GLShaderPP::CShader{ GL_VERTEX_SHADER, std::ifstream{ "vertex.vert" } },
+    GLShaderPP::CShader{ GL_FRAGMENT_SHADER, std::ifstream{ "subroutine.frag" } }
+  };
+  REQUIRE(program.GetLinkingStatus() == GLShaderPP::CShaderProgram::LinkingStatus::linkingOk);
+
+  GLShaderPP::CSubroutineSelector selector{ program };
+  CHECK(selector.GetUniformLocation(GL_FRAGMENT_SHADER, "colorFilter") >= 0);
+  CHECK(selector.GetUniformLocation(GL_VERTEX_SHADER, "colorFilter") == -1);
+  CHECK(selector.GetSubroutineIndex(GL_FRAGMENT_SHADER, "unknown") == GL_INVALID_INDEX);
+  CHECK_FALSE(selector.Select(GL_FRAGMENT_SHADER, "colorFilter", "unknown"));
+  //Subroutines of another type are not compatible
+  CHECK(selector.GetSubroutineIndex(GL_FRAGMENT_SHADER, "full") != GL_INVALID_INDEX);
+  CHECK_FALSE(selector.Select(GL_FRAGMENT_SHADER, "colorFilter", "full"));
+  CHECK(selector.Select(GL_FRAGMENT_SHADER, "intensity", "full"));
+
+  REQUIRE(selector.Select(GL_FRAGMENT_SHADER, "colorFilter", "identity"));
+  selector.Use();
+  CHECK(selector.GetUploadCount() == 1);
+
+  //Nothing changed, nothing is uploaded
+  selector.Use();
+  CHECK(selector.GetUploadCount() == 1);
+
+  testTriangle(nWndWidth, nWndHeight);
+
+  //The triangle center color, then its inverted color
+  unsigned char identityPixel[4], invertedPixel[4];
+  glReadPixels(nWndWidth / 2, nWndHeight / 2, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, identityPixel);
+  REQUIRE(selector.Select(GL_FRAGMENT_SHADER, "colorFilter", "inverted"));
+  selector.Use();
+  CHECK(selector.GetUploadCount() == 2);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  glReadPixels(nWndWidth / 2, nWndHeight / 2, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, invertedPixel);
+  for (int i = 0; i < 3; ++i)
+    CHECK(std::abs(identityPixel[i] + invertedPixel[i] - 255) <= 2);
+
+  //Binding another program resets subroutine selections, so they are uploaded again
+  GLShaderPP::CShaderProgram other{
+    GLShaderPP::CShader{ GL_VERTEX_SHADER, std::ifstream{ "vertex.vert" } },
+    GLShaderPP::CShader{ GL_FRAGMENT_SHADER, std::ifstream{ "fragment.frag" } }
+  };
+  other.Use();
+  selector.Use();
+  CHECK(selector.GetUploadCount() == 3);
+
+  //Another selector of the same program overwrites the selections, so they are uploaded again
+  GLShaderPP::CSubroutineSelector otherSelector{ program };
+  REQUIRE(otherSelector.Select(GL_FRAGMENT_SHADER, "colorFilter", "identity"));
+  otherSelector.Use();
+  CHECK(otherSelector.GetUploadCount() == 1);
+  selector.Use();
+  CHECK(selector.GetUploadCount() == 4);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  unsigned char pixel[4];
+  glReadPixels(nWndWidth / 2, nWndHeight / 2, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+  for (int i = 0; i < 3; ++i)
+    CHECK(pixel[i] == invertedPixel[i]);
+  CHECK(glGetError() == GL_NO_ERROR);
+
+  glfwTerminate();
+}
+
+TEST_CASE("Compare subroutine selection with program switches", "[.][benchmark][subroutines-benchmark]")
+{
+  constexpr int nWndWidth = 800;
+  constexpr int nWndHeight = 600;
+
+  INFO(initWindow(nWndWidth, nWndHeight));
+  if (!isGLVersionAtLeast(4, 0))
+  {
+    WARN("Shader subroutines need OpenGL 4.0");
+    glfwTerminate();
+    return;
+  }
+
+  GLShaderPP::CShaderProgram identityProgram{
+    GLShaderPP::CShader{ GL_VERTEX_SHADER, std::ifstream{ "vertex.vert" } },
+    GLShaderPP::CShader{ GL_FRAGMENT_SHADER, std::ifstream{ "fragment.frag" } }
+  };
+  GLShaderPP::CShaderProgram invertedProgram{
+    GLShaderPP::CShader{ GL_VERTEX_SHADER, std::ifstream{ "vertex.vert" } },
+    GLShaderPP::CShader{ GL_FRAGMENT_SHADER, std::ifstream{ "inverted.frag" } }
+  };
+  GLShaderPP::CShaderProgram subroutineProgram{
+    GLShaderPP::CShader{ GL_VERTEX_SHADER, std::ifstream{ "vertex.vert" } },
+    GLShaderPP::CShader{ GL_FRAGMENT_SHADER, std::ifstream{ "subroutine.frag" } }
+  };
+  GLShaderPP::CSubroutineSelector selector{ subroutineProgram };
+  const GLint nFilter = selector.GetUniformLocation(GL_FRAGMENT_SHADER, "colorFilter");
+  const GLuint nIdentity = selector.GetSubroutineIndex(GL_FRAGMENT_SHADER, "identity");
+  const GLuint nInverted = selector.GetSubroutineIndex(GL_FRAGMENT_SHADER, "inverted");
+
+  //Draw once to set up vertex arrays and an offscreen framebuffer, then keep the draws tiny
+  identityProgram.Use();
+  testTriangle(nWndWidth, nWndHeight);
+  glViewport(0, 0, 1, 1);
+
+  BENCHMARK("Switch between two programs")
+  {
+    identityProgram.Use();
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    invertedProgram.Use();
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+  };
+  glFinish();
+
+  BENCHMARK("Switch between two subroutines")
+  {
+    selector.Select(GL_FRAGMENT_SHADER, nFilter, nIdentity);
+    selector.Use();
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    selector.Select(GL_FRAGMENT_SHADER, nFilter, nInverted);
+    selector.Use();
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+  };
+  glFinish();
+
+  glfwTerminate();
+}
+
+TEST_CASE("Dispatch a compute program over a problem size", "[compute-program]")
+{
+  constexpr int nWndWidth = 800;
+  constexpr int nWndHeight = 600;
+
+  INFO(initWindow(nWndWidth, nWndHeight));
+  if (!isGLVersionAtLeast(4, 3))
+  {
+    WARN("Compute shaders need OpenGL 4.3");
+    glfwTerminate();
+    return;
+  }
+
+  GLShaderPP::CComputeProgram program{ GLShaderPP::CShader{ GL_COMPUTE_SHADER, std::ifstream{ "count.comp" } } };
+  REQUIRE(program.GetLinkingStatus() == GLShaderPP::CShaderProgram::LinkingStatus::linkingOk);
+  CHECK(program.GetWorkGroupSize() == std::array<GLint, 3>{ 64, 1, 1 });
+
+  GLShaderPP::SDispatchIndirectCommand command = program.GetDispatchCommand(100);
+  CHECK(command.nNumGroupsX == 2);
+  CHECK(command.nNumGroupsY == 1);
+  CHECK(command.nNumGroupsZ == 1);
+  CHECK(program.GetDispatchCommand(128).nNumGroupsX == 2);
+  CHECK(program.GetDispatchCommand(129).nNumGroupsX == 3);
+  CHECK(program.GetDispatchCommand(0).nNumGroupsX == 0);
+  CHECK(program.GetDispatchCommand(0xFFFFFFFFu).nNumGroupsX == 0x4000000u);
+
+  //Dispatches beyond GL_MAX_COMPUTE_WORK_GROUP_COUNT are reported, and non compute shaders are rejected
+  const std::array<GLint, 3>& maxCount = program.GetMaxWorkGroupCount();
+  CHECK(maxCount[0] >= 65535);
+  CHECK_FALSE(program.IsDispatchSupported(program.GetDispatchCommand(0xFFFFFFFFu, 1, 0xFFFFFFFFu)));
+  CHECK(program.IsDispatchSupported(program.GetDispatchCommand(64 * 65535u)));
+  try
+  {
+    program.Dispatch(1, 1, 0xFFFFFFFFu);
+    FAIL("An oversized dispatch must be reported");
+  }
+  catch (const GLShaderPP::CShaderException& e)
+  {
+    CHECK(e.type() == GLShaderPP::CShaderException::ExceptionType::BadDispatch);
+  }
+  try
+  {
+    GLShaderPP::CComputeProgram vertexProgram{ GLShaderPP::CShader{ GL_VERTEX_SHADER, std::ifstream{ "vertex.vert" } } };
+    FAIL("A vertex shader must be rejected");
+  }
+  catch (const GLShaderPP::CShaderException& e)
+  {
+    CHECK(e.type() == GLShaderPP::CShaderException::ExceptionType::PrepareLinkError);
+  }
+
+  //A buffer with a counter followed by 256 values
+  constexpr GLuint nProblemSize = 100;
+  std::vector<GLuint> data(257, 0);
+  GLuint ssbo;
+  glGenBuffers(1, &ssbo);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, data.size() * sizeof(GLuint), data.data(), GL_DYNAMIC_COPY);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, ssbo);
+
+  program.Use();
+  glUniform1ui(glGetUniformLocation(program.GetProgramId(), "problemSize"), nProblemSize);
+  program.Dispatch(nProblemSize);
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+  glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, data.size() * sizeof(GLuint), data.data());
+  CHECK(data[0] == 128);
+  for (GLuint i = 0; i < 256; ++i)
+  {
+    INFO("value #" << i);
+    CHECK(data[i + 1] == (i < nProblemSize ? 2 * i : 0));
+  }
+
+  //Indirect dispatch of a batch of records
+  std::fill(data.begin(), data.end(), 0);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, data.size() * sizeof(GLuint), data.data());
+  const GLShaderPP::SDispatchIndirectCommand commands[] = { program.GetDispatchCommand(64), program.GetDispatchCommand(65), program.GetDispatchCommand(1, 1, 1) };
+  GLuint indirectBuffer;
+  glGenBuffers(1, &indirectBuffer);
+  glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, indirectBuffer);
+  glBufferData(GL_DISPATCH_INDIRECT_BUFFER, sizeof(commands), commands, GL_STATIC_DRAW);
+  glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+
+  program.DispatchIndirect(indirectBuffer, 3, 0, sizeof(GLShaderPP::SDispatchIndirectCommand), GL_SHADER_STORAGE_BARRIER_BIT);
+  GLint nBoundIndirectBuffer = -1;
+  glGetIntegerv(GL_DISPATCH_INDIRECT_BUFFER_BINDING, &nBoundIndirectBuffer);
+  CHECK(nBoundIndirectBuffer == 0);
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+  glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), data.data());
+  CHECK(data[0] == (1 + 2 + 1) * 64);
+
+  //Warming up runs one work group on a scratch buffer, and leaves the bound storage buffer untouched
+  GLShaderPP::CProgramWarmer warmer;
+  CHECK(warmer.GetScratchBuffer() == 0);
+  CHECK(warmer.WarmUp(program) > std::chrono::nanoseconds::zero());
+  REQUIRE(warmer.GetScratchBuffer() != 0);
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+  glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), data.data());
+  CHECK(data[0] == (1 + 2 + 1) * 64);
+  GLint nBoundBuffer = 0;
+  glGetIntegerv(GL_SHADER_STORAGE_BUFFER_BINDING, &nBoundBuffer);
+  CHECK(static_cast<GLuint>(nBoundBuffer) == ssbo);
+  glGetIntegeri_v(GL_SHADER_STORAGE_BUFFER_BINDING, 0, &nBoundBuffer);
+  CHECK(static_cast<GLuint>(nBoundBuffer) == ssbo);
+  GLuint scratch[3] = {};
+  glBindBuffer(GL_COPY_READ_BUFFER, warmer.GetScratchBuffer());
+  glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(scratch), scratch);
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  CHECK(scratch[0] == 64);
+  CHECK(scratch[2] == 2);
+  CHECK(glGetError() == GL_NO_ERROR);
+
+  glDeleteBuffers(1, &indirectBuffer);
+  glDeleteBuffers(1, &ssbo);
+
+  glfwTerminate();
+}
+
+TEST_CASE("Measure GPU work by program label", "[gpu-profiler]")
+{
+  constexpr int nWndWidth = 800;
+  constexpr int nWndHeight = 600;
+
+  INFO(initWindow(nWndWidth, nWndHeight));
+
+  GLShaderPP::CShaderProgram program{
+    GLShaderPP::CShader{ GL_VERTEX_SHADER, std::ifstream{ "vertex.vert" } },
+    GLShaderPP::CShader{ GL_FRAGMENT_SHADER, std::ifstream{ "fragment.frag" } }
+  };
+  REQUIRE(program.GetLinkingStatus() == GLShaderPP::CShaderProgram::LinkingStatus::linkingOk);
+  CHECK(program.GetLabel() == "program #" + std::to_string(program.GetProgramId()));
+  program.SetLabel("triangle");
+  CHECK(program.GetLabel() == "triangle");
+
+  GLShaderPP::CGpuProfiler profiler;
+  constexpr int nFrames = 3;
+  for (int i = 0; i < nFrames; ++i)
+  {
+    GLShaderPP::CGpuTimingScope scope(profiler, program);
+    CHECK(GLShaderPP::CStateCache::Current().IsProgramBound(program.GetProgramId()));
+    //A nested scope uses its program but measures nothing
+    GLShaderPP::CGpuTimingScope nested(profiler, program);
+    testTriangle(nWndWidth, nWndHeight);
+  }
+  CHECK(profiler.GetPendingCount() == nFrames);
+  CHECK(profiler.GetStats().empty());
+
+  //Results are read without stalling, so they may need a few polls
+  glFinish();
+  std::size_t nCollected = 0;
+  for (int nPoll = 0; nPoll < 1000 && profiler.GetPendingCount() > 0; ++nPoll)
+    nCollected += profiler.Collect();
+  CHECK(nCollected == nFrames);
+  CHECK(profiler.GetPendingCount() == 0);
+
+  GLShaderPP::CGpuProfiler::SProgramStats stats = profiler.GetStats("triangle");
+  CHECK(stats.nSamples == nFrames);
+  CHECK(stats.gpuTime.count() > 0);
+  if (profiler.HasPipelineStatistics())
+  {
+    CHECK(stats.nVerticesSubmitted == 3 * nFrames);
+    CHECK(stats.nPrimitivesSubmitted == nFrames);
+    CHECK(stats.nFragmentInvocations > 0);
+    CHECK(stats.nComputeInvocations == 0);
+  }
+  else
+    WARN("GL_ARB_pipeline_statistics_query is not supported, only GPU time is measured");
+
+  //Query objects are reused
+  const std::size_t nQueries = profiler.GetQueryCount();
+  {
+    GLShaderPP::CGpuTimingScope scope(profiler, program);
+    testTriangle(nWndWidth, nWndHeight);
+  }
+  CHECK(profiler.GetQueryCount() == nQueries);
+  profiler.ResetStats();
+  CHECK(profiler.GetStats().empty());
+  CHECK(glGetError() == GL_NO_ERROR);
+
+  glfwTerminate();
+}
+
+TEST_CASE("Link a GLSL program from stage-typed shaders", "[typed-shaders]")
+{
+  constexpr int nWndWidth = 800;
+  constexpr int nWndHeight = 600;
+
+  INFO(initWindow(nWndWidth, nWndHeight));
+
+  static_assert(GLShaderPP::CVertexShader::stage == GL_VERTEX_SHADER);
+  static_assert(std::string_view(GLShaderPP::CFragmentShader::stageName) == "fragment");
+  static_assert(GLShaderPP::SStaticStage<GLShaderPP::CShader>::value == 0);
+  static_assert(GLShaderPP::HasDistinctStaticStages<GLShaderPP::CVertexShader, GLShaderPP::CFragmentShader, GLShaderPP::CShader, GLShaderPP::CShader>());
+  static_assert(!GLShaderPP::HasDistinctStaticStages<GLShaderPP::CVertexShader, GLShaderPP::CFragmentShader, GLShaderPP::CVertexShader>());
+  static_assert(GLShaderPP::HasCompatibleStaticStages<GLShaderPP::CComputeShader, GLShaderPP::CShader>());
+  static_assert(!GLShaderPP::HasCompatibleStaticStages<GLShaderPP::CComputeShader, GLShaderPP::CFragmentShader>());
+
+  GLShaderPP::CVertexShader vertex{ std::ifstream{ "vertex.vert" } };
+  GLShaderPP::CFragmentShader fragment{ std::ifstream{ "fragment.frag" } };
+  CHECK(vertex.GetStage() == GL_VERTEX_SHADER);
+  CHECK(vertex.GetType() == "vertex");
+  CHECK(GLShaderPP::CShader{ GL_GEOMETRY_SHADER }.GetType() == "geometry");
+
+  GLShaderPP::CShaderProgram program{ vertex, fragment };
+  REQUIRE(program.GetLinkingStatus() == GLShaderPP::CShaderProgram::LinkingStatus::linkingOk);
+  CHECK(program.HasStage(GL_VERTEX_SHADER));
+  CHECK(program.HasStage(GL_FRAGMENT_SHADER));
+  program.Use();
+  testTriangle(nWndWidth, nWndHeight);
+
+  glfwTerminate();
+}
+
+std::unique_ptr<GLShaderPP::CShaderProgram> makeTriangleProgram()
+{
+  return std::make_unique<GLShaderPP::CShaderProgram>(
+    GLShaderPP::CShader{ GL_VERTEX_SHADER, std::ifstream{ "vertex.vert" } },
+    GLShaderPP::CShader{ GL_FRAGMENT_SHADER, std::ifstream{ "fragment.frag" } }
+  );
+}
+
+TEST_CASE("Look up programs in a registry while they are replaced", "[program-registry]")
+{
+  constexpr int nWndWidth = 800;
+  constexpr int nWndHeight = 600;
+
+  INFO(initWindow(nWndWidth, nWndHeight));
+
+  const std::size_t nInitialPrograms = GLShaderPP::CResourceStats::Get().nPrograms;
+  {
+    GLShaderPP::CProgramRegistry registry;
+    GLShaderPP::CProgramRegistry::CReader reader(registry);
+
+    const GLShaderPP::CProgramRegistry::Handle triangle = registry.Register("triangle", makeTriangleProgram());
+    CHECK(triangle != GLShaderPP::CProgramRegistry::invalidHandle);
+    {
+      auto snapshot = reader.Pin();
+      CHECK(snapshot.GetSize() == 1);
+      CHECK(snapshot.GetHandle("triangle") == triangle);
+      CHECK(snapshot.Find("unknown") == nullptr);
+      REQUIRE(snapshot.Find("triangle") == snapshot.Find(triangle));
+      snapshot.Find(triangle)->Use();
+      testTriangle(nWndWidth, nWndHeight);
+    }
+
+    //A pinned snapshot keeps on seeing the replaced program, which is only deleted once unpinned
+    {
+      auto snapshot = reader.Pin();
+      const GLuint nOldProgram = snapshot.Find(triangle)->GetProgramId();
+      CHECK(registry.Register("triangle", makeTriangleProgram()) == triangle);
+      CHECK(registry.Reclaim() == 0);
+      CHECK(snapshot.Find(triangle)->GetProgramId() == nOldProgram);
+      CHECK(glIsProgram(nOldProgram));
+      CHECK(reader.Pin().Find(triangle)->GetProgramId() != nOldProgram);
+    }
+    CHECK(registry.Reclaim() == 1);
+    CHECK(registry.GetRetiredCount() == 0);
+    CHECK(GLShaderPP::CResourceStats::Get().nPrograms == nInitialPrograms + 1);
+
+    CHECK_FALSE(registry.Replace(triangle + 1, makeTriangleProgram()));
+    CHECK(registry.Remove(triangle));
+    CHECK_FALSE(registry.Remove(triangle));
+    CHECK(reader.Pin().Find("triangle") == nullptr);
+    CHECK(registry.Reclaim() == 1);
+
+    //Concurrent readers, while the program is replaced and reclaimed
+    const GLShaderPP::CProgramRegistry::Handle reloaded = registry.Register("reloaded", makeTriangleProgram());
+    std::atomic<bool> bStop{ false };
+    std::atomic<std::size_t> nMissed{ 0 }, nLookups{ 0 };
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i)
+      readers.emplace_back([&]() {
+        GLShaderPP::CProgramRegistry::CReader threadReader(registry);
+        while (!bStop)
+        {
+          auto snapshot = threadReader.Pin();
+          const GLShaderPP::CShaderProgram* pProgram = snapshot.Find("reloaded");
+          if (!pProgram || pProgram->GetProgramId() == 0)
+            ++nMissed;
+          ++nLookups;
+        }
+      });
+    for (int i = 0; i < 20; ++i)
+    {
+      CHECK(registry.Replace(reloaded, makeTriangleProgram()));
+      registry.Reclaim();
+    }
+    bStop = true;
+    for (std::thread& thread : readers)
+      thread.join();
+    CHECK(nMissed == 0);
+    CHECK(nLookups > 0);
+    registry.Reclaim();
+    CHECK(registry.GetRetiredCount() == 0);
+    CHECK(GLShaderPP::CResourceStats::Get().nPrograms == nInitialPrograms + 1);
+  }
+  CHECK(GLShaderPP::CResourceStats::Get().nPrograms == nInitialPrograms);
+  CHECK(glGetError() == GL_NO_ERROR);
+
+  glfwTerminate();
+}
+
+TEST_CASE("Scale registry lookups with reader threads", "[.][benchmark][program-registry-benchmark]")
+{
+  constexpr int nWndWidth = 800;
+  constexpr int nWndHeight = 600;
+
+  INFO(initWindow(nWndWidth, nWndHeight));
+
+  GLShaderPP::CProgramRegistry registry;
+  constexpr int nPrograms = 16;
+  for (int i = 0; i < nPrograms; ++i)
+    registry.Register("program" + std::to_string(i), makeTriangleProgram());
+  std::vector<std::string> names;
+  for (int i = 0; i < nPrograms; ++i)
+    names.push_back("program" + std::to_string(i));
+
+  //Each reader does the same number of lookups: with lock-free reads, the time stays flat as readers are added
+  constexpr int nLookupsPerReader = 100000;
+  for (unsigned nReaders = 1; nReaders <= std::max(1u, std::thread::hardware_concurrency()); nReaders *= 2)
+  {
+    BENCHMARK(std::to_string(nReaders) + " reader(s)")
+    {
+      std::atomic<std::size_t> nFound{ 0 };
+      std::vector<std::thread> readers;
+      for (unsigned i = 0; i < nReaders; ++i)
+        readers.emplace_back([&]() {
+          GLShaderPP::CProgramRegistry::CReader reader(registry);
+          std::size_t nThreadFound = 0;
+          for (int j = 0; j < nLookupsPerReader; ++j)
+            nThreadFound += reader.Pin().Find(names[j % nPrograms]) != nullptr;
+          nFound += nThreadFound;
+        });
+      for (std::thread& thread : readers)
+        thread.join();
+      return nFound.load();
+    };
+  }
+
+  glfwTerminate();
+}
+
+TEST_CASE("Read GLSL sources from a memory mapped shader pack", "[shader-pack]")
+{
+  constexpr int nWndWidth = 800;
+  constexpr int nWndHeight = 600;
+
+  INFO(initWindow(nWndWidth, nWndHeight));
+
+  static_assert(GLShaderPP::GetStageFromExtension("shaders/sky.vert") == GL_VERTEX_SHADER);
+  static_assert(GLShaderPP::GetStageFromExtension("count.comp") == GL_COMPUTE_SHADER);
+  static_assert(GLShaderPP::GetStageFromExtension("Readme.md") == 0);
+
+  {
+    GLShaderPP::CShaderPackWriter writer;
+    CHECK(writer.Add("vertex.vert", GL_VERTEX_SHADER, readFile("vertex.vert")));
+    CHECK(writer.Add("fragment.frag", GL_FRAGMENT_SHADER, readFile("fragment.frag")));
+    CHECK(writer.Add("count.comp", GL_COMPUTE_SHADER, readFile("count.comp")));
+    CHECK_FALSE(writer.Add("vertex.vert", GL_VERTEX_SHADER, "duplicate"));
+    CHECK(writer.GetSize() == 3);
+    std::ofstream file("test.glsp", std::ios::binary);
+    REQUIRE(writer.Write(file));
+  }
+
+  GLShaderPP::CShaderPackReader pack("test.glsp");
+  REQUIRE(pack.IsOpen());
+  CHECK(pack.GetSize() == 3);
+  CHECK(pack.GetEntry(0).strName == "count.comp");
+  CHECK(pack.VerifyHashes());
+  CHECK_FALSE(pack.Find("missing.vert"));
+
+  auto vertex = pack.Find("vertex.vert");
+  auto fragment = pack.Find("fragment.frag");
+  REQUIRE(vertex);
+  REQUIRE(fragment);
+  CHECK(vertex->nStage == GL_VERTEX_SHADER);
+  CHECK(vertex->strSource == readFile("vertex.vert"));
+  CHECK(vertex->strSource.data()[vertex->strSource.size()] == '\0');
+  CHECK(vertex->nHash == GLShaderPP::Fnv1a64(readFile("vertex.vert")));
+
+  //Sources are given to shaders straight from the mapping
+  GLShaderPP::CShaderProgram program{
+    GLShaderPP::CShader{ vertex->nStage, vertex->strSource },
+    GLShaderPP::CShader{ fragment->nStage, fragment->strSource }
+  };
+  REQUIRE(program.GetLinkingStatus() == GLShaderPP::CShaderProgram::LinkingStatus::linkingOk);
+  program.Use();
+  testTriangle(nWndWidth, nWndHeight);
+
+  //Malformed packs are rejected
+  {
+    std::ofstream file("bad.glsp", std::ios::binary);
+    file << "This is not a shader pack";
+  }
+  GLShaderPP::CBasicShaderPackReader<GLShaderPP::CStatusErrorPolicy> badPack("bad.glsp");
+  CHECK_FALSE(badPack.IsOpen());
+  CHECK_FALSE(badPack.Open("missing.glsp"));
+  try
+  {
+    GLShaderPP::CShaderPackReader throwingPack("bad.glsp");
+    FAIL("No exception thrown for a malformed shader pack");
+  }
+  catch (const GLShaderPP::CShaderException& e)
+  {
+    CHECK(e.type() == GLShaderPP::CShaderException::ExceptionType::BadShaderPack);
+  }
+
+  glfwTerminate();
+}
+
+TEST_CASE("Restore program reflection from a cache directory", "[program-reflection]")
+{
+  constexpr int nWndWidth = 800;
+  constexpr int nWndHeight = 600;
+
+  INFO(initWindow(nWndWidth, nWndHeight));
+
+  if (!isGLVersionAtLeast(4, 3))
+  {
+    WARN("Program interface queries need OpenGL 4.3");
+    glfwTerminate();
+    return;
+  }
+
+  const std::string strVertex = R"(#version 430 core
+layout(location = 0) in vec2 position;
+layout(location = 1) in vec3 inputcolor;
+layout(std140, binding = 2) uniform Transform { mat4 model; vec4 tint; };
+uniform vec2 offsets[3];
+out vec3 color;
+void main()
+{
+  gl_Position = model * vec4(position + offsets[gl_InstanceID], 0.0f, 1.0f);
+  color = inputcolor * tint.rgb;
+})";
+  const std::string strFragment = R"(#version 430 core
+in vec3 color;
+uniform float intensity;
+out vec4 fragColor;
+void main()
+{
+  fragColor = vec4(color * intensity, 1.0f);
+})";
+
+  GLShaderPP::CShaderProgram program{
+    GLShaderPP::CVertexShader{ strVertex },
+    GLShaderPP::CFragmentShader{ strFragment }
+  };
+  REQUIRE(program.GetLinkingStatus() == GLShaderPP::CShaderProgram::LinkingStatus::linkingOk);
+
+  const GLShaderPP::CProgramReflection queried = GLShaderPP::CProgramReflection::Query(program);
+  CHECK(queried.GetAttribLocation("position") == 0);
+  CHECK(queried.GetAttribLocation("inputcolor") == 1);
+  CHECK(queried.GetUniformLocation("intensity") == glGetUniformLocation(program.GetProgramId(), "intensity"));
+  REQUIRE(queried.FindUniform("offsets[0]"));
+  CHECK(queried.FindUniform("offsets[0]")->nArraySize == 3);
+  CHECK(queried.FindUniform("offsets[0]")->eType == GL_FLOAT_VEC2);
+  REQUIRE(queried.FindUniform("model"));
+  CHECK(queried.FindUniform("model")->nLocation == -1);
+  REQUIRE(queried.GetUniformBlocks().size() == 1);
+  CHECK(queried.GetUniformBlocks()[0].strName == "Transform");
+  CHECK(queried.GetUniformBlocks()[0].nBinding == 2);
+  CHECK(queried.GetUniformBlocks()[0].nDataSize >= 80);
+  CHECK(queried.FindUniform("model")->nBlockIndex == 0);
+  CHECK(queried.Matches(program));
+
+  const std::uint64_t nKey = GLShaderPP::ComputeProgramKey({ strVertex, strFragment });
+  CHECK(nKey != GLShaderPP::ComputeProgramKey({ strFragment, strVertex }));
+  std::filesystem::remove_all("reflection-cache");
+
+  //Cold start: the reflection is queried and stored
+  {
+    GLShaderPP::CReflectionCache cache("reflection-cache");
+    cache.GetReflection(program, nKey);
+    CHECK(cache.GetMissCount() == 1);
+    CHECK(std::filesystem::exists(cache.GetPath(nKey)));
+  }
+
+  //Warm start: the reflection is restored without queries
+  {
+    GLShaderPP::CReflectionCache cache("reflection-cache");
+    const GLShaderPP::CProgramReflection restored = cache.GetReflection(program, nKey);
+    CHECK(cache.GetHitCount() == 1);
+    CHECK(cache.GetMissCount() == 0);
+    REQUIRE(restored.GetUniforms().size() == queried.GetUniforms().size());
+    REQUIRE(restored.GetAttributes().size() == queried.GetAttributes().size());
+    for (const auto& uniform : queried.GetUniforms())
+    {
+      const auto* pRestored = restored.FindUniform(uniform.strName);
+      REQUIRE(pRestored);
+      CHECK(pRestored->nLocation == uniform.nLocation);
+      CHECK(pRestored->eType == uniform.eType);
+      CHECK(pRestored->nArraySize == uniform.nArraySize);
+      CHECK(pRestored->nBlockIndex == uniform.nBlockIndex);
+    }
+    CHECK(restored.GetUniformBlocks()[0].nDataSize == queried.GetUniformBlocks()[0].nDataSize);
+    CHECK(restored.Matches(program));
+
+    //Stale or corrupted data is queried again
+    CHECK_FALSE(cache.Load(nKey + 1));
+    {
+      std::fstream file(cache.GetPath(nKey), std::ios::in | std::ios::out | std::ios::binary);
+      file.seekp(20);
+      file.put('\x7f');
+    }
+    CHECK_FALSE(cache.Load(nKey));
+    cache.GetReflection(program, nKey);
+    CHECK(cache.GetMissCount() == 1);
+    CHECK(cache.Load(nKey));
+  }
+
+  //Concurrent writers of the same key use distinct temporary files, and leave a single valid reflection
+  {
+    GLShaderPP::CReflectionCache cache("reflection-cache");
+    std::vector<std::thread> writers;
+    std::atomic<int> nStored{ 0 };
+    for (int i = 0; i < 4; ++i)
+      writers.emplace_back([&cache, &queried, &nStored, nKey]() {
+        for (int j = 0; j < 25; ++j)
+          nStored += cache.Store(nKey, queried) ? 1 : 0;
+      });
+    for (std::thread& writer : writers)
+      writer.join();
+    CHECK(nStored == 100);
+    CHECK(cache.Load(nKey));
+    CHECK(std::distance(std::filesystem::directory_iterator("reflection-cache"), std::filesystem::directory_iterator()) == 1);
+  }
+
+  glfwTerminate();
+}
+
+TEST_CASE("Prepare GLSL sources on worker threads", "[source-pipeline]")
+{
+  constexpr int nWndWidth = 800;
+  constexpr int nWndHeight = 600;
+
+  INFO(initWindow(nWndWidth, nWndHeight));
+
+  std::filesystem::create_directories("pipeline/include");
+  std::ofstream("pipeline/include/common.glsl") << "#include \"common.glsl\"\nvec3 passThrough(vec3 c) { return c * SCALE; }\n";
+  std::ofstream("pipeline/triangle.frag") << "#version 330 core\n  #include \"common.glsl\"\nin vec3 color;\nout vec4 fragColor;\nvoid main()\n{\n  fragColor = vec4(passThrough(color), 1.0f);\n}\n";
+  std::ofstream("pipeline/faulty.frag") << "#version 330 core\n#include \"missing.glsl\"\n";
+  std::ofstream("pipeline/commented.frag") << "// A header comment\n/* A block\n   comment */\n#version 330 core\n#include \"common.glsl\"\nout vec4 fragColor;\nvoid main() { fragColor = vec4(undefinedColor, 1.0f); }\n";
+
+  GLShaderPP::CSourcePipeline pipeline(4);
+  CHECK(pipeline.GetThreadCount() == 4);
+  pipeline.AddIncludeDirectory("pipeline/include");
+  pipeline.AddDefine("SCALE", "1.0f");
+  pipeline.Submit("vertex.vert", GL_VERTEX_SHADER);
+  pipeline.Submit("pipeline/triangle.frag", GL_FRAGMENT_SHADER);
+  pipeline.Submit("pipeline/faulty.frag", GL_FRAGMENT_SHADER);
+  pipeline.Submit("pipeline/commented.frag", GL_FRAGMENT_SHADER);
+  pipeline.Wait();
+  CHECK(pipeline.GetPendingCount() == 0);
+
+  std::map<std::string, GLShaderPP::CSourcePipeline::SPreparedSource> sources;
+  for (auto& source : pipeline.TakeReady())
+    sources[source.strName] = std::move(source);
+  REQUIRE(sources.size() == 4);
+  CHECK(pipeline.TakeReady().empty());
+
+  const auto& vertex = sources["vertex.vert"];
+  const auto& fragment = sources["pipeline/triangle.frag"];
+  const auto& faulty = sources["pipeline/faulty.frag"];
+  REQUIRE(vertex.bOk);
+  REQUIRE(fragment.bOk);
+  CHECK_FALSE(faulty.bOk);
+  CHECK(faulty.strError.find("missing.glsl") != std::string::npos);
+  CHECK(vertex.nStage == GL_VERTEX_SHADER);
+  CHECK(vertex.nHash == GLShaderPP::Fnv1a64(vertex.strSource));
+  CHECK(fragment.strSource.rfind("#version 330 core\n#define SCALE 1.0f\n#line 2 0\n", 0) == 0);
+  CHECK(fragment.strSource.find("#include") == std::string::npos);
+  CHECK(fragment.strSource.find("#line 1 1\n\nvec3 passThrough(vec3 c)") != std::string::npos);
+  CHECK(fragment.strSource.find("#line 3 0\nin vec3 color;") != std::string::npos);
+  CHECK(fragment.files == std::vector<std::string>{ "pipeline/triangle.frag", "pipeline/include/common.glsl" });
+
+  //Defines follow a #version directive preceded by comments, and compiler errors give the lines of the files
+  const auto& commented = sources["pipeline/commented.frag"];
+  REQUIRE(commented.bOk);
+  CHECK(commented.strSource.find("comment */\n#version 330 core\n#define SCALE 1.0f\n#line 5 0\n#line 1 1\n") != std::string::npos);
+  CHECK(commented.strSource.find("#line 6 0\nout vec4 fragColor;") != std::string::npos);
+  {
+    const GLuint nShader = glCreateShader(GL_FRAGMENT_SHADER);
+    const char* pSource = commented.strSource.c_str();
+    glShaderSource(nShader, 1, &pSource, nullptr);
+    glCompileShader(nShader);
+    GLint nStatus = GL_TRUE, nLength = 0;
+    glGetShaderiv(nShader, GL_COMPILE_STATUS, &nStatus);
+    glGetShaderiv(nShader, GL_INFO_LOG_LENGTH, &nLength);
+    std::string strLog(std::max(nLength, 1), '\0');
+    glGetShaderInfoLog(nShader, nLength, nullptr, strLog.data());
+    glDeleteShader(nShader);
+    CHECK(nStatus == GL_FALSE);
+    INFO(strLog);
+    CHECK((strLog.find("0:7(") != std::string::npos || strLog.find("0(7)") != std::string::npos));
+  }
+
+  //An exception thrown while preparing a source is reported, and the pipeline goes on
+  {
+    GLShaderPP::CSourcePipeline throwing(2);
+    throwing.SetLoader([](const std::string& strPath) -> std::optional<std::string> {
+      if (strPath == "throwing.frag")
+        throw std::runtime_error("loader failure");
+      return std::string("#version 330 core\n");
+      });
+    throwing.Submit("throwing.frag", GL_FRAGMENT_SHADER);
+    throwing.Submit("other.frag", GL_FRAGMENT_SHADER);
+    throwing.Wait();
+    CHECK(throwing.GetPendingCount() == 0);
+    std::map<std::string, GLShaderPP::CSourcePipeline::SPreparedSource> prepared;
+    for (auto& source : throwing.TakeReady())
+      prepared[source.strName] = std::move(source);
+    REQUIRE(prepared.size() == 2);
+    CHECK_FALSE(prepared["throwing.frag"].bOk);
+    CHECK(prepared["throwing.frag"].strError.find("loader failure") != std::string::npos);
+    CHECK(prepared["other.frag"].bOk);
+  }
+
+  //Thread pool tasks give back their results and exceptions
+  {
+    GLShaderPP::CThreadPool pool(2);
+    std::future<int> value = pool.Submit([]() { return 42; });
+    std::future<void> failure = pool.Submit([]() { throw std::runtime_error("task failure"); });
+    CHECK(value.get() == 42);
+    CHECK_THROWS_WITH(failure.get(), "task failure");
+    pool.WaitIdle();
+    CHECK(pool.GetPendingCount() == 0);
+  }
+
+  //The OpenGL thread only gives prepared sources to shaders
+  GLShaderPP::CShaderProgram program{
+    GLShaderPP::CShader{ vertex.nStage, vertex.strSource },
+    GLShaderPP::CShader{ fragment.nStage, fragment.strSource }
+  };
+  REQUIRE(program.GetLinkingStatus() == GLShaderPP::CShaderProgram::LinkingStatus::linkingOk);
+  program.Use();
+  testTriangle(nWndWidth, nWndHeight);
+
+  //Batches bound the work of the OpenGL thread
+  for (int i = 0; i < 100; ++i)
+    pipeline.Submit("vertex.vert", GL_VERTEX_SHADER);
+  pipeline.Wait();
+  CHECK(pipeline.TakeReady(40).size() == 40);
+  CHECK(pipeline.TakeReady(40).size() == 40);
+  CHECK(pipeline.TakeReady(40).size() == 20);
+
+  glfwTerminate();
+}
+
+TEST_CASE("Scale source preparation with worker threads", "[.][benchmark][source-pipeline-benchmark]")
+{
+  //A corpus of shaders sharing a large include, like those of an engine
+  constexpr int nShaders = 4000;
+  std::filesystem::create_directories("pipeline-corpus");
+  {
+    std::ofstream library("pipeline-corpus/library.glsl");
+    for (int i = 0; i < 200; ++i)
+      library << "float function" << i << "(float x) { return x * " << i << ".0f + LIGHT_COUNT; }\n";
+  }
+  for (int i = 0; i < nShaders; ++i)
+    std::ofstream("pipeline-corpus/shader" + std::to_string(i) + ".frag")
+      << "#version 330 core\n#include \"library.glsl\"\nout vec4 fragColor;\nvoid main()\n{\n  fragColor = vec4(function" << i % 200 << "(1.0f));\n}\n";
+
+  for (unsigned nThreads = 1; nThreads <= std::max(1u, std::thread::hardware_concurrency()); nThreads *= 2)
+  {
+    GLShaderPP::CSourcePipeline pipeline(nThreads);
+    pipeline.AddDefine("LIGHT_COUNT", "16");
+    BENCHMARK(std::to_string(nThreads) + " worker thread(s)")
+    {
+      for (int i = 0; i < nShaders; ++i)
+        pipeline.Submit("pipeline-corpus/shader" + std::to_string(i) + ".frag", GL_FRAGMENT_SHADER);
+      pipeline.Wait();
+      return pipeline.TakeReady().size();
+    };
+  }
+}
+
+TEST_CASE("Set uniforms of programs without binding them", "[uniform-setters]")
+{
+  constexpr int nWndWidth = 800;
+  constexpr int nWndHeight = 600;
+  constexpr int nPrograms = 16;
+
+  INFO(initWindow(nWndWidth, nWndHeight));
+
+  std::vector<GLShaderPP::CShaderProgram> programs;
+  for (int i = 0; i < nPrograms; ++i)
+  {
+    programs.emplace_back(
+      GLShaderPP::CShader{ GL_VERTEX_SHADER, std::ifstream{ "vertex.vert" } },
+      GLShaderPP::CShader{ GL_FRAGMENT_SHADER, std::ifstream{ "uniforms.frag" } }
+    );
+    REQUIRE(programs.back().GetLinkingStatus() == GLShaderPP::CShaderProgram::LinkingStatus::linkingOk);
+  }
+  GLShaderPP::CShaderProgram bound{
+    GLShaderPP::CShader{ GL_VERTEX_SHADER, std::ifstream{ "vertex.vert" } },
+    GLShaderPP::CShader{ GL_FRAGMENT_SHADER, std::ifstream{ "fragment.frag" } }
+  };
+  bound.Use();
+  GLShaderPP::CStateCache& cache = GLShaderPP::CStateCache::Current();
+  cache.ResetCounters();
+
+  //Material setup of every program, with values of several types
+  const std::array<GLfloat, 16> identity{ 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f };
+  const GLfloat weights[3] = { 0.25f, 0.25f, 0.5f };
+  for (GLShaderPP::CShaderProgram& program : programs)
+  {
+    GLShaderPP::CUniformBatch batch;
+    batch.Set(program.GetUniformLocation("tint"), std::array<GLfloat, 3>{ 1.f, 1.f, 1.f });
+    batch.Set(program.GetUniformLocation("mode"), 1);
+    batch.Set(program.GetUniformLocation("flags"), std::array<GLuint, 2>{ 3u, 3u });
+    batch.Set(program.GetUniformLocation("colorTransform"), identity);
+    batch.Set(program.GetUniformLocation("unknown"), 1.f);
+    batch.SetArray(program.GetUniformLocation("weights"), weights, 3);
+    CHECK(batch.GetSize() == 7);
+    program.SetUniforms(batch);
+    program.SetUniforms(std::vector<std::pair<GLint, GLfloat>>{ { program.GetUniformLocation("brightness"), 1.f } });
+    program.SetUniformArray(program.GetUniformLocation("weights"), weights, 3);
+  }
+
+  GLint nCurrentProgram = 0;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &nCurrentProgram);
+  CHECK(GLShaderPP::IsProgramUniformSupported() == (cache.IsGLVersionAtLeast(4, 1) || cache.IsSeparateShaderObjectsSupported()));
+  if (GLShaderPP::IsProgramUniformSupported())
+  {
+    CHECK(cache.GetBindsIssued() == 0);
+    CHECK(static_cast<GLuint>(nCurrentProgram) == bound.GetProgramId());
+  }
+  else
+    WARN("glProgramUniform needs OpenGL 4.1 or GL_ARB_separate_shader_objects, programs have been bound");
+
+  //Values are read back from the last program
+  GLShaderPP::CShaderProgram& last = programs.back();
+  GLfloat tint[3] = {};
+  glGetUniformfv(last.GetProgramId(), last.GetUniformLocation("tint"), tint);
+  CHECK(tint[2] == 1.f);
+  GLint nMode = 0;
+  glGetUniformiv(last.GetProgramId(), last.GetUniformLocation("mode"), &nMode);
+  CHECK(nMode == 1);
+  GLuint flags[2] = {};
+  glGetUniformuiv(last.GetProgramId(), last.GetUniformLocation("flags"), flags);
+  CHECK(flags[1] == 3u);
+  GLfloat fWeight = 0.f;
+  glGetUniformfv(last.GetProgramId(), last.GetUniformLocation("weights[2]"), &fWeight);
+  CHECK(fWeight == 0.5f);
+
+  //A range of array elements is set by one call, from any element
+  {
+    const GLfloat halves[2] = { 0.125f, 0.125f };
+    GLShaderPP::CUniformBatch batch;
+    batch.SetArray(last.GetUniformLocation("weights[1]"), halves, 2);
+    last.SetUniforms(batch);
+    glGetUniformfv(last.GetProgramId(), last.GetUniformLocation("weights[0]"), &fWeight);
+    CHECK(fWeight == 0.25f);
+    glGetUniformfv(last.GetProgramId(), last.GetUniformLocation("weights[2]"), &fWeight);
+    CHECK(fWeight == 0.125f);
+    batch.Clear();
+    CHECK(batch.GetSize() == 0);
+  }
+
+  //A single value, set after the program has been bound elsewhere
+  last.SetUniform(last.GetUniformLocation("brightness"), 0.5f);
+  GLfloat fBrightness = 0.f;
+  glGetUniformfv(last.GetProgramId(), last.GetUniformLocation("brightness"), &fBrightness);
+  CHECK(fBrightness == 0.5f);
+
+  //The fallback path binds back the previous program, even if it was bound by raw OpenGL calls
+  glUseProgram(bound.GetProgramId());
+  cache.Invalidate();
+  {
+    GLShaderPP::CScopedProgramBinding binding(last.GetProgramId());
+    glGetIntegerv(GL_CURRENT_PROGRAM, &nCurrentProgram);
+    CHECK(static_cast<GLuint>(nCurrentProgram) == last.GetProgramId());
+    const GLfloat fDimmed = 0.25f;
+    GLShaderPP::SetBoundProgramUniform(last.GetUniformLocation("brightness"), 1, &fDimmed);
+    {
+      //Nested bindings of the same program do nothing
+      GLShaderPP::CScopedProgramBinding nested(last.GetProgramId());
+      CHECK(cache.IsProgramBound(last.GetProgramId()));
+    }
+    CHECK(cache.IsProgramBound(last.GetProgramId()));
+  }
+  glGetIntegerv(GL_CURRENT_PROGRAM, &nCurrentProgram);
+  CHECK(static_cast<GLuint>(nCurrentProgram) == bound.GetProgramId());
+  CHECK(cache.IsProgramBound(bound.GetProgramId()));
+  glGetUniformfv(last.GetProgramId(), last.GetUniformLocation("brightness"), &fBrightness);
+  CHECK(fBrightness == 0.25f);
+  last.SetUniform(last.GetUniformLocation("brightness"), 1.f);
+
+  //These uniforms leave colors unchanged
+  programs.front().Use();
+  testTriangle(nWndWidth, nWndHeight);
+
+  glfwTerminate();
+}
+
+TEST_CASE("Report size and complexity of programs against a baseline", "[program-report]")
+{
+  constexpr int nWndWidth = 800;
+  constexpr int nWndHeight = 600;
+
+  INFO(initWindow(nWndWidth, nWndHeight));
+
+  using Milliseconds = std::chrono::duration<double, std::milli>;
+  GLShaderPP::CProgramReport report;
+  report.RecordDriver();
+  CHECK_FALSE(report.GetDriver().empty());
+  for (const char* pFragment : { "fragment.frag", "uniforms.frag" })
+  {
+    const auto start = std::chrono::steady_clock::now();
+    GLShaderPP::CShader vertex{ GL_VERTEX_SHADER, std::ifstream{ "vertex.vert" } };
+    GLShaderPP::CShader fragment{ GL_FRAGMENT_SHADER, std::ifstream{ pFragment } };
+    const auto compiled = std::chrono::steady_clock::now();
+    GLShaderPP::CShaderProgram program{ vertex, fragment };
+    const auto linked = std::chrono::steady_clock::now();
+    REQUIRE(program.GetLinkingStatus() == GLShaderPP::CShaderProgram::LinkingStatus::linkingOk);
+    report.Record(pFragment, program, Milliseconds(compiled - start).count(), Milliseconds(linked - compiled).count());
+  }
+  const GLShaderPP::SProgramMetrics* pMetrics = report.Find("uniforms.frag");
+  REQUIRE(pMetrics);
+  CHECK(pMetrics->nActiveUniforms == 6);
+  CHECK(pMetrics->nActiveAttributes == 2);
+  CHECK(pMetrics->nUniformBlocks == 0);
+  CHECK(pMetrics->dLinkMilliseconds > 0.);
+  if (isGLVersionAtLeast(4, 1))
+    CHECK(pMetrics->nBinarySize > 0);
+
+  //The JSON report is read back and written again identically
+  std::stringstream json;
+  REQUIRE(report.WriteJson(json));
+  std::optional<GLShaderPP::CProgramReport> baseline = GLShaderPP::CProgramReport::ReadJson(json);
+  REQUIRE(baseline);
+  CHECK(baseline->GetDriver() == report.GetDriver());
+  std::ostringstream rewritten;
+  baseline->WriteJson(rewritten);
+  CHECK(rewritten.str() == json.str());
+  CHECK(report.Compare(*baseline).empty());
+
+  //A program which grew since its baseline
+  GLShaderPP::SProgramMetrics smaller = *pMetrics;
+  smaller.nBinarySize /= 2;
+  smaller.nActiveUniforms = 2;
+  baseline->Record("uniforms.frag", smaller);
+  std::vector<GLShaderPP::SRegression> regressions = report.Compare(*baseline);
+  REQUIRE(regressions.size() == (pMetrics->nBinarySize > 0 ? 2 : 1));
+  CHECK(regressions.back().strProgram == "uniforms.frag");
+  CHECK(regressions.back().strMetric == "activeUniforms");
+  CHECK(regressions.back().dBaseline == 2.);
+  CHECK(report.Compare(*baseline, { 1.5, 3., 0.5, 2. }).empty());
+
+  //Durations regress beyond their ratio and their minimum growth
+  GLShaderPP::CProgramReport timings, timingsBaseline;
+  timings.Record("slow \"link\"", { 0, 0, 0, 0, 10., 20. });
+  timings.Record("tiny", { 0, 0, 0, 0, 1., 1.5 });
+  timingsBaseline.Record("slow \"link\"", { 0, 0, 0, 0, 9., 5. });
+  timingsBaseline.Record("tiny", { 0, 0, 0, 0, 0.1, 0.1 });
+  regressions = timings.Compare(timingsBaseline);
+  REQUIRE(regressions.size() == 1);
+  CHECK(regressions.front().strProgram == "slow \"link\"");
+  CHECK(regressions.front().strMetric == "linkMilliseconds");
+
+  //Unknown keys are skipped, invalid reports are rejected
+  std::istringstream extended(R"({ "format": "glshaderpp-program-report", "version": 1, "extra": [ { "a": null }, true ],
+    "programs": [ { "name": "a\tb", "binarySize": 12, "future": "x", "linkMilliseconds": 1.5e1 } ] })");
+  std::optional<GLShaderPP::CProgramReport> extendedReport = GLShaderPP::CProgramReport::ReadJson(extended);
+  REQUIRE(extendedReport);
+  REQUIRE(extendedReport->Find("a\tb"));
+  CHECK(extendedReport->Find("a\tb")->nBinarySize == 12);
+  CHECK(extendedReport->Find("a\tb")->dLinkMilliseconds == 15.);
+  std::istringstream truncated(json.str().substr(0, json.str().size() / 2));
+  CHECK_FALSE(GLShaderPP::CProgramReport::ReadJson(truncated));
+  std::istringstream otherFormat(R"({ "format": "other", "version": 1, "programs": [] })");
+  CHECK_FALSE(GLShaderPP::CProgramReport::ReadJson(otherFormat));
+
+  glfwTerminate();
+}
+
+#ifdef __cpp_impl_coroutine
+//A minimal eagerly started coroutine type, only used to test BuildProgramAsync()
+struct SDetachedTask
+{
+  struct promise_type
+  {
+    SDetachedTask get_return_object() { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+//An executor which queues coroutines to resume them later
+struct SQueueExecutor
+{
+  std::vector<std::coroutine_handle<>>* pQueue;
+  void operator()(std::coroutine_handle<> h) const { pQueue->push_back(h); }
+};
+
+SDetachedTask buildProgramTask(GLShaderPP::CBuildPoller& poller, SQueueExecutor executor, std::unique_ptr<GLShaderPP::CShaderProgram>& pProgram)
+{
+  pProgram = co_await GLShaderPP::BuildProgramAsync(poller, executor,
+    GLShaderPP::CProgramBuilder{}.AddStage(GL_VERTEX_SHADER, readFile("vertex.vert")).AddStage(GL_FRAGMENT_SHADER, readFile("fragment.frag")));
+}
+
+SDetachedTask buildFaultyProgramTask(GLShaderPP::CBuildPoller& poller, bool& bThrown)
+{
+  try
+  {
+    co_await GLShaderPP::BuildProgramAsync(poller,
+      GLShaderPP::CProgramBuilder{}.AddStage(GL_VERTEX_SHADER, "This shader won't compile"s).AddStage(GL_FRAGMENT_SHADER, readFile("fragment.frag")));
+  }
+  catch (const GLShaderPP::CShaderException& e)
+  {
+    bThrown = e.type() == GLShaderPP::CShaderException::ExceptionType::CompilationError;
+  }
+}
+
+SDetachedTask buildSilentFaultyProgramTask(GLShaderPP::CBuildPoller& poller, bool& bResumed, bool& bNull)
+{
+  auto pProgram = co_await GLShaderPP::BuildProgramAsync(poller,
+    GLShaderPP::CBasicProgramBuilder<GLShaderPP::CStatusErrorPolicy>{}.AddStage(GL_VERTEX_SHADER, "This shader won't compile"s).AddStage(GL_FRAGMENT_SHADER, readFile("fragment.frag")));
+  bResumed = true;
+  bNull = pProgram == nullptr;
+}
+
+TEST_CASE("Build GLSL programs by awaiting them in coroutines", "[async-program]")
+{
+  constexpr int nWndWidth = 800;
+  constexpr int nWndHeight = 600;
+
+  INFO(initWindow(nWndWidth, nWndHeight));
+
+  GLShaderPP::CBuildPoller poller;
+  std::vector<std::coroutine_handle<>> queue;
+  std::unique_ptr<GLShaderPP::CShaderProgram> pProgram1, pProgram2;
+  bool bThrown = false;
+
+  buildProgramTask(poller, { &queue }, pProgram1);
+  buildProgramTask(poller, { &queue }, pProgram2);
+  buildFaultyProgramTask(poller, bThrown);
+  CHECK_FALSE(poller.IsIdle());
+
+  std::size_t nFinished = 0;
+  while (!poller.IsIdle())
+    nFinished += poller.Poll();
+  CHECK(nFinished == 3);
+  CHECK(bThrown);
+
+  //Without exceptions, a failed build resumes the coroutine with nullptr
+  bool bResumed = false, bNull = false;
+  buildSilentFaultyProgramTask(poller, bResumed, bNull);
+  while (!poller.IsIdle())
+    poller.Poll();
+  CHECK(bResumed);
+  CHECK(bNull);
+
+  //Programs are only given once the executor resumes the coroutines
+  CHECK(pProgram1 == nullptr);
+  REQUIRE(queue.size() == 2);
+  for (std::coroutine_handle<> h : queue)
+    h.resume();
+
+  REQUIRE(pProgram1 != nullptr);
+  REQUIRE(pProgram2 != nullptr);
+  CHECK(pProgram2->GetLinkingStatus() == GLShaderPP::CShaderProgram::LinkingStatus::linkingOk);
+  REQUIRE(pProgram1->GetLinkingStatus() == GLShaderPP::CShaderProgram::LinkingStatus::linkingOk);
+  pProgram1->Use();
+
+  testTriangle(nWndWidth, nWndHeight);
+
+  glfwTerminate();
+}
+#endif
+
 const char* GetGLErrorString()
 {
   switch (glGetError())
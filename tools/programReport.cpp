@@ -0,0 +1,200 @@
+/*****************************************************************//**
+ * \file      programReport.cpp
+ * \brief     Command line tool reporting size and complexity of GLSL programs
+ *
+ * Usage: <tt>programReport [-o report.json] [-b baseline.json] [-s ratio] [-n ratio] [-t ratio] [-m milliseconds]
+ * name=file[,file...]...</tt>
+ *
+ * Each \c name=files argument builds a program from GLSL files, whose stages are deduced from their extensions
+ * (see GLShaderPP::GetStageFromExtension()), on a hidden window of the default OpenGL driver. The metrics of the
+ * programs are written in JSON to \c report.json, or to the standard output. If a baseline report is given, the
+ * metrics which grew beyond their thresholds are listed, and the exit code is 1, so that continuous integration
+ * jobs fail on shader regressions. Thresholds are the allowed relative growths of binary sizes (\c -s), of
+ * uniform, attribute and block counts (\c -n), and of compile and link durations (\c -t), and the minimum
+ * growth of durations to report (\c -m), see GLShaderPP::SReportThresholds.
+ *
+ * \author    Benjamin ALBOUY-KISSI
+ * \date      2022
+ * \copyright GNU Lesser Public License v3
+ *********************************************************************/
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <GLShaderPP/ProgramReport.h>
+#include <GLShaderPP/ShaderPack.h>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+
+namespace {
+
+  using ReportShader = GLShaderPP::CBasicShader<GLShaderPP::CStderrErrorPolicy>;
+  using ReportProgram = GLShaderPP::CBasicShaderProgram<GLShaderPP::CStderrErrorPolicy>;
+  using Milliseconds = std::chrono::duration<double, std::milli>;
+
+  int usage()
+  {
+    std::cerr << "Usage: programReport [-o report.json] [-b baseline.json] [-s ratio] [-n ratio] [-t ratio] [-m milliseconds]\n"
+                 "                     name=file[,file...]...\n";
+    return 2;
+  }
+
+  //Builds a trivial program, so that the one time initialization of the driver compiler is not measured with the first program
+  void warmUpDriver()
+  {
+    ReportShader vertex(GL_VERTEX_SHADER, "#version 330 core\nvoid main() { gl_Position = vec4(0.0f); }\n");
+    ReportShader fragment(GL_FRAGMENT_SHADER, "#version 330 core\nout vec4 color;\nvoid main() { color = vec4(1.0f); }\n");
+    ReportProgram program(vertex, fragment);
+  }
+
+  //Builds a program from the files of a name=files argument and records its metrics
+  bool build(const std::string& strArgument, GLShaderPP::CProgramReport& report)
+  {
+    const std::size_t nEqual = strArgument.find('=');
+    if (nEqual == 0 || nEqual == std::string::npos || nEqual + 1 == strArgument.size())
+    {
+      std::cerr << "Error: \"" << strArgument << "\" is not a name=file[,file...] argument\n";
+      return false;
+    }
+    const std::string strName = strArgument.substr(0, nEqual);
+
+    std::vector<std::pair<GLenum, std::string>> sources;
+    std::istringstream files(strArgument.substr(nEqual + 1));
+    for (std::string strFile; std::getline(files, strFile, ',');)
+    {
+      const GLenum eStage = GLShaderPP::GetStageFromExtension(strFile);
+      std::ifstream file(strFile, std::ios::binary);
+      if (eStage == 0 || !file)
+      {
+        std::cerr << "Error: cannot read \"" << strFile << "\" or deduce its stage\n";
+        return false;
+      }
+      std::stringstream source;
+      source << file.rdbuf();
+      sources.emplace_back(eStage, source.str());
+    }
+
+    std::vector<std::unique_ptr<ReportShader>> shaders;
+    const auto start = std::chrono::steady_clock::now();
+    for (const auto& [eStage, strSource] : sources)
+      shaders.push_back(std::make_unique<ReportShader>(eStage, strSource));
+    const auto compiled = std::chrono::steady_clock::now();
+    ReportProgram program;
+    for (const std::unique_ptr<ReportShader>& pShader : shaders)
+      program.AttachShader(*pShader);
+    program.Link();
+    const auto linked = std::chrono::steady_clock::now();
+    if (program.GetLinkingStatus() != ReportProgram::LinkingStatus::linkingOk)
+    {
+      std::cerr << "Error: program \"" << strName << "\" cannot be built\n";
+      return false;
+    }
+    report.Record(strName, program, Milliseconds(compiled - start).count(), Milliseconds(linked - compiled).count());
+    return true;
+  }
+
+}
+
+int main(int argc, char** argv)
+{
+  std::string strOutput, strBaseline;
+  GLShaderPP::SReportThresholds thresholds;
+  std::vector<std::string> programs;
+  for (int i = 1; i < argc; ++i)
+  {
+    const bool bHasValue = i + 1 < argc;
+    if (bHasValue && std::strcmp(argv[i], "-o") == 0)
+      strOutput = argv[++i];
+    else if (bHasValue && std::strcmp(argv[i], "-b") == 0)
+      strBaseline = argv[++i];
+    else if (bHasValue && std::strcmp(argv[i], "-s") == 0)
+      thresholds.dBinarySize = std::atof(argv[++i]);
+    else if (bHasValue && std::strcmp(argv[i], "-n") == 0)
+      thresholds.dCounts = std::atof(argv[++i]);
+    else if (bHasValue && std::strcmp(argv[i], "-t") == 0)
+      thresholds.dDurations = std::atof(argv[++i]);
+    else if (bHasValue && std::strcmp(argv[i], "-m") == 0)
+      thresholds.dMinimumMilliseconds = std::atof(argv[++i]);
+    else if (argv[i][0] == '-')
+      return usage();
+    else
+      programs.push_back(argv[i]);
+  }
+  if (programs.empty())
+    return usage();
+
+  std::optional<GLShaderPP::CProgramReport> baseline;
+  if (!strBaseline.empty())
+  {
+    std::ifstream file(strBaseline, std::ios::binary);
+    baseline = GLShaderPP::CProgramReport::ReadJson(file);
+    if (!baseline)
+    {
+      std::cerr << "Error: \"" << strBaseline << "\" is not a program report\n";
+      return 1;
+    }
+  }
+
+  if (glfwInit() != GLFW_TRUE)
+  {
+    std::cerr << "Error: cannot initialize GLFW\n";
+    return 1;
+  }
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+  GLFWwindow* pWindow = glfwCreateWindow(64, 64, "programReport", nullptr, nullptr);
+  if (!pWindow)
+  {
+    std::cerr << "Error: cannot create an OpenGL 3.3 context\n";
+    glfwTerminate();
+    return 1;
+  }
+  glfwMakeContextCurrent(pWindow);
+  glewExperimental = GL_TRUE;
+  if (glewInit() != GLEW_OK)
+  {
+    std::cerr << "Error: cannot initialize GLEW\n";
+    glfwTerminate();
+    return 1;
+  }
+
+  GLShaderPP::CProgramReport report;
+  report.RecordDriver();
+  warmUpDriver();
+  bool bOk = true;
+  for (const std::string& strProgram : programs)
+    bOk = build(strProgram, report) && bOk;
+  glfwTerminate();
+  if (!bOk)
+    return 1;
+
+  if (strOutput.empty())
+    report.WriteJson(std::cout);
+  else
+  {
+    std::ofstream file(strOutput, std::ios::binary);
+    if (!report.WriteJson(file))
+    {
+      std::cerr << "Error: cannot write \"" << strOutput << "\"\n";
+      return 1;
+    }
+  }
+
+  if (!baseline)
+    return 0;
+  if (baseline->GetDriver() != report.GetDriver())
+    std::cerr << "Warning: the baseline was measured with another driver (" << baseline->GetDriver() << ")\n";
+  for (const auto& [strName, metrics] : report.GetPrograms())
+    if (!baseline->Find(strName))
+      std::cerr << "Warning: program \"" << strName << "\" is not in the baseline\n";
+  const std::vector<GLShaderPP::SRegression> regressions = report.Compare(*baseline, thresholds);
+  for (const GLShaderPP::SRegression& regression : regressions)
+    std::cerr << "Regression: " << regression.strProgram << ' ' << regression.strMetric << " grew from " << regression.dBaseline
+              << " to " << regression.dCurrent << '\n';
+  return regressions.empty() ? 0 : 1;
+}
@@ -0,0 +1,102 @@
+/*****************************************************************//**
+ * \file      shaderPacker.cpp
+ * \brief     Command line tool packing GLSL sources into a shader pack
+ *
+ * Usage:
+ *  - <tt>shaderPacker [-C directory] pack.glsp file...</tt> packs files. Their names in the pack are their
+ *    paths relative to \c directory (the current directory by default), with \c / separators. Their stages
+ *    are deduced from their extensions (see GLShaderPP::GetStageFromExtension()).
+ *  - <tt>shaderPacker -l pack.glsp</tt> lists the content of a pack and checks its hashes.
+ *
+ * \author    Benjamin ALBOUY-KISSI
+ * \date      2022
+ * \copyright GNU Lesser Public License v3
+ *********************************************************************/
+#include <GLShaderPP/ShaderPack.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+  int usage()
+  {
+    std::cerr << "Usage: shaderPacker [-C directory] pack.glsp file...\n"
+                 "       shaderPacker -l pack.glsp\n";
+    return 2;
+  }
+
+  int list(const char* pPackName)
+  {
+    GLShaderPP::CBasicShaderPackReader<GLShaderPP::CStderrErrorPolicy> pack(pPackName);
+    if (!pack.IsOpen())
+      return 1;
+    for (std::size_t i = 0; i < pack.GetSize(); ++i)
+    {
+      const GLShaderPP::SShaderPackEntry entry = pack.GetEntry(i);
+      std::cout << std::hex << "0x" << entry.nStage << std::dec << '\t' << entry.strSource.size() << '\t' << entry.strName << '\n';
+    }
+    if (!pack.VerifyHashes())
+    {
+      std::cerr << "Error: shader pack \"" << pPackName << "\" has corrupted sources\n";
+      return 1;
+    }
+    return 0;
+  }
+
+  int pack(const std::string& strDirectory, const char* pPackName, char** ppFiles, int nFiles)
+  {
+    GLShaderPP::CShaderPackWriter writer;
+    for (int i = 0; i < nFiles; ++i)
+    {
+      std::string strName = ppFiles[i];
+      std::replace(strName.begin(), strName.end(), '\\', '/');
+      const std::uint32_t nStage = GLShaderPP::GetStageFromExtension(strName);
+      if (nStage == 0)
+        std::cerr << "Warning: unknown shader stage for \"" << strName << "\"\n";
+
+      std::ifstream file(strDirectory.empty() ? strName : strDirectory + '/' + strName, std::ios::binary);
+      if (!file)
+      {
+        std::cerr << "Error: cannot read \"" << strName << "\"\n";
+        return 1;
+      }
+      std::stringstream source;
+      source << file.rdbuf();
+      if (!writer.Add(strName, nStage, source.str()))
+      {
+        std::cerr << "Error: \"" << strName << "\" is given twice\n";
+        return 1;
+      }
+    }
+
+    std::ofstream file(pPackName, std::ios::binary);
+    if (!file || !writer.Write(file))
+    {
+      std::cerr << "Error: cannot write \"" << pPackName << "\"\n";
+      return 1;
+    }
+    std::cout << writer.GetSize() << " sources packed into " << pPackName << '\n';
+    return 0;
+  }
+
+}
+
+int main(int argc, char** argv)
+{
+  if (argc == 3 && std::strcmp(argv[1], "-l") == 0)
+    return list(argv[2]);
+
+  int nArg = 1;
+  std::string strDirectory;
+  if (argc > 2 && std::strcmp(argv[1], "-C") == 0)
+  {
+    strDirectory = argv[2];
+    nArg = 3;
+  }
+  if (argc - nArg < 2)
+    return usage();
+  return pack(strDirectory, argv[nArg], argv + nArg + 1, argc - nArg - 1);
+}